@@ -97,6 +97,11 @@ public:
 
   /// Accessors to the number of MCPoints in the detectors
   Int_t getNumberOfPoints(DetectorId detId) const;
+  /// Bitvector of the number of MCPoints in all detectors, see mNumberOfPoints
+  Int_t getPackedNumberOfPoints() const
+  {
+    return mNumberOfPoints;
+  }
 
   ///  Modifiers
   void SetMotherTrackId(Int_t id)
@@ -0,0 +1,119 @@
+/// \file MCTrackColumnWriter.cxx
+/// \brief Implementation of the MCTrackColumnWriter class
+
+#include "MCTrackColumnWriter.h"
+#include "MCTrack.h"
+
+#include "TClonesArray.h"
+#include "TDirectory.h"
+#include "TTree.h"
+
+using namespace AliceO2::Data;
+
+namespace {
+const char* sMomentumNames[3] = { "px", "py", "pz" };
+const char* sVertexNames[4] = { "vx", "vy", "vz", "t" };
+}
+
+MCTrackColumnWriter::MCTrackColumnWriter() : mTree(0), mNumberOfTracks(0)
+{
+}
+
+MCTrackColumnWriter::~MCTrackColumnWriter()
+{
+}
+
+void MCTrackColumnWriter::init(TDirectory* dir, const char* treeName, Int_t eventsPerChunk)
+{
+  TDirectory* saveDir = gDirectory;
+  if (dir) {
+    dir->cd();
+  }
+  mTree = new TTree(treeName, "MCTracks, one branch per field");
+  saveDir->cd();
+
+  // the buffers must exist when the branches are created
+  mPdgCode.resize(1);
+  mMotherTrackId.resize(1);
+  mNumberOfPoints.resize(1);
+  for (int i = 3; i--;) {
+    mMomentum[i].resize(1);
+  }
+  for (int i = 4; i--;) {
+    mVertex[i].resize(1);
+  }
+
+  mTree->Branch("nTracks", &mNumberOfTracks, "nTracks/I");
+  mTree->Branch("pdg", &mPdgCode[0], "pdg[nTracks]/I");
+  mTree->Branch("mother", &mMotherTrackId[0], "mother[nTracks]/I");
+  for (int i = 0; i < 3; i++) {
+    mTree->Branch(sMomentumNames[i], &mMomentum[i][0], Form("%s[nTracks]/F", sMomentumNames[i]));
+  }
+  for (int i = 0; i < 4; i++) {
+    mTree->Branch(sVertexNames[i], &mVertex[i][0], Form("%s[nTracks]/F", sVertexNames[i]));
+  }
+  mTree->Branch("points", &mNumberOfPoints[0], "points[nTracks]/I");
+  if (eventsPerChunk > 0) {
+    mTree->SetAutoFlush(eventsPerChunk);
+  }
+}
+
+void MCTrackColumnWriter::fillEvent(const TClonesArray& tracks)
+{
+  if (!mTree) {
+    init();
+  }
+  mNumberOfTracks = tracks.GetEntriesFast();
+  size_t size = mNumberOfTracks > 0 ? mNumberOfTracks : 1;
+  mPdgCode.resize(size);
+  mMotherTrackId.resize(size);
+  mNumberOfPoints.resize(size);
+  for (int i = 3; i--;) {
+    mMomentum[i].resize(size);
+  }
+  for (int i = 4; i--;) {
+    mVertex[i].resize(size);
+  }
+
+  for (Int_t it = 0; it < mNumberOfTracks; it++) {
+    const MCTrack* track = (const MCTrack*)tracks.UncheckedAt(it);
+    mPdgCode[it] = track->GetPdgCode();
+    mMotherTrackId[it] = track->getMotherTrackId();
+    mMomentum[0][it] = track->GetStartVertexMomentumX();
+    mMomentum[1][it] = track->GetStartVertexMomentumY();
+    mMomentum[2][it] = track->GetStartVertexMomentumZ();
+    mVertex[0][it] = track->GetStartVertexCoordinatesX();
+    mVertex[1][it] = track->GetStartVertexCoordinatesY();
+    mVertex[2][it] = track->GetStartVertexCoordinatesZ();
+    mVertex[3][it] = track->GetStartVertexCoordinatesT();
+    mNumberOfPoints[it] = track->getPackedNumberOfPoints();
+  }
+  setBranchAddresses();
+  mTree->Fill();
+}
+
+void MCTrackColumnWriter::write()
+{
+  if (!mTree) {
+    return;
+  }
+  TDirectory* saveDir = gDirectory;
+  if (mTree->GetDirectory()) {
+    mTree->GetDirectory()->cd();
+  }
+  mTree->Write();
+  saveDir->cd();
+}
+
+void MCTrackColumnWriter::setBranchAddresses()
+{
+  mTree->SetBranchAddress("pdg", &mPdgCode[0]);
+  mTree->SetBranchAddress("mother", &mMotherTrackId[0]);
+  for (int i = 0; i < 3; i++) {
+    mTree->SetBranchAddress(sMomentumNames[i], &mMomentum[i][0]);
+  }
+  for (int i = 0; i < 4; i++) {
+    mTree->SetBranchAddress(sVertexNames[i], &mVertex[i][0]);
+  }
+  mTree->SetBranchAddress("points", &mNumberOfPoints[0]);
+}
@@ -0,0 +1,69 @@
+/// \file MCTrackColumnWriter.h
+/// \brief Definition of the MCTrackColumnWriter class
+
+#ifndef ALICEO2_DATA_MCTRACKCOLUMNWRITER_H_
+#define ALICEO2_DATA_MCTRACKCOLUMNWRITER_H_
+
+#include "Rtypes.h"
+
+#include <vector>
+
+class TClonesArray;
+class TDirectory;
+class TTree;
+
+namespace AliceO2 {
+namespace Data {
+
+/// Writes the MCTracks of each event in columnar form, alongside the MCTrack TClonesArray branch: one tree entry
+/// per event holding, for each field of the MCTrack, a contiguous array over the tracks of the event in a branch of
+/// its own. Readers needing only some fields (e.g. pdg, px, py, pz and mother) enable just these branches with
+/// TTree::SetBranchStatus and never deserialize the others.
+/// The branches are nTracks (count of the event) and pdg, mother, px, py, pz, vx, vy, vz, t, points (packed
+/// number of MCPoints per detector, see MCTrack), all of size nTracks. Momenta, vertex and time are stored as float,
+/// the precision at which the Double32_t members of MCTrack are streamed.
+/// The baskets are flushed every eventsPerChunk events, so that a chunk of events of one column is read at once
+class MCTrackColumnWriter {
+
+public:
+  /// Default constructor
+  MCTrackColumnWriter();
+
+  /// Default destructor, the tree belongs to its directory
+  ~MCTrackColumnWriter();
+
+  /// Creates the output tree in dir (the current directory if 0)
+  /// \param treeName Name of the tree
+  /// \param eventsPerChunk Number of events after which the baskets are flushed, 0 to use the ROOT default
+  void init(TDirectory* dir = 0, const char* treeName = "MCTrackColumns", Int_t eventsPerChunk = 100);
+
+  /// Adds the tracks of an event, tracks being an array of MCTrack as filled by Stack::FillTrackArray
+  void fillEvent(const TClonesArray& tracks);
+
+  /// Writes the tree to its directory, to be called once all events are filled
+  void write();
+
+  TTree* getTree() const
+  {
+    return mTree;
+  }
+
+private:
+  MCTrackColumnWriter(const MCTrackColumnWriter&);
+  MCTrackColumnWriter& operator=(const MCTrackColumnWriter&);
+
+  /// Points the column branches to the current buffers, which move when the vectors grow
+  void setBranchAddresses();
+
+  TTree* mTree;                       ///< output tree, owned by its directory
+  Int_t mNumberOfTracks;              ///< number of tracks of the current event
+  std::vector<Int_t> mPdgCode;        ///< PDG code of each track
+  std::vector<Int_t> mMotherTrackId;  ///< mother index of each track, -1 for primaries
+  std::vector<Float_t> mMomentum[3];  ///< momentum components at the start vertex [GeV]
+  std::vector<Float_t> mVertex[4];    ///< coordinates of the start vertex [cm, ns]
+  std::vector<Int_t> mNumberOfPoints; ///< packed number of MCPoints of each track
+};
+}
+}
+
+#endif
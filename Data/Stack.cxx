@@ -8,34 +8,83 @@
 #include "FairLink.h"
 #include "FairMCPoint.h"
 #include "MCTrack.h"
+#include "MCTrackColumnWriter.h"
 #include "FairRootManager.h"
 #include "FairLogger.h"
 
 #include "Riosfwd.h"
 #include "TClonesArray.h"
 #include "TIterator.h"
-#include "TLorentzVector.h"
 #include "TParticle.h"
 #include "TRefArray.h"
+#include "TVector3.h"
 
 #include <stddef.h>
+#include <algorithm>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 using std::cout;
 using std::endl;
-using std::pair;
 using namespace AliceO2::Data;
 
+namespace {
+/// Range of MCTracks or MCPoints of one array remapped by one task of UpdateTrackIndex
+struct RemapChunk {
+  TClonesArray* mArray;
+  Int_t mFirst;
+  Int_t mLast;
+  Bool_t mIsPointArray;
+  Bool_t mFailed;      ///< an invalid particle index was met, the rest of the chunk is not remapped
+  Int_t mInvalidIndex; ///< first invalid particle index of the chunk
+};
+
+/// Maximum number of objects remapped by one task of UpdateTrackIndex
+const Int_t kObjectsPerChunk = 1 << 14;
+
+/// Appends the chunks covering the first n objects of the array
+void addRemapChunks(std::vector<RemapChunk>& chunks, TClonesArray* array, Int_t n, Bool_t isPointArray)
+{
+  for (Int_t first = 0; first < n; first += kObjectsPerChunk) {
+    RemapChunk chunk = { array, first, std::min(n, first + kObjectsPerChunk), isPointArray, kFALSE, 0 };
+    chunks.push_back(chunk);
+  }
+}
+
+/// Calls fun(i) for i in [0:n), distributing the calls over nThreads threads
+template <typename F>
+void runRemapChunks(int nThreads, int n, F fun)
+{
+  if (nThreads < 2 || n < 2) {
+    for (int i = 0; i < n; i++) {
+      fun(i);
+    }
+    return;
+  }
+  std::vector<std::thread> workers;
+  for (int ith = 0; ith < nThreads && ith < n; ith++) {
+    workers.push_back(std::thread([=]() {
+      for (int i = ith; i < n; i += nThreads) {
+        fun(i);
+      }
+    }));
+  }
+  for (size_t ith = 0; ith < workers.size(); ith++) {
+    workers[ith].join();
+  }
+}
+}
+
 Stack::Stack(Int_t size)
   : FairGenericStack(),
     mStack(),
+    mParticleRecords(),
     mParticles(new TClonesArray("TParticle", size)),
     mTracks(new TClonesArray("MCTrack", size)),
-    mStoreMap(),
-    mStoreIterator(),
-    mIndexMap(),
-    mIndexIterator(),
-    mPointsMap(),
+    mStoreFlags(),
+    mTrackIndex(),
+    mNumberOfPoints(),
     mIndexOfCurrentTrack(-1),
     mNumberOfPrimaryParticles(0),
     mNumberOfEntriesInParticles(0),
@@ -45,8 +94,11 @@ Stack::Stack(Int_t size)
     mMinPoints(1),
     mEnergyCut(0.),
     mStoreMothers(kTRUE),
+    mNumberOfThreads(1),
+    mColumnWriter(0),
     mLogger(FairLogger::GetLogger())
 {
+  mParticleRecords.reserve(size);
 }
 
 Stack::~Stack()
@@ -74,19 +126,16 @@ void Stack::PushTrack(Int_t toBeDone, Int_t parentId, Int_t pdgCode, Double_t px
                       TMCProcess proc, Int_t& ntr, Double_t weight, Int_t is, Int_t secondparentID)
 {
 
-  // Get TParticle array
-  TClonesArray& partArray = *mParticles;
-
-  // Create new TParticle and add it to the TParticle array
-  Int_t trackId = mNumberOfEntriesInParticles;
-  Int_t nPoints = 0;
-  Int_t daughter1Id = -1;
-  Int_t daughter2Id = -1;
-  TParticle* particle = new (partArray[mNumberOfEntriesInParticles++])
-    TParticle(pdgCode, trackId, parentId, nPoints, daughter1Id, daughter2Id, px, py, pz, e, vx, vy, vz, time);
-  particle->SetPolarisation(polx, poly, polz);
-  particle->SetWeight(weight);
-  particle->SetUniqueID(proc);
+  // Add the record of the new particle, its TParticle is created only when requested
+  Int_t trackId = mNumberOfEntriesInParticles++;
+  StackParticle record = { { px, py, pz, e },
+                           { vx, vy, vz, time },
+                           { polx, poly, polz },
+                           weight,
+                           pdgCode,
+                           parentId,
+                           UInt_t(proc) };
+  mParticleRecords.push_back(record);
 
   // Increment counter
   if (parentId < 0) {
@@ -98,7 +147,7 @@ void Stack::PushTrack(Int_t toBeDone, Int_t parentId, Int_t pdgCode, Double_t px
 
   // Push particle on the stack if toBeDone is set
   if (toBeDone == 1) {
-    mStack.push(particle);
+    mStack.push(trackId);
   }
 }
 
@@ -112,18 +161,11 @@ TParticle* Stack::PopNextTrack(Int_t& iTrack)
   }
 
   // If not, get next particle from stack
-  TParticle* thisParticle = mStack.top();
+  mIndexOfCurrentTrack = mStack.top();
   mStack.pop();
-
-  if (!thisParticle) {
-    iTrack = 0;
-    return NULL;
-  }
-
-  mIndexOfCurrentTrack = thisParticle->GetStatusCode();
   iTrack = mIndexOfCurrentTrack;
 
-  return thisParticle;
+  return GetParticle(mIndexOfCurrentTrack);
 }
 
 TParticle* Stack::PopPrimaryForTracking(Int_t iPrim)
@@ -140,13 +182,12 @@ TParticle* Stack::PopPrimaryForTracking(Int_t iPrim)
 
   // Return the iPrim-th TParticle from the fParticle array. This should be
   // a primary.
-  TParticle* part = (TParticle*)mParticles->At(iPrim);
-  if (!(part->GetMother(0) < 0)) {
+  if (!(mParticleRecords[iPrim].mMotherId < 0)) {
     mLogger->Fatal(MESSAGE_ORIGIN, "Stack:: Not a primary track! %i ", iPrim);
     Fatal("Stack::PopPrimaryForTracking", "Not a primary track");
   }
 
-  return part;
+  return GetParticle(iPrim);
 }
 
 TParticle* Stack::GetCurrentTrack() const
@@ -165,6 +206,21 @@ void Stack::AddParticle(TParticle* oldPart)
   TParticle* newPart = new (array[mIndex]) TParticle(*oldPart);
   newPart->SetWeight(oldPart->GetWeight());
   newPart->SetUniqueID(oldPart->GetUniqueID());
+
+  // keep the record in sync with the copied TParticle
+  TVector3 pol;
+  oldPart->GetPolarisation(pol);
+  StackParticle record = { { oldPart->Px(), oldPart->Py(), oldPart->Pz(), oldPart->Energy() },
+                           { oldPart->Vx(), oldPart->Vy(), oldPart->Vz(), oldPart->T() },
+                           { pol.X(), pol.Y(), pol.Z() },
+                           oldPart->GetWeight(),
+                           oldPart->GetPdgCode(),
+                           oldPart->GetMother(0),
+                           oldPart->GetUniqueID() };
+  if (mIndex >= Int_t(mParticleRecords.size())) {
+    mParticleRecords.resize(mIndex + 1);
+  }
+  mParticleRecords[mIndex] = record;
   mIndex++;
 }
 
@@ -174,7 +230,7 @@ void Stack::FillTrackArray()
   mLogger->Debug(MESSAGE_ORIGIN, "Stack: Filling MCTrack array...");
 
   // Reset index map and number of output tracks
-  mIndexMap.clear();
+  mTrackIndex.assign(mNumberOfEntriesInParticles, -2);
   mNumberOfEntriesInTracks = 0;
 
   // Check tracks for selection criteria
@@ -182,52 +238,47 @@ void Stack::FillTrackArray()
 
   // Loop over mParticles array and copy selected tracks
   for (Int_t iPart = 0; iPart < mNumberOfEntriesInParticles; iPart++) {
-
-    mStoreIterator = mStoreMap.find(iPart);
-    if (mStoreIterator == mStoreMap.end()) {
-      mLogger->Fatal(MESSAGE_ORIGIN, "Stack: Particle %i not found in storage map! ", iPart);
-      Fatal("Stack::FillTrackArray", "Particle not found in storage map.");
-    }
-    Bool_t store = (*mStoreIterator).second;
-
-    if (store) {
-      MCTrack* track = new ((*mTracks)[mNumberOfEntriesInTracks]) MCTrack(GetParticle(iPart));
-      mIndexMap[iPart] = mNumberOfEntriesInTracks;
+    if (mStoreFlags[iPart]) {
+      const StackParticle& part = mParticleRecords[iPart];
+      MCTrack* track = new ((*mTracks)[mNumberOfEntriesInTracks])
+        MCTrack(part.mPdgCode, part.mMotherId, part.mMomentum[0], part.mMomentum[1], part.mMomentum[2],
+                part.mVertex[0], part.mVertex[1], part.mVertex[2], part.mVertex[3] * 1e09, 0);
+      mTrackIndex[iPart] = mNumberOfEntriesInTracks;
       // Set the number of points in the detectors for this track
       for (Int_t iDet = kAliIts; iDet < kSTOPHERE; iDet++) {
-        pair<Int_t, Int_t> a(iPart, iDet);
-        track->setNumberOfPoints(iDet, mPointsMap[a]);
+        track->setNumberOfPoints(iDet, getNumberOfPoints(iPart, iDet));
       }
       mNumberOfEntriesInTracks++;
-    } else {
-      mIndexMap[iPart] = -2;
     }
   }
 
-  // Map index for primary mothers
-  mIndexMap[-1] = -1;
-
   // Screen output
   // Print(1);
 }
 
+Bool_t Stack::getTrackIndex(Int_t iPart, Int_t& iTrack) const
+{
+  if (iPart == -1) { // mother of primaries
+    iTrack = -1;
+    return kTRUE;
+  }
+  if (iPart < 0 || iPart >= Int_t(mTrackIndex.size())) {
+    return kFALSE;
+  }
+  iTrack = mTrackIndex[iPart];
+  return kTRUE;
+}
+
 void Stack::UpdateTrackIndex(TRefArray* detList)
 {
 
   mLogger->Debug(MESSAGE_ORIGIN, "Stack: Updating track indizes...");
   Int_t nColl = 0;
 
-  // First update mother ID in MCTracks
-  for (Int_t i = 0; i < mNumberOfEntriesInTracks; i++) {
-    MCTrack* track = (MCTrack*)mTracks->At(i);
-    Int_t iMotherOld = track->getMotherTrackId();
-    mIndexIterator = mIndexMap.find(iMotherOld);
-    if (mIndexIterator == mIndexMap.end()) {
-      mLogger->Fatal(MESSAGE_ORIGIN, "Stack: Particle index %i not found in dex map! ", iMotherOld);
-      Fatal("Stack::UpdateTrackIndex", "Particle index not found in map");
-    }
-    track->SetMotherTrackId((*mIndexIterator).second);
-  }
+  // The mother IDs in the MCTracks and the track IDs of the MCPoints of all collections are remapped in chunks,
+  // which touch distinct objects and only read the index map, hence can be processed in parallel
+  std::vector<RemapChunk> chunks;
+  addRemapChunks(chunks, mTracks, mNumberOfEntriesInTracks, kFALSE);
 
   if (fDetList == 0) {
     // Now iterate through all active detectors
@@ -245,25 +296,51 @@ void Stack::UpdateTrackIndex(TRefArray* detList)
     TClonesArray* hitArray;
     while ((hitArray = det->GetCollection(iColl++))) {
       nColl++;
-      Int_t nPoints = hitArray->GetEntriesFast();
-
-      // Update track index for all MCPoints in the collection
-      for (Int_t iPoint = 0; iPoint < nPoints; iPoint++) {
-        FairMCPoint* point = (FairMCPoint*)hitArray->At(iPoint);
-        Int_t iTrack = point->GetTrackID();
+      addRemapChunks(chunks, hitArray, hitArray->GetEntriesFast(), kTRUE);
+    } // Collections of this detector
+  }   // List of active detectors
 
-        mIndexIterator = mIndexMap.find(iTrack);
-        if (mIndexIterator == mIndexMap.end()) {
-          mLogger->Fatal(MESSAGE_ORIGIN, "Stack: Particle index %i not found in index map! ", iTrack);
-          Fatal("Stack::UpdateTrackIndex", "Particle index not found in map");
+  // the branch of the links is looked up once instead of by every FairLink constructor
+  Int_t trackBranchId = FairRootManager::Instance()->GetBranchId("MCTrack");
+  // the workers only record the invalid indices, which are reported once they are joined
+  runRemapChunks(mNumberOfThreads, chunks.size(), [&](int ic) {
+    RemapChunk& chunk = chunks[ic];
+    Int_t iTrack;
+    if (chunk.mIsPointArray) {
+      for (Int_t iPoint = chunk.mFirst; iPoint < chunk.mLast; iPoint++) {
+        FairMCPoint* point = (FairMCPoint*)chunk.mArray->UncheckedAt(iPoint);
+        if (!getTrackIndex(point->GetTrackID(), iTrack)) {
+          chunk.mFailed = kTRUE;
+          chunk.mInvalidIndex = point->GetTrackID();
+          return;
         }
-        point->SetTrackID((*mIndexIterator).second);
-        point->SetLink(FairLink("MCTrack", (*mIndexIterator).second));
+        point->SetTrackID(iTrack);
+        point->SetLink(FairLink(trackBranchId, iTrack));
       }
-
-    } // Collections of this detector
-  }   // List of active detectors
+    } else {
+      for (Int_t i = chunk.mFirst; i < chunk.mLast; i++) {
+        MCTrack* track = (MCTrack*)chunk.mArray->UncheckedAt(i);
+        if (!getTrackIndex(track->getMotherTrackId(), iTrack)) {
+          chunk.mFailed = kTRUE;
+          chunk.mInvalidIndex = track->getMotherTrackId();
+          return;
+        }
+        track->SetMotherTrackId(iTrack);
+      }
+    }
+  });
+  for (size_t ic = 0; ic < chunks.size(); ic++) {
+    if (chunks[ic].mFailed) {
+      mLogger->Fatal(MESSAGE_ORIGIN, "Stack: Particle index %i not found in index map! ", chunks[ic].mInvalidIndex);
+      Fatal("Stack::UpdateTrackIndex", "Particle index not found in map");
+    }
+  }
   mLogger->Debug(MESSAGE_ORIGIN, "...stack and  %i collections updated.", nColl);
+
+  // the mother indices are final only now
+  if (mColumnWriter) {
+    mColumnWriter->fillEvent(*mTracks);
+  }
 }
 
 void Stack::Reset()
@@ -274,9 +351,10 @@ void Stack::Reset()
   while (!mStack.empty()) {
     mStack.pop();
   }
+  mParticleRecords.clear();
   mParticles->Clear();
   mTracks->Clear();
-  mPointsMap.clear();
+  mNumberOfPoints.clear();
 }
 
 void Stack::Register()
@@ -298,14 +376,7 @@ void Stack::Print(Int_t iVerbose) const
 
 void Stack::AddPoint(DetectorId detId)
 {
-  Int_t iDet = detId;
-  // cout << "Add point for Detektor" << iDet << endl;
-  pair<Int_t, Int_t> a(mIndexOfCurrentTrack, iDet);
-  if (mPointsMap.find(a) == mPointsMap.end()) {
-    mPointsMap[a] = 1;
-  } else {
-    mPointsMap[a]++;
-  }
+  AddPoint(detId, mIndexOfCurrentTrack);
 }
 
 void Stack::AddPoint(DetectorId detId, Int_t iTrack)
@@ -313,13 +384,11 @@ void Stack::AddPoint(DetectorId detId, Int_t iTrack)
   if (iTrack < 0) {
     return;
   }
-  Int_t iDet = detId;
-  pair<Int_t, Int_t> a(iTrack, iDet);
-  if (mPointsMap.find(a) == mPointsMap.end()) {
-    mPointsMap[a] = 1;
-  } else {
-    mPointsMap[a]++;
+  size_t index = size_t(iTrack) * kSTOPHERE + detId;
+  if (index >= mNumberOfPoints.size()) { // geometric growth keeps the resizing amortized constant
+    mNumberOfPoints.resize(std::max(index + 1, 2 * mNumberOfPoints.size()), 0);
   }
+  mNumberOfPoints[index]++;
 }
 
 Int_t Stack::GetCurrentParentTrackNumber() const
@@ -338,66 +407,65 @@ TParticle* Stack::GetParticle(Int_t trackID) const
     mLogger->Debug(MESSAGE_ORIGIN, "Stack: Particle index %i out of range.", trackID);
     Fatal("Stack::GetParticle", "Index out of range");
   }
-  return (TParticle*)mParticles->At(trackID);
+  // the slots of the TParticles not created yet are empty
+  TParticle* part = trackID <= mParticles->GetLast() ? (TParticle*)mParticles->UncheckedAt(trackID) : 0;
+  return part ? part : createParticle(trackID);
 }
 
-void Stack::SelectTracks()
+TParticle* Stack::createParticle(Int_t trackID) const
 {
+  const StackParticle& rec = mParticleRecords[trackID];
+  Int_t nPoints = 0;
+  Int_t daughter1Id = -1;
+  Int_t daughter2Id = -1;
+  TParticle* particle = new ((*mParticles)[trackID])
+    TParticle(rec.mPdgCode, trackID, rec.mMotherId, nPoints, daughter1Id, daughter2Id, rec.mMomentum[0],
+              rec.mMomentum[1], rec.mMomentum[2], rec.mMomentum[3], rec.mVertex[0], rec.mVertex[1], rec.mVertex[2],
+              rec.mVertex[3]);
+  particle->SetPolarisation(rec.mPolarisation[0], rec.mPolarisation[1], rec.mPolarisation[2]);
+  particle->SetWeight(rec.mWeight);
+  particle->SetUniqueID(rec.mProcess);
+  return particle;
+}
 
-  // Clear storage map
-  mStoreMap.clear();
-
-  // Check particles in the fParticle array
+TClonesArray* Stack::GetListOmParticles()
+{
   for (Int_t i = 0; i < mNumberOfEntriesInParticles; i++) {
+    GetParticle(i);
+  }
+  return mParticles;
+}
 
-    TParticle* thisPart = GetParticle(i);
-    Bool_t store = kTRUE;
-
-    // Get track parameters
-    Int_t iMother = thisPart->GetMother(0);
-    TLorentzVector p;
-    thisPart->Momentum(p);
-    Double_t energy = p.E();
-    Double_t mass = p.M();
-    //    Double_t mass   = thisPart->GetMass();
-    Double_t eKin = energy - mass;
-
-    // Calculate number of points
-    Int_t nPoints = 0;
-    for (Int_t iDet = kAliIts; iDet < kSTOPHERE; iDet++) {
-      pair<Int_t, Int_t> a(i, iDet);
-      if (mPointsMap.find(a) != mPointsMap.end()) {
-        nPoints += mPointsMap[a];
-      }
-    }
-
-    // Check for cuts (store primaries in any case)
-    if (iMother < 0) {
-      store = kTRUE;
-    } else {
-      if (!mStoreSecondaries) {
-        store = kFALSE;
-      }
-      if (nPoints < mMinPoints) {
-        store = kFALSE;
-      }
-      if (eKin < mEnergyCut) {
-        store = kFALSE;
+void Stack::SelectTracks()
+{
+  // Daughters are always added to mParticles after their mothers, so a single pass from the last particle to
+  // the first one sees the flags propagated from all daughters of a particle before reaching it, and the
+  // whole mother chain of every stored track is flagged in linear time
+  mStoreFlags.assign(mNumberOfEntriesInParticles, kFALSE);
+
+  for (Int_t i = mNumberOfEntriesInParticles; i--;) {
+    const StackParticle& thisPart = mParticleRecords[i];
+    Int_t iMother = thisPart.mMotherId;
+
+    // Check for cuts (store primaries in any case), unless a daughter already requires the particle
+    Bool_t store = mStoreFlags[i] || iMother < 0;
+    if (!store && mStoreSecondaries && thisPart.getKineticEnergy() >= mEnergyCut) {
+      Int_t nPoints = 0;
+      for (Int_t iDet = kAliIts; iDet < kSTOPHERE; iDet++) {
+        nPoints += getNumberOfPoints(i, iDet);
       }
+      store = nPoints >= mMinPoints;
     }
-
-    // Set storage flag
-    mStoreMap[i] = store;
-  }
-
-  // If flag is set, flag recursively mothers of selected tracks
-  if (mStoreMothers) {
-    for (Int_t i = 0; i < mNumberOfEntriesInParticles; i++) {
-      if (mStoreMap[i]) {
-        Int_t iMother = GetParticle(i)->GetMother(0);
-        while (iMother >= 0) {
-          mStoreMap[iMother] = kTRUE;
-          iMother = GetParticle(iMother)->GetMother(0);
+    mStoreFlags[i] = store;
+
+    // If flag is set, flag the mother, which comes earlier in the array
+    if (store && mStoreMothers && iMother >= 0) {
+      if (iMother < i) {
+        mStoreFlags[iMother] = kTRUE;
+      } else { // not expected, the chain is walked explicitly
+        while (iMother >= 0 && !mStoreFlags[iMother]) {
+          mStoreFlags[iMother] = kTRUE;
+          iMother = mParticleRecords[iMother].mMotherId;
         }
       }
     }
@@ -10,11 +10,11 @@
 #include "DetectorList.h"
 
 #include "Rtypes.h"
+#include "TMath.h"
 #include "TMCProcess.h"
 
-#include <map>
 #include <stack>
-#include <utility>
+#include <vector>
 
 class TClonesArray;
 class TParticle;
@@ -24,9 +24,33 @@ class FairLogger;
 namespace AliceO2 {
 namespace Data {
 
+class MCTrackColumnWriter;
+
+/// Compact record of a particle put on the Stack. The TParticle needed by the transport or the user is created
+/// from it only on request, see Stack::GetParticle
+struct StackParticle {
+  Double_t mMomentum[4];     ///< px, py, pz and total energy at the start vertex [GeV]
+  Double_t mVertex[4];       ///< x, y, z [cm] and time [s] of the start vertex
+  Double_t mPolarisation[3]; ///< polarisation vector
+  Double_t mWeight;          ///< particle weight
+  Int_t mPdgCode;            ///< particle type (PDG encoding)
+  Int_t mMotherId;           ///< index of the mother particle, -1 for primaries
+  UInt_t mProcess;           ///< production mechanism (VMC encoding)
+
+  /// Kinetic energy, the mass being computed from the energy and momentum as in TParticle::GetCalcMass
+  Double_t getKineticEnergy() const
+  {
+    Double_t m2 = mMomentum[3] * mMomentum[3] - mMomentum[0] * mMomentum[0] - mMomentum[1] * mMomentum[1] -
+                  mMomentum[2] * mMomentum[2];
+    return mMomentum[3] - (m2 >= 0 ? TMath::Sqrt(m2) : -TMath::Sqrt(-m2));
+  }
+};
+
 /// This class handles the particle stack for the transport simulation.
 /// For the stack FILO functunality, it uses the STL stack. To store
-/// the tracks during transport, a TParticle array is used.
+/// the tracks during transport, a vector of compact StackParticle records
+/// is used, the TParticles being created in a TParticle array only for the
+/// tracks handed to the transport or requested by the user.
 /// At the end of the event, tracks satisfying the filter criteria
 /// are copied to a MCTrack array, which is stored in the output.
 ///
@@ -156,6 +180,18 @@ public:
   {
     mStoreMothers = choice;
   }
+  /// Set the number of threads remapping the track indices of the MCTracks and MCPoints in UpdateTrackIndex
+  void SetNumberOfThreads(Int_t n)
+  {
+    mNumberOfThreads = n < 1 ? 1 : n;
+  }
+
+  /// Set a writer receiving the MCTracks of each event in columnar form, in addition to the MCTrack branch.
+  /// It is filled at the end of UpdateTrackIndex and is not owned by the Stack, 0 disables it
+  void SetColumnWriter(MCTrackColumnWriter* writer)
+  {
+    mColumnWriter = writer;
+  }
 
   /// Increment number of points for the current track in a given detector
   /// \param iDet  Detector unique identifier
@@ -168,35 +204,42 @@ public:
   void AddPoint(DetectorId iDet, Int_t iTrack);
 
   /// Accessors
+  /// Returns the TParticle of a track, creating it from its record at the first request
   TParticle* GetParticle(Int_t trackId) const;
-  TClonesArray* GetListOmParticles()
+
+  /// Returns the TParticle array, after creating the TParticles of all tracks
+  TClonesArray* GetListOmParticles();
+
+  /// Returns the compact record of a track
+  const StackParticle& getParticleRecord(Int_t trackId) const
   {
-    return mParticles;
+    return mParticleRecords[trackId];
   }
 
 private:
   FairLogger* mLogger;
 
-  /// STL stack (FILO) used to handle the TParticles for tracking
-  std::stack<TParticle*> mStack; //!
+  /// STL stack (FILO) of the indices of the particles to be tracked
+  std::stack<Int_t> mStack; //!
+
+  /// Records of all particles put into or created by the transport, indexed by the track number
+  std::vector<StackParticle> mParticleRecords; //!
 
-  /// Array of TParticles (contains all TParticles put into or created
-  /// by the transport
+  /// Array of TParticles, at the index of the track number, containing only those created by GetParticle
   TClonesArray* mParticles; //!
 
   /// Array of FairMCTracks containg the tracks written to the output
   TClonesArray* mTracks;
 
-  /// STL map from particle index to storage flag
-  std::map<Int_t, Bool_t> mStoreMap;                //!
-  std::map<Int_t, Bool_t>::iterator mStoreIterator; //!
+  /// Storage flag of each particle, indexed by the particle index
+  std::vector<Bool_t> mStoreFlags; //!
 
-  /// STL map from particle index to track index
-  std::map<Int_t, Int_t> mIndexMap;                //!
-  std::map<Int_t, Int_t>::iterator mIndexIterator; //!
+  /// Index of each particle in the output track array, -2 if it is not stored
+  std::vector<Int_t> mTrackIndex; //!
 
-  /// STL map from track index and detector ID to number of MCPoints
-  std::map<std::pair<Int_t, Int_t>, Int_t> mPointsMap; //!
+  /// Number of MCPoints of each particle in each detector, at index particle * kSTOPHERE + detector ID.
+  /// Grows with the highest particle index having points
+  std::vector<Int_t> mNumberOfPoints; //!
 
   /// Some indices and counters
   Int_t mIndexOfCurrentTrack;        //! Index of current track
@@ -211,9 +254,29 @@ private:
   Int_t mMinPoints;
   Double32_t mEnergyCut;
 
+  /// Number of threads used by UpdateTrackIndex
+  Int_t mNumberOfThreads; //!
+
+  /// Optional columnar output of the MCTracks, not owned
+  MCTrackColumnWriter* mColumnWriter; //!
+
   /// Mark tracks for output using selection criteria
   void SelectTracks();
 
+  /// Number of MCPoints of a particle in a given detector
+  Int_t getNumberOfPoints(Int_t iPart, Int_t iDet) const
+  {
+    size_t index = size_t(iPart) * kSTOPHERE + iDet;
+    return index < mNumberOfPoints.size() ? mNumberOfPoints[index] : 0;
+  }
+
+  /// Creates the TParticle of a track from its record in the TParticle array
+  TParticle* createParticle(Int_t trackId) const;
+
+  /// Index in the output track array of a particle, -1 for the mother of primaries and -2 if it is not stored.
+  /// Returns kFALSE if iPart is not a valid particle index, leaving the reporting to the caller
+  Bool_t getTrackIndex(Int_t iPart, Int_t& iTrack) const;
+
   Stack(const Stack&);
   Stack& operator=(const Stack&);
 
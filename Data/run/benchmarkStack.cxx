@@ -0,0 +1,172 @@
+/// \file benchmarkStack.cxx
+/// \brief Benchmark of the track bookkeeping of the Stack on a large synthetic event
+///
+/// Usage: benchmarkStack [-p nPrimaries] [-s nSecondaries] [-e nEvents] [-h hitFraction] [-t nThreads]
+///
+/// Fills the Stack with nPrimaries primaries and nSecondaries secondaries, each secondary having a random
+/// earlier particle as mother, and registers 1 to 5 MCPoints for a fraction hitFraction of the particles in
+/// a synthetic detector. The time spent in PushTrack, AddPoint, FillTrackArray, UpdateTrackIndex and Reset
+/// is reported per event and per call. nThreads is passed to Stack::SetNumberOfThreads
+
+#include "Stack.h"
+#include "DetectorList.h"
+#include "BenchmarkTools.h"
+
+#include "FairDetector.h"
+#include "FairMCPoint.h"
+
+#include "TClonesArray.h"
+#include "TMath.h"
+#include "TRandom3.h"
+#include "TRefArray.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace AliceO2::Data;
+using namespace AliceO2::Benchmark;
+
+namespace {
+
+/// Detector holding a single collection of MCPoints filled by the benchmark
+class SyntheticDetector : public FairDetector {
+public:
+  SyntheticDetector() : FairDetector("Synthetic", kTRUE, kAliIts), mPoints(new TClonesArray("FairMCPoint", 1000))
+  {
+  }
+
+  virtual ~SyntheticDetector()
+  {
+    mPoints->Delete();
+    delete mPoints;
+  }
+
+  virtual Bool_t ProcessHits(FairVolume*)
+  {
+    return kFALSE;
+  }
+
+  virtual void Register()
+  {
+  }
+
+  virtual TClonesArray* GetCollection(Int_t iColl) const
+  {
+    return iColl == 0 ? mPoints : 0;
+  }
+
+  virtual void Reset()
+  {
+    mPoints->Clear();
+  }
+
+  /// Adds a point of track iTrack
+  void addPoint(Int_t iTrack)
+  {
+    FairMCPoint* point = new ((*mPoints)[mPoints->GetEntriesFast()]) FairMCPoint();
+    point->SetTrackID(iTrack);
+  }
+
+private:
+  TClonesArray* mPoints;
+};
+}
+
+int main(int argc, char** argv)
+{
+  Int_t nPrimaries = 20000, nSecondaries = 2000000, nEvents = 3;
+  Int_t nThreads = 1;
+  Double_t hitFraction = 0.3;
+  Options options;
+  options.add("-p", &nPrimaries);
+  options.add("-s", &nSecondaries);
+  options.add("-e", &nEvents);
+  options.add("-h", &hitFraction);
+  options.add("-t", &nThreads);
+  if (!options.parse(argc, argv)) {
+    printf("Usage: %s [-p nPrimaries] [-s nSecondaries] [-e nEvents] [-h hitFraction] [-t nThreads]\n", argv[0]);
+    return 2;
+  }
+  if (nPrimaries < 1 || nSecondaries < 0 || nEvents < 1) {
+    printf("At least one primary and one event are needed\n");
+    return 2;
+  }
+
+  Int_t nParticles = nPrimaries + nSecondaries;
+  Stack stack(nParticles);
+  stack.SetMinPoints(1);
+  stack.SetNumberOfThreads(nThreads);
+  SyntheticDetector detector;
+  TRefArray detList;
+  detList.Add(&detector);
+  TRandom3 rnd(12345);
+
+  const int kNPhases = 5;
+  const char* phaseNames[kNPhases] = { "PushTrack", "AddPoint", "FillTrackArray", "UpdateTrackIndex", "Reset" };
+  Double_t phaseMs[kNPhases] = { 0 };
+  Long64_t phaseCalls[kNPhases] = { 0 };
+
+  for (int iev = 0; iev < nEvents; iev++) {
+    // the random numbers are drawn beforehand to time only the stack
+    std::vector<Int_t> mothers(nParticles);
+    std::vector<Double_t> momenta(3 * nParticles);
+    for (int i = 0; i < nParticles; i++) {
+      mothers[i] = i < nPrimaries ? -1 : rnd.Integer(i);
+      for (int j = 3; j--;) {
+        momenta[3 * i + j] = rnd.Gaus(0., 0.5);
+      }
+    }
+    std::vector<Int_t> hitTracks;
+    for (int i = 0; i < nParticles; i++) {
+      if (rnd.Rndm() < hitFraction) {
+        for (int nh = 1 + rnd.Integer(5); nh--;) {
+          hitTracks.push_back(i);
+        }
+      }
+    }
+
+    Clock_t::time_point start = Clock_t::now();
+    for (int i = 0; i < nParticles; i++) {
+      const Double_t* p = &momenta[3 * i];
+      Double_t e = TMath::Sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2] + 0.0195);
+      Int_t ntr;
+      stack.PushTrack(i < nPrimaries, mothers[i], 211, p[0], p[1], p[2], e, 0., 0., 0., 0., 0., 0., 0., kPPrimary,
+                      ntr, 1., 0);
+    }
+    phaseMs[0] += elapsedMs(start);
+    phaseCalls[0] += nParticles;
+
+    start = Clock_t::now();
+    for (size_t i = 0; i < hitTracks.size(); i++) {
+      stack.AddPoint(kAliIts, hitTracks[i]);
+      detector.addPoint(hitTracks[i]);
+    }
+    phaseMs[1] += elapsedMs(start);
+    phaseCalls[1] += hitTracks.size();
+
+    start = Clock_t::now();
+    stack.FillTrackArray();
+    phaseMs[2] += elapsedMs(start);
+    phaseCalls[2] += nParticles;
+
+    start = Clock_t::now();
+    stack.UpdateTrackIndex(&detList);
+    phaseMs[3] += elapsedMs(start);
+    phaseCalls[3] += hitTracks.size();
+
+    start = Clock_t::now();
+    stack.Reset();
+    detector.Reset();
+    phaseMs[4] += elapsedMs(start);
+    phaseCalls[4] += nParticles;
+  }
+
+  printf("%d events of %d primaries and %d secondaries, %.0f%% of the particles with points, %d thread(s)\n",
+         nEvents, nPrimaries, nSecondaries, hitFraction * 100, nThreads);
+  printf("%-18s %12s %12s\n", "phase", "ms/event", "ns/call");
+  for (int ip = 0; ip < kNPhases; ip++) {
+    printf("%-18s %12.2f %12.1f\n", phaseNames[ip], phaseMs[ip] / nEvents,
+           phaseCalls[ip] ? phaseMs[ip] * 1e6 / phaseCalls[ip] : 0.);
+  }
+  return 0;
+}
@@ -14,6 +14,11 @@
 #include "Chebyshev3DCalc.h"
 #include "FairLogger.h"
 
+#ifdef _INC_CREATION_Chebyshev3D_
+#include <thread>
+#include <vector>
+#endif
+
 using namespace AliceO2::Field;
 
 ClassImp(Chebyshev3D)
@@ -27,6 +32,7 @@ Chebyshev3D::Chebyshev3D()
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mCompiledEvaluators(0),
     mLogger(FairLogger::GetLogger())
 {
   // Default constructor
@@ -48,6 +54,7 @@ Chebyshev3D::Chebyshev3D(const Chebyshev3D& src)
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(src.mUserFunctionName),
     mUserMacro(0),
+    mCompiledEvaluators(src.mCompiledEvaluators),
     mLogger(FairLogger::GetLogger())
 {
   // read coefs from text file
@@ -77,6 +84,7 @@ Chebyshev3D::Chebyshev3D(const char* inpFile)
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mCompiledEvaluators(0),
     mLogger(FairLogger::GetLogger())
 {
   // read coefs from text file
@@ -98,6 +106,7 @@ Chebyshev3D::Chebyshev3D(FILE* stream)
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mCompiledEvaluators(0),
     mLogger(FairLogger::GetLogger())
 {
   // read coefs from stream
@@ -122,6 +131,7 @@ Chebyshev3D::Chebyshev3D(const char* funName, int DimOut, const Float_t* bmin, c
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mCompiledEvaluators(0),
     mLogger(FairLogger::GetLogger())
 {
   if (DimOut < 1) {
@@ -153,6 +163,7 @@ Chebyshev3D::Chebyshev3D(void (*ptr)(float*, float*), int DimOut, Float_t* bmin,
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mCompiledEvaluators(0),
     mLogger(FairLogger::GetLogger())
 {
   if (DimOut < 1) {
@@ -188,6 +199,7 @@ Chebyshev3D::Chebyshev3D(void (*ptr)(float*, float*), int DimOut, Float_t* bmin,
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mCompiledEvaluators(0),
     mLogger(FairLogger::GetLogger())
 {
   if (DimOut < 1) {
@@ -228,6 +240,7 @@ Chebyshev3D::Chebyshev3D(void (*ptr)(float*, float*), int DimOut, Float_t* bmin,
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mCompiledEvaluators(0),
     mLogger(FairLogger::GetLogger())
 {
   if (DimOut != 3) {
@@ -271,6 +284,7 @@ Chebyshev3D& Chebyshev3D::operator=(const Chebyshev3D& rhs)
     mMaxCoefficients = rhs.mMaxCoefficients;
     mUserFunctionName = rhs.mUserFunctionName;
     mUserMacro = 0;
+    mCompiledEvaluators = rhs.mCompiledEvaluators;
     for (int i = 3; i--;) {
       mMinBoundaries[i] = rhs.mMinBoundaries[i];
       mMaxBoundaries[i] = rhs.mMaxBoundaries[i];
@@ -324,6 +338,46 @@ void Chebyshev3D::Print(const Option_t* opt) const
   }
 }
 
+void Chebyshev3D::Eval(Int_t np, const Double_t* par0, const Double_t* par1, const Double_t* par2,
+                       Double_t* const* res) const
+{
+  // map the arguments chunk by chunk to [-1:1] and evaluate every output dimension over the whole chunk
+  const int kChunk = 16 * Chebyshev3DCalc::kPointsPerPass;
+  Float_t mapped[3][kChunk], out[kChunk];
+  for (int beg = 0; beg < np; beg += kChunk) {
+    int nc = TMath::Min(kChunk, np - beg);
+    for (int ip = 0; ip < nc; ip++) {
+      mapped[0][ip] = mapToInternal(par0[beg + ip], 0);
+      mapped[1][ip] = mapToInternal(par1[beg + ip], 1);
+      mapped[2][ip] = mapToInternal(par2[beg + ip], 2);
+    }
+    for (int i = mOutputArrayDimension; i--;) {
+      if (!res[i]) {
+        continue;
+      }
+      getChebyshevCalc(i)->Eval(nc, mapped[0], mapped[1], mapped[2], out);
+      for (int ip = 0; ip < nc; ip++) {
+        res[i][beg + ip] = out[ip];
+      }
+    }
+  }
+}
+
+void Chebyshev3D::saveCompiledEvaluator(FILE* stream, const char* name) const
+{
+  for (int i = 0; i < mOutputArrayDimension; i++) {
+    getChebyshevCalc(i)->saveCompiledEvaluator(stream, Form("%s_%dCalc", name, i));
+  }
+  for (int i = 0; i < mOutputArrayDimension; i++) {
+    fprintf(stream, "Double_t %s_%d(const Double_t* par)\n{\n  return %s_%dCalc(", name, i, name, i);
+    for (int d = 0; d < 3; d++) {
+      fprintf(stream, "%s\n    CompiledFieldMap::mapToInternal(par[%d], %+.8ef, %+.8ef)", d ? "," : "", d,
+              mBoundaryMappingOffset[d], mBoundaryMappingScale[d]);
+    }
+    fprintf(stream, ");\n}\n\n");
+  }
+}
+
 void Chebyshev3D::prepareBoundaries(const Float_t* bmin, const Float_t* bmax)
 {
   // Set and check boundaries defined by user, prepare coefficients for their conversion to [-1:1] interval
@@ -345,6 +399,48 @@ void Chebyshev3D::prepareBoundaries(const Float_t* bmin, const Float_t* bmax)
 // Pointer on user function (faster altrnative to TMethodCall)
 void (*gUsrFunChebyshev3D)(float*, float*);
 
+Int_t Chebyshev3D::sNumberOfFitThreads = 1;
+
+/// Calls fun(i) for i in [0:n), distributing the calls over nThreads threads
+template <typename F>
+static void runFitSlices(int nThreads, int n, F fun)
+{
+  if (nThreads < 2 || n < 2) {
+    for (int i = 0; i < n; i++) {
+      fun(i);
+    }
+    return;
+  }
+  std::vector<std::thread> workers;
+  for (int ith = 0; ith < nThreads && ith < n; ith++) {
+    workers.push_back(std::thread([=]() {
+      for (int i = ith; i < n; i += nThreads) {
+        fun(i);
+      }
+    }));
+  }
+  for (size_t ith = 0; ith < workers.size(); ith++) {
+    workers[ith].join();
+  }
+}
+
+Int_t Chebyshev3D::getNumberOfThreadsForUserFunction() const
+{
+  // the function from the user macro is called via shared TMethodCall and buffers, hence only serially
+  return gUsrFunChebyshev3D ? sNumberOfFitThreads : 1;
+}
+
+void Chebyshev3D::sampleUserFunction(const Float_t* x, Float_t* res)
+{
+  // evaluate user function value without the shared buffers when it is given by the pointer
+  if (gUsrFunChebyshev3D) {
+    Float_t xloc[3] = { x[0], x[1], x[2] };
+    gUsrFunChebyshev3D(xloc, res);
+  } else {
+    evaluateUserFunction(x, res);
+  }
+}
+
 void Chebyshev3D::evaluateUserFunction()
 {
   // call user supplied function
@@ -508,75 +604,62 @@ Int_t Chebyshev3D::chebyshevFit()
 Int_t Chebyshev3D::chebyshevFit(int dmOut)
 {
   // prepare paramaterization of 3D function for dmOut-th dimension
+  // The sampling of the user function with the 1D fits in the 0-th and 1-st dimensions is independent for each
+  // slice in the 2-nd dimension, and the fits in the 2-nd dimension are independent for each row. These are
+  // distributed over the fit threads, each slice being processed exactly as in the serial fit and written to its
+  // own part of the buffers, so the result does not depend on the number of threads
   int maxDim = 0;
   for (int i = 0; i < 3; i++) {
     if (maxDim < mNumberOfPoints[i]) {
       maxDim = mNumberOfPoints[i];
     }
   }
-  Float_t* fvals = new Float_t[mNumberOfPoints[0]];
   Float_t* tmpCoef3D = new Float_t[mNumberOfPoints[0] * mNumberOfPoints[1] * mNumberOfPoints[2]];
-  Float_t* tmpCoef2D = new Float_t[mNumberOfPoints[0] * mNumberOfPoints[1]];
-  Float_t* tmpCoef1D = new Float_t[maxDim];
 
   Float_t rTiny = 0.1 * mPrecision / Float_t(maxDim); // neglect coefficient below this threshold
 
-  // 1D Cheb.fit for 0-th dimension at current steps of remaining dimensions
-  int ncmax = 0;
-
-  printf("Dim%d : 00.00%% Done", dmOut);
-  fflush(stdout);
+  int nThreads = getNumberOfThreadsForUserFunction();
+  printf("Dim%d : fitting on %d thread(s)\n", dmOut, nThreads);
   Chebyshev3DCalc* cheb = getChebyshevCalc(dmOut);
 
-  float ncals2count = mNumberOfPoints[2] * mNumberOfPoints[1] * mNumberOfPoints[0];
-  float ncals = 0;
-  float frac = 0;
-  float fracStep = 0.001;
-
-  for (int id2 = mNumberOfPoints[2]; id2--;) {
-    mTemporaryCoefficient[2] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[2] + id2];
-
+  runFitSlices(nThreads, mNumberOfPoints[2], [&](int id2) {
+    std::vector<Float_t> fvals(mNumberOfPoints[0]), tmpCoef1D(maxDim), res(mOutputArrayDimension);
+    std::vector<Float_t> tmpCoef2D(mNumberOfPoints[0] * mNumberOfPoints[1]);
+    Float_t xyz[3];
+    xyz[2] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[2] + id2];
+    // 1D Cheb.fit for 0-th dimension at current steps of remaining dimensions
     for (int id1 = mNumberOfPoints[1]; id1--;) {
-      mTemporaryCoefficient[1] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[1] + id1];
-
+      xyz[1] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[1] + id1];
       for (int id0 = mNumberOfPoints[0]; id0--;) {
-        mTemporaryCoefficient[0] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[0] + id0];
-        evaluateUserFunction(); // compute function values at Chebyshev roots of 0-th dimension
-        fvals[id0] = mTemporaryUserResults[dmOut];
-        float fr = (++ncals) / ncals2count;
-        if (fr - frac >= fracStep) {
-          frac = fr;
-          printf("\b\b\b\b\b\b\b\b\b\b\b");
-          printf("%05.2f%% Done", fr * 100);
-          fflush(stdout);
-        }
+        xyz[0] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[0] + id0];
+        sampleUserFunction(xyz, &res[0]); // compute function values at Chebyshev roots of 0-th dimension
+        fvals[id0] = res[dmOut];
       }
-      int nc = calculateChebyshevCoefficients(fvals, mNumberOfPoints[0], tmpCoef1D, mPrecision);
+      calculateChebyshevCoefficients(&fvals[0], mNumberOfPoints[0], &tmpCoef1D[0], mPrecision);
       for (int id0 = mNumberOfPoints[0]; id0--;) {
         tmpCoef2D[id1 + id0 * mNumberOfPoints[1]] = tmpCoef1D[id0];
       }
-      if (ncmax < nc) {
-        ncmax = nc; // max coefs to be kept in dim0 to guarantee needed precision
-      }
     }
     // once each 1d slice of given 2d slice is parametrized, parametrize the Cheb.coeffs
     for (int id0 = mNumberOfPoints[0]; id0--;) {
-      calculateChebyshevCoefficients(tmpCoef2D + id0 * mNumberOfPoints[1], mNumberOfPoints[1], tmpCoef1D, -1);
+      calculateChebyshevCoefficients(&tmpCoef2D[id0 * mNumberOfPoints[1]], mNumberOfPoints[1], &tmpCoef1D[0], -1);
       for (int id1 = mNumberOfPoints[1]; id1--;) {
         tmpCoef3D[id2 + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1])] = tmpCoef1D[id1];
       }
     }
-  }
+  });
+
   // now fit the last dimensions Cheb.coefs
-  for (int id0 = mNumberOfPoints[0]; id0--;) {
+  runFitSlices(nThreads, mNumberOfPoints[0], [&](int id0) {
+    std::vector<Float_t> tmpCoef1D(maxDim);
     for (int id1 = mNumberOfPoints[1]; id1--;) {
-      calculateChebyshevCoefficients(tmpCoef3D + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1]),
-                                     mNumberOfPoints[2], tmpCoef1D, -1);
+      Float_t* row = tmpCoef3D + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1]);
+      calculateChebyshevCoefficients(row, mNumberOfPoints[2], &tmpCoef1D[0], -1);
       for (int id2 = mNumberOfPoints[2]; id2--;) {
-        tmpCoef3D[id2 + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1])] = tmpCoef1D[id2]; // store on place
+        row[id2] = tmpCoef1D[id2]; // store on place
       }
     }
-  }
+  });
 
   // now find 2D surface which separates significant coefficients of 3D matrix from nonsignificant ones (up to
   // mPrecision)
@@ -638,7 +721,7 @@ Int_t Chebyshev3D::chebyshevFit(int dmOut)
     nRows--;
   }
   // find max significant column and fill the permanent storage for the max sigificant column of each row
-  cheb->initRows(nRows); // create needed arrays;
+  cheb->initializeRows(nRows); // create needed arrays;
   UShort_t* nColsAtRow = cheb->getNumberOfColumnsAtRow();
   UShort_t* colAtRowBg = cheb->GetColAtRowBg();
   int nCols = 0;
@@ -651,12 +734,12 @@ Int_t Chebyshev3D::chebyshevFit(int dmOut)
       nCols = nColsAtRow[id0];
     }
   }
-  cheb->initCols(nCols);
+  cheb->initializeColumns(nCols);
   delete[] tmpCols;
 
   // create the 2D matrix defining the boundary of significance for 3D coeffs.matrix
   // and count the number of siginifacnt coefficients
-  cheb->InitElemBound2D(nElemBound2D);
+  cheb->initializeElementBound2D(nElemBound2D);
   UShort_t* coefBound2D0 = cheb->getCoefficientBound2D0();
   UShort_t* coefBound2D1 = cheb->getCoefficientBound2D1();
   mMaxCoefficients = 0; // redefine number of coeffs
@@ -695,13 +778,9 @@ Int_t Chebyshev3D::chebyshevFit(int dmOut)
   //}
 
   delete[] tmpCoefSurf;
-  delete[] tmpCoef1D;
-  delete[] tmpCoef2D;
   delete[] tmpCoef3D;
-  delete[] fvals;
 
-  printf("\b\b\b\b\b\b\b\b\b\b\b\b");
-  printf("100.00%% Done\n");
+  printf("Dim%d : 100.00%% Done\n", dmOut);
   return 1;
 }
 #endif
@@ -821,6 +900,58 @@ void Chebyshev3D::loadData(FILE* stream)
   }
 }
 
+void Chebyshev3D::saveBinaryData(FILE* stream) const
+{
+  Int_t dimOut = mOutputArrayDimension;
+  Chebyshev3DCalc::writeBinaryBlock(stream, &dimOut, sizeof(Int_t));
+  Float_t range[7] = { mPrecision };
+  for (int i = 3; i--;) {
+    range[1 + i] = mMinBoundaries[i];
+    range[4 + i] = mMaxBoundaries[i];
+  }
+  Chebyshev3DCalc::writeBinaryBlock(stream, range, sizeof(range));
+  for (int i = 0; i < mOutputArrayDimension; i++) {
+    getChebyshevCalc(i)->saveBinaryData(stream);
+  }
+}
+
+const char* Chebyshev3D::mapBinaryData(const char* data, const char* end)
+{
+  Clear();
+  const Int_t* dimOut = (const Int_t*)Chebyshev3DCalc::readBinaryBlock(data, end, sizeof(Int_t));
+  const Float_t* range = (const Float_t*)Chebyshev3DCalc::readBinaryBlock(data, end, 7 * sizeof(Float_t));
+  // every output dimension starts with the 4 counts of its parameterization
+  if (!data || *dimOut < 1 || size_t(*dimOut) > size_t(end - data) / (4 * sizeof(Int_t))) {
+    return 0;
+  }
+  for (int i = 3; i--;) {
+    if (!(range[1 + i] < range[4 + i])) {
+      return 0;
+    }
+  }
+  setDimOut(*dimOut);
+  mPrecision = range[0];
+  prepareBoundaries(range + 1, range + 4);
+  for (int i = 0; i < mOutputArrayDimension && data; i++) {
+    data = getChebyshevCalc(i)->mapBinaryData(data, end);
+  }
+  return data;
+}
+
+Int_t Chebyshev3D::packData(char* arena, size_t& hotOffset, size_t& coldOffset, Float_t tolerance)
+{
+  Int_t nQuantized = 0;
+  for (int i = 0; i < mOutputArrayDimension; i++) {
+    Chebyshev3DCalc* calc = getChebyshevCalc(i);
+    Bool_t quantize = tolerance > 0 && calc->quantizeCoefficients(0, 0) <= tolerance;
+    calc->packData(arena, hotOffset, coldOffset, quantize);
+    if (quantize) {
+      nQuantized++;
+    }
+  }
+  return nQuantized;
+}
+
 void Chebyshev3D::setDimOut(const int d)
 {
   // init output dimensions
@@ -880,36 +1011,37 @@ TH1* Chebyshev3D::TestRMS(int idim, int npoints, TH1* histo)
 void Chebyshev3D::estimateNumberOfPoints(float Prec, int gridBC[3][3], Int_t npd1, Int_t npd2, Int_t npd3)
 {
   // Estimate number of points to generate a training data
+  // The kScp*kScp test lines of each dimension are independent and are distributed over the fit threads
   const int kScp = 9;
   const float kScl[9] = { 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9 };
 
   const float sclDim[2] = { 0.001, 0.999 };
   const int compDim[3][2] = { { 1, 2 }, { 2, 0 }, { 0, 1 } };
-  static float xyz[3];
   Int_t npdTst[3] = { npd1, npd2, npd3 };
+  std::vector<int> nptLines(3 * 3 * kScp * kScp);
+
+  runFitSlices(getNumberOfThreadsForUserFunction(), 3 * kScp * kScp, [&](int line) {
+    int idim = line / (kScp * kScp), i1 = (line / kScp) % kScp, i2 = line % kScp;
+    float dimMN = mMinBoundaries[idim] + sclDim[0] * (mMaxBoundaries[idim] - mMinBoundaries[idim]);
+    float dimMX = mMinBoundaries[idim] + sclDim[1] * (mMaxBoundaries[idim] - mMinBoundaries[idim]);
+    int id1 = compDim[idim][0]; // 1st fixed dim
+    int id2 = compDim[idim][1]; // 2nd fixed dim
+    float xyz[3];
+    xyz[id1] = mMinBoundaries[id1] + kScl[i1] * (mMaxBoundaries[id1] - mMinBoundaries[id1]);
+    xyz[id2] = mMinBoundaries[id2] + kScl[i2] * (mMaxBoundaries[id2] - mMinBoundaries[id2]);
+    getNcNeeded(xyz, idim, dimMN, dimMX, Prec, npdTst[idim], &nptLines[3 * line]); // npoints for Bx,By,Bz
+  });
 
   for (int i = 3; i--;) {
     for (int j = 3; j--;) {
       gridBC[i][j] = -1;
     }
   }
-
-  for (int idim = 0; idim < 3; idim++) {
-    float dimMN = mMinBoundaries[idim] + sclDim[0] * (mMaxBoundaries[idim] - mMinBoundaries[idim]);
-    float dimMX = mMinBoundaries[idim] + sclDim[1] * (mMaxBoundaries[idim] - mMinBoundaries[idim]);
-
-    int id1 = compDim[idim][0]; // 1st fixed dim
-    int id2 = compDim[idim][1]; // 2nd fixed dim
-    for (int i1 = 0; i1 < kScp; i1++) {
-      xyz[id1] = mMinBoundaries[id1] + kScl[i1] * (mMaxBoundaries[id1] - mMinBoundaries[id1]);
-      for (int i2 = 0; i2 < kScp; i2++) {
-        xyz[id2] = mMinBoundaries[id2] + kScl[i2] * (mMaxBoundaries[id2] - mMinBoundaries[id2]);
-        int* npt = getNcNeeded(xyz, idim, dimMN, dimMX, Prec, npdTst[idim]); // npoints for Bx,By,Bz
-        for (int ib = 0; ib < 3; ib++) {
-          if (npt[ib] > gridBC[ib][idim]) {
-            gridBC[ib][idim] = npt[ib];
-          }
-        }
+  for (int line = 0; line < 3 * kScp * kScp; line++) {
+    int idim = line / (kScp * kScp);
+    for (int ib = 0; ib < 3; ib++) {
+      if (nptLines[3 * line + ib] > gridBC[ib][idim]) {
+        gridBC[ib][idim] = nptLines[3 * line + ib];
       }
     }
   }
@@ -991,47 +1123,31 @@ void Chebyshev3D::estimateNumberOfPoints(float Prec, int gridBC[3][3], Int_t npd
 //   return retNC;
 // }
 
-int* Chebyshev3D::getNcNeeded(float xyz[3], int DimVar, float mn, float mx, float prec, Int_t npCheck)
+void Chebyshev3D::getNcNeeded(const float xyz[3], int DimVar, float mn, float mx, float prec, Int_t npCheck,
+                              int* retNC)
 {
   // estimate needed number of chebyshev coefs for given function description in DimVar dimension
-  // The values for two other dimensions must be set beforehand
-  static int retNC[3];
-  static int npChLast = 0;
-  static float* gridVal = 0, *coefs = 0;
+  // The values for two other dimensions are taken from xyz
   if (npCheck < 3) {
     npCheck = 3;
   }
-  if (npChLast < npCheck) {
-    if (gridVal) {
-      delete[] gridVal;
-    }
-    if (coefs) {
-      delete[] coefs;
-    }
-    gridVal = new float[3 * npCheck];
-    coefs = new float[3 * npCheck];
-    npChLast = npCheck;
-  }
+  std::vector<float> gridVal(3 * npCheck), coefs(3 * npCheck), res(mOutputArrayDimension);
   float scale = mx - mn;
   float offs = mn + scale / 2.0;
   scale = 2. / scale;
 
-  for (int i = 0; i < 3; i++) {
-    mTemporaryCoefficient[i] = xyz[i];
-  }
+  float pnt[3] = { xyz[0], xyz[1], xyz[2] };
   for (int i = 0; i < npCheck; i++) {
-    mTemporaryCoefficient[DimVar] =
-      TMath::Cos(TMath::Pi() * (i + 0.5) / npCheck) / scale + offs; // map to requested interval
-    evaluateUserFunction();
+    pnt[DimVar] = TMath::Cos(TMath::Pi() * (i + 0.5) / npCheck) / scale + offs; // map to requested interval
+    sampleUserFunction(pnt, &res[0]);
     for (int ib = 3; ib--;) {
-      gridVal[ib * npCheck + i] = mTemporaryUserResults[ib];
+      gridVal[ib * npCheck + i] = res[ib];
     }
   }
   for (int ib = 0; ib < 3; ib++) {
     retNC[ib] =
       Chebyshev3D::calculateChebyshevCoefficients(&gridVal[ib * npCheck], npCheck, &coefs[ib * npCheck], prec);
   }
-  return retNC;
 }
 
 #endif
@@ -8,6 +8,7 @@
 #include <TNamed.h>
 #include <TObjArray.h>
 #include "Chebyshev3DCalc.h"
+#include "CompiledFieldMap.h"
 
 class TString;
 class TSystem;
@@ -48,6 +49,8 @@ namespace Field {
 /// void Print(option="") will print the name, the ranges of validity and the absolute precision of the
 /// parameterization. Option "l" will also print the information about the number of coefficients for each output
 /// dimension.
+/// The creation methods are compiled only with _INC_CREATION_Chebyshev3D_ defined, see the FIELD_FIT option of
+/// field/CMakeLists.txt.
 /// NOTE: during the evaluation no check is done for parameter vector being outside the interpolation region.
 /// If there is such a risk, use Bool_t isInside(float *par) method. Chebyshev parameterization is not
 /// good for extrapolation!
@@ -111,10 +114,20 @@ public:
   }
 
   Chebyshev3D& operator=(const Chebyshev3D& rhs);
-  void Eval(const Float_t* par, Float_t* res);
-  Float_t Eval(const Float_t* par, int idim);
-  void Eval(const Double_t* par, Double_t* res);
-  Double_t Eval(const Double_t* par, int idim);
+  /// The Eval methods use no shared scratch and can be called concurrently from several threads
+  void Eval(const Float_t* par, Float_t* res) const;
+  Float_t Eval(const Float_t* par, int idim) const;
+  void Eval(const Double_t* par, Double_t* res) const;
+  Double_t Eval(const Double_t* par, int idim) const;
+
+  /// Evaluates Chebyshev parameterization for np points given as separate arrays of the 3 arguments,
+  /// res[i] receives the np values of the i-th output dimension, the dimensions with null res[i] are skipped.
+  /// All points are evaluated with the multi-point Chebyshev3DCalc::Eval
+  void Eval(Int_t np, const Double_t* par0, const Double_t* par1, const Double_t* par2, Double_t* const* res) const;
+
+  /// Evaluates idim-th output dimension and fills grad with its derivatives over the 3 arguments.
+  /// Uses no shared scratch and can be called concurrently, unlike evaluateDerivative
+  Double_t evaluateGradient(const Double_t* par, int idim, Double_t* grad) const;
 
   void evaluateDerivative(int dimd, const Float_t* par, Float_t* res);
   void evaluateDerivative2(int dimd1, int dimd2, const Float_t* par, Float_t* res);
@@ -131,6 +144,11 @@ public:
     return (Chebyshev3DCalc*)mChebyshevParameter.UncheckedAt(i);
   }
 
+  Int_t getNumberOfOutputDimensions() const
+  {
+    return mOutputArrayDimension;
+  }
+
   Float_t getBoundMin(int i) const
   {
     return mMinBoundaries[i];
@@ -161,9 +179,37 @@ public:
   void loadData(const char* inpFile);
   void loadData(FILE* stream);
 
+  /// Writes the parameterization to the stream in the binary format, see Chebyshev3DCalc::saveBinaryData
+  void saveBinaryData(FILE* stream) const;
+
+  /// Initializes from the binary data produced by saveBinaryData, ending at end, the coefficients are not
+  /// copied. Returns the pointer beyond the data of this object, 0 if the data are corrupted
+  const char* mapBinaryData(const char* data, const char* end);
+
+  /// Packs the data of the parameterizations of all output dimensions into the arena one after another, see
+  /// Chebyshev3DCalc::packData. If tolerance>0, those whose error with quantized coefficients does not exceed it
+  /// are quantized. With arena=0 only the offsets are moved. Returns the number of quantized parameterizations
+  Int_t packData(char* arena, size_t& hotOffset, size_t& coldOffset, Float_t tolerance);
+
+  /// Writes C++ code of functions Double_t name_i(const Double_t* par) evaluating the i-th output dimension with
+  /// the boundary mapping and the coefficients fixed at compile time, see CompiledFieldMap
+  void saveCompiledEvaluator(FILE* stream, const char* name) const;
+
+  /// Sets the generated functions evaluating each output dimension, used by the single point Eval methods
+  /// with Double_t arguments in place of the coefficients. 0 restores the evaluation of the coefficients
+  void setCompiledEvaluators(const CompiledFieldMap::Evaluator_t* evaluators)
+  {
+    mCompiledEvaluators = evaluators;
+  }
+
+  const CompiledFieldMap::Evaluator_t* getCompiledEvaluators() const
+  {
+    return mCompiledEvaluators;
+  }
+
 #ifdef _INC_CREATION_Chebyshev3D_
   void invertSign();
-  int* getNcNeeded(float xyz[3], int DimVar, float mn, float mx, float prec, Int_t npCheck = 30);
+  void getNcNeeded(const float xyz[3], int DimVar, float mn, float mx, float prec, Int_t npCheck, int* retNC);
   void estimateNumberOfPoints(float Prec, int gridBC[3][3], Int_t npd1 = 30, Int_t npd2 = 30, Int_t npd3 = 30);
   void saveData(const char* outfile, Bool_t append = kFALSE) const;
   void saveData(FILE* stream = stdout) const;
@@ -173,6 +219,19 @@ public:
   void evaluateUserFunction(const Float_t* x, Float_t* res);
   TH1* TestRMS(int idim, int npoints = 1000, TH1* histo = 0);
   static Int_t calculateChebyshevCoefficients(const Float_t* funval, int np, Float_t* outCoefs, Float_t prec = -1);
+
+  /// Sets the number of threads used to sample the user function and to compute the coefficients.
+  /// The parameterization does not depend on it. More than 1 thread is used only for the user function set
+  /// by the pointer, which then must be reentrant
+  static void setNumberOfFitThreads(Int_t n)
+  {
+    sNumberOfFitThreads = n < 1 ? 1 : n;
+  }
+
+  static Int_t getNumberOfFitThreads()
+  {
+    return sNumberOfFitThreads;
+  }
 #endif
 
 protected:
@@ -182,6 +241,10 @@ protected:
 
 #ifdef _INC_CREATION_Chebyshev3D_
   void evaluateUserFunction();
+  /// Evaluates the user function without using the shared buffers when possible, res has DimOut elements
+  void sampleUserFunction(const Float_t* x, Float_t* res);
+  /// Number of threads the fit of the current user function can use
+  Int_t getNumberOfThreadsForUserFunction() const;
   void defineGrid(Int_t* npoints);
   Int_t chebyshevFit(); // fit all output dimensions
   Int_t chebyshevFit(int dmOut);
@@ -219,8 +282,13 @@ protected:
   Int_t mTemporaryChebyshevGridOffs[3]; //! start of grid for each dimension
   TString mUserFunctionName; //! name of user macro containing the function of  "void (*fcn)(float*,float*)" format
   TMethodCall* mUserMacro;   //! Pointer to MethodCall for function from user macro
+  const CompiledFieldMap::Evaluator_t* mCompiledEvaluators; //! optional generated evaluators of each dimension
   FairLogger* mLogger;       //!
 
+#ifdef _INC_CREATION_Chebyshev3D_
+  static Int_t sNumberOfFitThreads; ///< number of threads used for the fit
+#endif
+
   ClassDef(AliceO2::Field::Chebyshev3D, 2) // Chebyshev parametrization for 3D->N function
 };
 
@@ -247,43 +315,56 @@ inline Bool_t Chebyshev3D::isInside(const Double_t* par) const
 }
 
 /// Evaluates Chebyshev parameterization for 3d->DimOut function
-inline void Chebyshev3D::Eval(const Float_t* par, Float_t* res)
+inline void Chebyshev3D::Eval(const Float_t* par, Float_t* res) const
 {
+  Float_t mapped[3];
   for (int i = 3; i--;) {
-    mTemporaryCoefficient[i] = mapToInternal(par[i], i);
+    mapped[i] = mapToInternal(par[i], i);
   }
   for (int i = mOutputArrayDimension; i--;) {
-    res[i] = getChebyshevCalc(i)->Eval(mTemporaryCoefficient);
+    res[i] = getChebyshevCalc(i)->Eval(mapped);
   }
 }
 
 /// Evaluates Chebyshev parameterization for 3d->DimOut function
-inline void Chebyshev3D::Eval(const Double_t* par, Double_t* res)
+inline void Chebyshev3D::Eval(const Double_t* par, Double_t* res) const
 {
+  if (mCompiledEvaluators) {
+    for (int i = mOutputArrayDimension; i--;) {
+      res[i] = mCompiledEvaluators[i](par);
+    }
+    return;
+  }
+  Float_t mapped[3];
   for (int i = 3; i--;) {
-    mTemporaryCoefficient[i] = mapToInternal(par[i], i);
+    mapped[i] = mapToInternal(par[i], i);
   }
   for (int i = mOutputArrayDimension; i--;) {
-    res[i] = getChebyshevCalc(i)->Eval(mTemporaryCoefficient);
+    res[i] = getChebyshevCalc(i)->Eval(mapped);
   }
 }
 
 /// Evaluates Chebyshev parameterization for idim-th output dimension of 3d->DimOut function
-inline Double_t Chebyshev3D::Eval(const Double_t* par, int idim)
+inline Double_t Chebyshev3D::Eval(const Double_t* par, int idim) const
 {
+  if (mCompiledEvaluators) {
+    return mCompiledEvaluators[idim](par);
+  }
+  Float_t mapped[3];
   for (int i = 3; i--;) {
-    mTemporaryCoefficient[i] = mapToInternal(par[i], i);
+    mapped[i] = mapToInternal(par[i], i);
   }
-  return getChebyshevCalc(idim)->Eval(mTemporaryCoefficient);
+  return getChebyshevCalc(idim)->Eval(mapped);
 }
 
 /// Evaluates Chebyshev parameterization for idim-th output dimension of 3d->DimOut function
-inline Float_t Chebyshev3D::Eval(const Float_t* par, int idim)
+inline Float_t Chebyshev3D::Eval(const Float_t* par, int idim) const
 {
+  Float_t mapped[3];
   for (int i = 3; i--;) {
-    mTemporaryCoefficient[i] = mapToInternal(par[i], i);
+    mapped[i] = mapToInternal(par[i], i);
   }
-  return getChebyshevCalc(idim)->Eval(mTemporaryCoefficient);
+  return getChebyshevCalc(idim)->Eval(mapped);
 }
 
 /// Returns the gradient matrix
@@ -315,6 +396,20 @@ inline void Chebyshev3D::evaluateDerivative3D2(const Float_t* par, Float_t dbdrd
   }
 }
 
+/// Evaluates idim-th output dimension and its gradient over the 3 arguments
+inline Double_t Chebyshev3D::evaluateGradient(const Double_t* par, int idim, Double_t* grad) const
+{
+  Float_t mapped[3], gradMapped[3];
+  for (int i = 3; i--;) {
+    mapped[i] = mapToInternal(par[i], i);
+  }
+  Double_t res = getChebyshevCalc(idim)->evaluateGradient(mapped, gradMapped);
+  for (int i = 3; i--;) {
+    grad[i] = gradMapped[i] * mBoundaryMappingScale[i];
+  }
+  return res;
+}
+
 // Evaluates Chebyshev parameterization derivative for 3d->DimOut function
 inline void Chebyshev3D::evaluateDerivative(int dimd, const Float_t* par, Float_t* res)
 {
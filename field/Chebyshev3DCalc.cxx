@@ -3,6 +3,8 @@
 /// \author ruben.shahoyan@cern.ch 09/09/2006
 
 #include <cstdlib>
+#include <cstring>
+#include <TMath.h>
 #include <TSystem.h>
 #include "Chebyshev3DCalc.h"
 
@@ -21,7 +23,10 @@ Chebyshev3DCalc::Chebyshev3DCalc()
     mCoefficientBound2D1(0),
     mCoefficients(0),
     mTemporaryCoefficients2D(0),
-    mTemporaryCoefficients1D(0)
+    mTemporaryCoefficients1D(0),
+    mIsMapped(kFALSE),
+    mQuantizationScale(0),
+    mQuantizedCoefficients(0)
 {
 }
 
@@ -37,7 +42,10 @@ Chebyshev3DCalc::Chebyshev3DCalc(const Chebyshev3DCalc& src)
     mCoefficientBound2D1(0),
     mCoefficients(0),
     mTemporaryCoefficients2D(0),
-    mTemporaryCoefficients1D(0)
+    mTemporaryCoefficients1D(0),
+    mIsMapped(kFALSE),
+    mQuantizationScale(0),
+    mQuantizedCoefficients(0)
 {
   if (src.mNumberOfColumnsAtRow) {
     mNumberOfColumnsAtRow = new UShort_t[mNumberOfRows];
@@ -88,7 +96,10 @@ Chebyshev3DCalc::Chebyshev3DCalc(FILE* stream)
     mCoefficientBound2D1(0),
     mCoefficients(0),
     mTemporaryCoefficients2D(0),
-    mTemporaryCoefficients1D(0)
+    mTemporaryCoefficients1D(0),
+    mIsMapped(kFALSE),
+    mQuantizationScale(0),
+    mQuantizedCoefficients(0)
 {
   loadData(stream);
 }
@@ -144,6 +155,13 @@ Chebyshev3DCalc& Chebyshev3DCalc::operator=(const Chebyshev3DCalc& rhs)
 
 void Chebyshev3DCalc::Clear(const Option_t*)
 {
+  mQuantizationScale = 0;
+  mQuantizedCoefficients = 0;
+  if (mIsMapped) { // the data arrays are not owned
+    mCoefficients = 0;
+    mCoefficientBound2D0 = mCoefficientBound2D1 = mNumberOfColumnsAtRow = mColumnAtRowBeginning = 0;
+    mIsMapped = kFALSE;
+  }
   if (mTemporaryCoefficients2D) {
     delete[] mTemporaryCoefficients2D;
     mTemporaryCoefficients2D = 0;
@@ -186,6 +204,97 @@ void Chebyshev3DCalc::Print(const Option_t*) const
   printf("%d coefficients in %dx%dx%d matrix\n", mNumberOfCoefficients, mNumberOfRows, mNumberOfColumns, nmax3d);
 }
 
+void Chebyshev3DCalc::Eval(Int_t np, const Float_t* x, const Float_t* y, const Float_t* z, Float_t* res) const
+{
+  int ip = 0;
+  for (; ip + kPointsPerPass <= np; ip += kPointsPerPass) {
+    evaluatePass(x + ip, y + ip, z + ip, res + ip);
+  }
+  int nleft = np - ip;
+  if (nleft > 0) { // pad the last incomplete pass by repeating its last point
+    Float_t xp[kPointsPerPass], yp[kPointsPerPass], zp[kPointsPerPass], rp[kPointsPerPass];
+    for (int l = 0; l < kPointsPerPass; l++) {
+      int i = ip + (l < nleft ? l : nleft - 1);
+      xp[l] = x[i];
+      yp[l] = y[i];
+      zp[l] = z[i];
+    }
+    evaluatePass(xp, yp, zp, rp);
+    for (int l = 0; l < nleft; l++) {
+      res[ip + l] = rp[l];
+    }
+  }
+}
+
+void Chebyshev3DCalc::evaluatePass(const Float_t* x, const Float_t* y, const Float_t* z, Float_t* res) const
+{
+  // The three nested Clenshaw recurrences of Eval are fused: the value of every column (row) is fed into
+  // the recurrence over columns (rows) as soon as it is computed, in the same order as in the scalar Eval.
+  // Each lane loop runs over kPointsPerPass independent points and is vectorized by the compiler.
+  const int kN = kPointsPerPass;
+  Float_t x2[kN], y2[kN], z2[kN];
+  Float_t xb0[kN], xb1[kN], xb2[kN], yb0[kN], yb1[kN], yb2[kN], zb0[kN], zb1[kN], zb2[kN];
+  for (int l = 0; l < kN; l++) {
+    x2[l] = x[l] + x[l];
+    y2[l] = y[l] + y[l];
+    z2[l] = z[l] + z[l];
+    xb0[l] = xb1[l] = 0;
+  }
+
+  for (int id0 = mNumberOfRows; id0--;) {
+    int nCLoc = mNumberOfColumnsAtRow[id0]; // number of significant coefs on this row
+    int col0 = mColumnAtRowBeginning[id0];  // beginning of local column in the 2D boundary matrix
+    for (int l = 0; l < kN; l++) {
+      yb0[l] = yb1[l] = 0;
+    }
+    for (int id1 = nCLoc; id1--;) {
+      int id = id1 + col0;
+      int ncfRC = mCoefficientBound2D0[id];
+      for (int l = 0; l < kN; l++) {
+        zb0[l] = zb1[l] = 0;
+      }
+      Float_t scale = 1.0f; // the recurrence is linear, the quantized series are scaled at the end
+      if (mQuantizedCoefficients) {
+        const Short_t* coefs = mQuantizedCoefficients + mCoefficientBound2D1[id];
+        scale = mQuantizationScale[id];
+        for (int i = ncfRC; i--;) {
+          Float_t cf = coefs[i];
+          for (int l = 0; l < kN; l++) {
+            zb2[l] = zb1[l];
+            zb1[l] = zb0[l];
+            zb0[l] = cf + z2[l] * zb1[l] - zb2[l];
+          }
+        }
+      } else {
+        const Float_t* coefs = mCoefficients + mCoefficientBound2D1[id];
+        for (int i = ncfRC; i--;) {
+          Float_t cf = coefs[i];
+          for (int l = 0; l < kN; l++) {
+            zb2[l] = zb1[l];
+            zb1[l] = zb0[l];
+            zb0[l] = cf + z2[l] * zb1[l] - zb2[l];
+          }
+        }
+      }
+      for (int l = 0; l < kN; l++) {
+        Float_t val = ncfRC ? scale * (zb0[l] - z[l] * zb1[l]) : 0.0f;
+        yb2[l] = yb1[l];
+        yb1[l] = yb0[l];
+        yb0[l] = val + y2[l] * yb1[l] - yb2[l];
+      }
+    }
+    for (int l = 0; l < kN; l++) {
+      Float_t val = nCLoc > 0 ? yb0[l] - y[l] * yb1[l] : 0.0f;
+      xb2[l] = xb1[l];
+      xb1[l] = xb0[l];
+      xb0[l] = val + x2[l] * xb1[l] - xb2[l];
+    }
+  }
+  for (int l = 0; l < kN; l++) {
+    res[l] = mNumberOfRows ? xb0[l] - x[l] * xb1[l] : 0.0f;
+  }
+}
+
 Float_t Chebyshev3DCalc::evaluateDerivative(int dim, const Float_t* par) const
 {
   int ncfRC;
@@ -258,6 +367,63 @@ Float_t Chebyshev3DCalc::evaluateDerivative2(int dim1, int dim2, const Float_t*
            : chebyshevEvaluation1D(par[0], mTemporaryCoefficients1D, mNumberOfRows);
 }
 
+Float_t Chebyshev3DCalc::evaluateGradient(const Float_t* par, Float_t* grad) const
+{
+  // The derivative of the Clenshaw sum b_k = a_k + 2x b_{k+1} - b_{k+2}, S = b_0 - x b_1 follows the recurrence
+  // d_k = 2 b_{k+1} + 2x d_{k+1} - d_{k+2}, S' = d_0 - b_1 - x d_1, so it is advanced together with the value.
+  // Over columns the z-sums and their z-derivatives are accumulated, over rows the y-sums of both with the
+  // y-derivative of the former, finally the x-sums of the three with the x-derivative of the value
+  Float_t x = par[0], y = par[1], z = par[2];
+  Float_t x2 = x + x, y2 = y + y, z2 = z + z;
+  Float_t xb0 = 0, xb1 = 0, xb2, xd0 = 0, xd1 = 0, xd2; // value and its x-derivative
+  Float_t xy0 = 0, xy1 = 0, xy2, xz0 = 0, xz1 = 0, xz2; // y- and z-derivatives
+  for (int id0 = mNumberOfRows; id0--;) {
+    int nCLoc = mNumberOfColumnsAtRow[id0]; // number of significant coefs on this row
+    int col0 = mColumnAtRowBeginning[id0];  // beginning of local column in the 2D boundary matrix
+    Float_t yb0 = 0, yb1 = 0, yb2, yd0 = 0, yd1 = 0, yd2, yz0 = 0, yz1 = 0, yz2;
+    for (int id1 = nCLoc; id1--;) {
+      int id = id1 + col0;
+      const Float_t* coefs = mCoefficients + mCoefficientBound2D1[id];
+      Float_t zb0 = 0, zb1 = 0, zb2, zd0 = 0, zd1 = 0, zd2;
+      for (int i = mCoefficientBound2D0[id]; i--;) {
+        zb2 = zb1;
+        zb1 = zb0;
+        zb0 = coefs[i] + z2 * zb1 - zb2;
+        zd2 = zd1;
+        zd1 = zd0;
+        zd0 = 2 * zb1 + z2 * zd1 - zd2;
+      }
+      Float_t val = zb0 - z * zb1, dvdz = zd0 - zb1 - z * zd1;
+      yb2 = yb1;
+      yb1 = yb0;
+      yb0 = val + y2 * yb1 - yb2;
+      yd2 = yd1;
+      yd1 = yd0;
+      yd0 = 2 * yb1 + y2 * yd1 - yd2;
+      yz2 = yz1;
+      yz1 = yz0;
+      yz0 = dvdz + y2 * yz1 - yz2;
+    }
+    Float_t val = yb0 - y * yb1, dwdy = yd0 - yb1 - y * yd1, dwdz = yz0 - y * yz1;
+    xb2 = xb1;
+    xb1 = xb0;
+    xb0 = val + x2 * xb1 - xb2;
+    xd2 = xd1;
+    xd1 = xd0;
+    xd0 = 2 * xb1 + x2 * xd1 - xd2;
+    xy2 = xy1;
+    xy1 = xy0;
+    xy0 = dwdy + x2 * xy1 - xy2;
+    xz2 = xz1;
+    xz1 = xz0;
+    xz0 = dwdz + x2 * xz1 - xz2;
+  }
+  grad[0] = xd0 - xb1 - x * xd1;
+  grad[1] = xy0 - x * xy1;
+  grad[2] = xz0 - x * xz1;
+  return xb0 - x * xb1;
+}
+
 #ifdef _INC_CREATION_ALICHEB3D_
 void Chebyshev3DCalc::saveData(const char* outfile, Bool_t append) const
 {
@@ -376,6 +542,178 @@ void Chebyshev3DCalc::readLine(TString& str, FILE* stream)
   exit(1); // normally, should not reach here
 }
 
+void Chebyshev3DCalc::writeBinaryBlock(FILE* stream, const void* data, size_t size)
+{
+  static const char kPadding[kBinaryAlignment] = { 0 };
+  if (size && fwrite(data, 1, size, stream) != size) {
+    fprintf(stderr, "Chebyshev3DCalc::writeBinaryBlock: Failed to write to stream.\nStop");
+    exit(1);
+  }
+  size_t npad = (kBinaryAlignment - size % kBinaryAlignment) % kBinaryAlignment;
+  if (npad) {
+    fwrite(kPadding, 1, npad, stream);
+  }
+}
+
+const char* Chebyshev3DCalc::readBinaryBlock(const char*& data, const char* end, size_t size)
+{
+  // sizes computed from corrupted negative counts wrap around and are rejected too
+  size_t padded = (size + kBinaryAlignment - 1) / kBinaryAlignment * kBinaryAlignment;
+  if (!data || padded < size || padded > size_t(end - data)) {
+    data = 0;
+    return 0;
+  }
+  const char* block = data;
+  data += padded;
+  return block;
+}
+
+void Chebyshev3DCalc::saveBinaryData(FILE* stream) const
+{
+  Int_t header[4] = { mNumberOfCoefficients, mNumberOfRows, mNumberOfColumns, mNumberOfElementsBound2D };
+  writeBinaryBlock(stream, header, sizeof(header));
+  writeBinaryBlock(stream, mNumberOfColumnsAtRow, mNumberOfRows * sizeof(UShort_t));
+  writeBinaryBlock(stream, mColumnAtRowBeginning, mNumberOfRows * sizeof(UShort_t));
+  writeBinaryBlock(stream, mCoefficientBound2D0, mNumberOfElementsBound2D * sizeof(UShort_t));
+  writeBinaryBlock(stream, mCoefficientBound2D1, mNumberOfElementsBound2D * sizeof(UShort_t));
+  writeBinaryBlock(stream, mCoefficients, mNumberOfCoefficients * sizeof(Float_t));
+}
+
+const char* Chebyshev3DCalc::mapBinaryData(const char* data, const char* end)
+{
+  Clear();
+  const Int_t* header = (const Int_t*)readBinaryBlock(data, end, 4 * sizeof(Int_t));
+  if (!header) {
+    return 0;
+  }
+  const char* colsAtRow = readBinaryBlock(data, end, header[1] * sizeof(UShort_t));
+  const char* colAtRowBg = readBinaryBlock(data, end, header[1] * sizeof(UShort_t));
+  const char* bound2D0 = readBinaryBlock(data, end, header[3] * sizeof(UShort_t));
+  const char* bound2D1 = readBinaryBlock(data, end, header[3] * sizeof(UShort_t));
+  const char* coefs = readBinaryBlock(data, end, header[0] * sizeof(Float_t));
+  // the longest row cannot have more columns than all rows together
+  if (!data || header[2] < 0 || header[2] > header[3]) {
+    return 0;
+  }
+  mNumberOfCoefficients = header[0];
+  mNumberOfRows = header[1];
+  mNumberOfColumns = header[2];
+  mNumberOfElementsBound2D = header[3];
+  mIsMapped = kTRUE;
+  mNumberOfColumnsAtRow = (UShort_t*)colsAtRow;
+  mColumnAtRowBeginning = (UShort_t*)colAtRowBg;
+  mCoefficientBound2D0 = (UShort_t*)bound2D0;
+  mCoefficientBound2D1 = (UShort_t*)bound2D1;
+  mCoefficients = (Float_t*)coefs;
+  // scratch space is needed only by the derivatives
+  mTemporaryCoefficients1D = new Float_t[mNumberOfRows];
+  mTemporaryCoefficients2D = new Float_t[mNumberOfColumns];
+  return data;
+}
+
+Float_t Chebyshev3DCalc::quantizeCoefficients(Float_t* scale, Short_t* quantized) const
+{
+  const Float_t kMaxQuantized = 32767;
+  Double_t error = 0;
+  for (int id = 0; id < mNumberOfElementsBound2D; id++) {
+    int ncf = mCoefficientBound2D0[id];
+    const Float_t* coefs = mCoefficients + mCoefficientBound2D1[id];
+    Float_t maxAbs = 0;
+    for (int i = ncf; i--;) {
+      maxAbs = TMath::Max(maxAbs, TMath::Abs(coefs[i]));
+    }
+    Float_t scl = maxAbs / kMaxQuantized;
+    for (int i = ncf; i--;) {
+      Short_t q = scl > 0 ? Short_t(TMath::Nint(coefs[i] / scl)) : 0;
+      error += TMath::Abs(coefs[i] - q * scl);
+      if (quantized) {
+        quantized[mCoefficientBound2D1[id] + i] = q;
+      }
+    }
+    if (scale) {
+      scale[id] = scl;
+    }
+  }
+  return error;
+}
+
+void* Chebyshev3DCalc::packBlock(char* arena, size_t& offset, const void* src, size_t size)
+{
+  char* block = arena ? arena + offset : 0;
+  if (block && src && size) {
+    memcpy(block, src, size);
+  }
+  offset += (size + kBinaryAlignment - 1) / kBinaryAlignment * kBinaryAlignment;
+  return block;
+}
+
+void Chebyshev3DCalc::packData(char* arena, size_t& hotOffset, size_t& coldOffset, Bool_t quantize)
+{
+  // the blocks are reserved in the order in which Eval reads them
+  void* ncAtRow = packBlock(arena, hotOffset, mNumberOfColumnsAtRow, mNumberOfRows * sizeof(UShort_t));
+  void* colAtRow = packBlock(arena, hotOffset, mColumnAtRowBeginning, mNumberOfRows * sizeof(UShort_t));
+  void* bound0 = packBlock(arena, hotOffset, mCoefficientBound2D0, mNumberOfElementsBound2D * sizeof(UShort_t));
+  void* bound1 = packBlock(arena, hotOffset, mCoefficientBound2D1, mNumberOfElementsBound2D * sizeof(UShort_t));
+  void *scale = 0, *quantized = 0;
+  if (quantize) {
+    scale = packBlock(arena, hotOffset, 0, mNumberOfElementsBound2D * sizeof(Float_t));
+    quantized = packBlock(arena, hotOffset, 0, mNumberOfCoefficients * sizeof(Short_t));
+  }
+  void* coefs = packBlock(arena, quantize ? coldOffset : hotOffset, mCoefficients,
+                          mNumberOfCoefficients * sizeof(Float_t));
+  if (!arena) {
+    return;
+  }
+  if (quantize) {
+    quantizeCoefficients((Float_t*)scale, (Short_t*)quantized);
+  }
+  if (!mIsMapped) { // the copies replace the owned arrays
+    delete[] mNumberOfColumnsAtRow;
+    delete[] mColumnAtRowBeginning;
+    delete[] mCoefficientBound2D0;
+    delete[] mCoefficientBound2D1;
+    delete[] mCoefficients;
+  }
+  mIsMapped = kTRUE;
+  mNumberOfColumnsAtRow = (UShort_t*)ncAtRow;
+  mColumnAtRowBeginning = (UShort_t*)colAtRow;
+  mCoefficientBound2D0 = (UShort_t*)bound0;
+  mCoefficientBound2D1 = (UShort_t*)bound1;
+  mCoefficients = (Float_t*)coefs;
+  mQuantizationScale = (const Float_t*)scale;
+  mQuantizedCoefficients = (const Short_t*)quantized;
+}
+
+void Chebyshev3DCalc::saveCompiledEvaluator(FILE* stream, const char* name) const
+{
+  // the floats are printed with 9 significant digits, which restores them exactly
+  fprintf(stream, "constexpr Float_t %sCoefs[%d] = {", name, TMath::Max(1, mNumberOfCoefficients));
+  for (int i = 0; i < mNumberOfCoefficients; i++) {
+    fprintf(stream, "%s%+.8ef", i % 4 ? ", " : (i ? ",\n  " : "\n  "), mCoefficients[i]);
+  }
+  fprintf(stream, "%s};\n\n", mNumberOfCoefficients ? "\n" : "0");
+  fprintf(stream, "Float_t %s(Float_t x, Float_t y, Float_t z)\n{\n", name);
+  if (!mNumberOfRows) {
+    fprintf(stream, "  return 0;\n}\n\n");
+    return;
+  }
+  int maxCol = 1;
+  for (int id0 = mNumberOfRows; id0--;) {
+    maxCol = TMath::Max(maxCol, int(mNumberOfColumnsAtRow[id0]));
+  }
+  fprintf(stream, "  const Float_t* c = %sCoefs;\n  Float_t col[%d], row[%d];\n", name, maxCol, mNumberOfRows);
+  for (int id0 = 0; id0 < mNumberOfRows; id0++) {
+    int nCLoc = mNumberOfColumnsAtRow[id0], col0 = mColumnAtRowBeginning[id0];
+    for (int id1 = 0; id1 < nCLoc; id1++) {
+      int id = id1 + col0;
+      fprintf(stream, "  col[%d] = CompiledFieldMap::clenshaw<%d>(c + %d, z);\n", id1, mCoefficientBound2D0[id],
+              mCoefficientBound2D1[id]);
+    }
+    fprintf(stream, "  row[%d] = CompiledFieldMap::clenshaw<%d>(col, y);\n", id0, nCLoc);
+  }
+  fprintf(stream, "  return CompiledFieldMap::clenshaw<%d>(row, x);\n}\n\n", mNumberOfRows);
+}
+
 void Chebyshev3DCalc::initializeRows(int nr)
 {
   if (mNumberOfColumnsAtRow) {
@@ -52,6 +52,11 @@ public:
   /// VERY IMPORTANT: par must contain the function arguments ALREADY MAPPED to [-1:1] interval
   Float_t evaluateDerivative2(int dim1, int dim2, const Float_t* par) const;
 
+  /// Evaluates Chebyshev parameterization and its gradient over the 3 arguments in a single pass over the
+  /// coefficients, grad must have 3 elements. Unlike evaluateDerivative it uses no shared scratch.
+  /// VERY IMPORTANT: par must contain the function arguments ALREADY MAPPED to [-1:1] interval
+  Float_t evaluateGradient(const Float_t* par, Float_t* grad) const;
+
 #ifdef _INC_CREATION_ALICHEB3D_
   /// Writes coefficients data to output text file, optionally appending on the end of existing file
   void saveData(const char* outfile, Bool_t append = kFALSE) const;
@@ -117,6 +122,10 @@ public:
 
   static Float_t chebyshevEvaluation1D(Float_t x, const Float_t* array, int ncf);
 
+  /// Evaluates 1D Chebyshev parameterization with quantized coefficients, the result is to be multiplied by their
+  /// scale. x is the argument mapped to [-1:1] interval
+  static Float_t chebyshevEvaluation1D(Float_t x, const Short_t* array, int ncf);
+
   /// Evaluates 1D Chebyshev parameterization's derivative. x is the argument mapped to [-1:1] interval
   static Float_t chebyshevEvaluation1Derivative(Float_t x, const Float_t* array, int ncf);
 
@@ -134,10 +143,72 @@ public:
   /// Reads single line from the stream, skipping empty and commented lines. EOF is not expected
   static void readLine(TString& str, FILE* stream);
 
+  /// Alignment of the blocks in the binary format
+  enum { kBinaryAlignment = 8 };
+
+  /// Writes a block of binary data to the stream, padding it to kBinaryAlignment bytes
+  static void writeBinaryBlock(FILE* stream, const void* data, size_t size);
+
+  /// Returns the beginning of the block of given size in the binary data and moves the data pointer beyond it.
+  /// If data is 0 or the block would overrun end, returns 0 and sets data to 0
+  static const char* readBinaryBlock(const char*& data, const char* end, size_t size);
+
+  /// Writes coefficients data to the stream in the binary format
+  void saveBinaryData(FILE* stream) const;
+
+  /// Initializes from the binary data produced by saveBinaryData, ending at end. The coefficients and bound
+  /// arrays are not copied but point to the data, which must stay valid for the lifetime of the object.
+  /// Returns the pointer beyond the data of this object, 0 if the data are corrupted
+  const char* mapBinaryData(const char* data, const char* end);
+
+  /// Quantizes the coefficients of every 1D series of the coefficient matrix to 16-bit integers with the scale
+  /// max|c|/32767 of the series, so that the small high order terms lose precision only relative to the leading
+  /// ones. scale (mNumberOfElementsBound2D) and quantized (mNumberOfCoefficients) may be 0 to get only the error.
+  /// Returns the bound on the absolute error of Eval with the quantized coefficients: as |T_n(x)|<=1 it is the
+  /// sum of the rounding errors of all coefficients
+  Float_t quantizeCoefficients(Float_t* scale, Short_t* quantized) const;
+
+  /// Copies the data used by Eval (the bound arrays and the coefficients, quantized by quantizeCoefficients if
+  /// quantize is set) to arena+hotOffset and, for the quantized case, the float coefficients, used only by the
+  /// derivatives and for saving, to arena+coldOffset, and makes the object use the copies, which must stay valid
+  /// for its lifetime. The offsets are moved beyond the copied data, aligned as in the binary format.
+  /// With arena=0 only the offsets are moved
+  void packData(char* arena, size_t& hotOffset, size_t& coldOffset, Bool_t quantize);
+
+  Bool_t isQuantized() const
+  {
+    return mQuantizedCoefficients != 0;
+  }
+
+  /// Writes C++ code of a function Float_t name(Float_t x, Float_t y, Float_t z) evaluating the parameterization
+  /// with a constexpr coefficient table and the recurrences unrolled for the fixed bounds, see CompiledFieldMap.
+  /// The arguments of the generated function must be mapped to [-1:1] interval
+  void saveCompiledEvaluator(FILE* stream, const char* name) const;
+
   Float_t Eval(const Float_t* par) const;
 
   Double_t Eval(const Double_t* par) const;
 
+  /// Number of points evaluated in lockstep by the multi-point Eval
+  enum { kPointsPerPass = 8 };
+
+  /// Evaluates Chebyshev parameterization for np points sharing this coefficient set.
+  /// The points are processed in groups of kPointsPerPass: the row/column bounds and the coefficients are
+  /// read once per group and the Clenshaw recurrences of all points of the group advance together.
+  /// VERY IMPORTANT: x, y and z must contain the function arguments ALREADY MAPPED to [-1:1] interval
+  void Eval(Int_t np, const Float_t* x, const Float_t* y, const Float_t* z, Float_t* res) const;
+
+protected:
+  /// Evaluates exactly kPointsPerPass points in lockstep, see multi-point Eval
+  void evaluatePass(const Float_t* x, const Float_t* y, const Float_t* z, Float_t* res) const;
+
+  /// Evaluates the 1D series id of the coefficient matrix at z, from the quantized coefficients if present
+  Float_t evaluateSeries(int id, Float_t z) const;
+
+  /// Reserves a block of given size at offset in the arena, aligned as in the binary format, and copies src to it
+  /// if both are given. Moves offset beyond the block and returns it, 0 if arena is 0
+  static void* packBlock(char* arena, size_t& offset, const void* src, size_t size);
+
 protected:
   Int_t mNumberOfCoefficients;    ///< total number of coeeficients
   Int_t mNumberOfRows;            ///< number of significant rows in the 3D coeffs matrix
@@ -155,8 +226,11 @@ protected:
   // coeffs for col/row
   Float_t* mCoefficients; //[mNumberOfCoefficients] array of Chebyshev coefficients
 
-  Float_t* mTemporaryCoefficients2D; //[mNumberOfColumns] temp. coeffs for 2d summation
-  Float_t* mTemporaryCoefficients1D; //[mNumberOfRows] temp. coeffs for 1d summation
+  Float_t* mTemporaryCoefficients2D;     //[mNumberOfColumns] temp. coeffs for 2d summation
+  Float_t* mTemporaryCoefficients1D;     //[mNumberOfRows] temp. coeffs for 1d summation
+  Bool_t mIsMapped;                      //! coefficients and bounds point to external binary data, not owned
+  const Float_t* mQuantizationScale;     //! scales of the quantized 1D series in the packed arena, or 0
+  const Short_t* mQuantizedCoefficients; //! coefficients quantized by quantizeCoefficients in the packed arena, or 0
 
   ClassDef(AliceO2::Field::Chebyshev3DCalc, 2) // Class for interpolation of 3D->1 function by Chebyshev parametrization
 };
@@ -180,6 +254,35 @@ inline Float_t Chebyshev3DCalc::chebyshevEvaluation1D(Float_t x, const Float_t*
   return b0 - x * b1;
 }
 
+inline Float_t Chebyshev3DCalc::chebyshevEvaluation1D(Float_t x, const Short_t* array, int ncf)
+{
+  if (ncf <= 0) {
+    return 0;
+  }
+
+  Float_t b0, b1, b2, x2 = x + x;
+  b0 = array[--ncf];
+  b1 = b2 = 0;
+
+  for (int i = ncf; i--;) {
+    b2 = b1;
+    b1 = b0;
+    b0 = array[i] + x2 * b1 - b2;
+  }
+  return b0 - x * b1;
+}
+
+inline Float_t Chebyshev3DCalc::evaluateSeries(int id, Float_t z) const
+{
+  int ncf = mCoefficientBound2D0[id];
+  if (!ncf) {
+    return 0;
+  }
+  return mQuantizedCoefficients
+           ? mQuantizationScale[id] * chebyshevEvaluation1D(z, mQuantizedCoefficients + mCoefficientBound2D1[id], ncf)
+           : chebyshevEvaluation1D(z, mCoefficients + mCoefficientBound2D1[id], ncf);
+}
+
 /// Evaluates Chebyshev parameterization for 3D function.
 /// VERY IMPORTANT: par must contain the function arguments ALREADY MAPPED to [-1:1] interval
 inline Float_t Chebyshev3DCalc::Eval(const Float_t* par) const
@@ -187,19 +290,26 @@ inline Float_t Chebyshev3DCalc::Eval(const Float_t* par) const
   if (!mNumberOfRows) {
     return 0.;
   }
-  int ncfRC;
+  // The recurrences over columns and rows are fed directly by the values of the inner dimension,
+  // so no intermediate arrays are needed and the method can be called concurrently
+  Float_t x = par[0], y = par[1], z = par[2], x2 = x + x, y2 = y + y;
+  Float_t xb0 = 0, xb1 = 0, xb2, yb0, yb1, yb2;
   for (int id0 = mNumberOfRows; id0--;) {
     int nCLoc = mNumberOfColumnsAtRow[id0]; // number of significant coefs on this row
     int col0 = mColumnAtRowBeginning[id0];  // beginning of local column in the 2D boundary matrix
+    yb0 = yb1 = 0;
     for (int id1 = nCLoc; id1--;) {
-      int id = id1 + col0;
-      mTemporaryCoefficients2D[id1] = (ncfRC = mCoefficientBound2D0[id])
-                                        ? chebyshevEvaluation1D(par[2], mCoefficients + mCoefficientBound2D1[id], ncfRC)
-                                        : 0.0;
+      Float_t val = evaluateSeries(id1 + col0, z);
+      yb2 = yb1;
+      yb1 = yb0;
+      yb0 = val + y2 * yb1 - yb2;
     }
-    mTemporaryCoefficients1D[id0] = nCLoc > 0 ? chebyshevEvaluation1D(par[1], mTemporaryCoefficients2D, nCLoc) : 0.0;
+    Float_t val = nCLoc > 0 ? yb0 - y * yb1 : 0;
+    xb2 = xb1;
+    xb1 = xb0;
+    xb0 = val + x2 * xb1 - xb2;
   }
-  return chebyshevEvaluation1D(par[0], mTemporaryCoefficients1D, mNumberOfRows);
+  return xb0 - x * xb1;
 }
 
 /// Evaluates Chebyshev parameterization for 3D function.
@@ -209,19 +319,26 @@ inline Double_t Chebyshev3DCalc::Eval(const Double_t* par) const
   if (!mNumberOfRows) {
     return 0.;
   }
-  int ncfRC;
+  // The recurrences over columns and rows are fed directly by the values of the inner dimension,
+  // so no intermediate arrays are needed and the method can be called concurrently
+  Float_t x = par[0], y = par[1], z = par[2], x2 = x + x, y2 = y + y;
+  Float_t xb0 = 0, xb1 = 0, xb2, yb0, yb1, yb2;
   for (int id0 = mNumberOfRows; id0--;) {
     int nCLoc = mNumberOfColumnsAtRow[id0]; // number of significant coefs on this row
     int col0 = mColumnAtRowBeginning[id0];  // beginning of local column in the 2D boundary matrix
+    yb0 = yb1 = 0;
     for (int id1 = nCLoc; id1--;) {
-      int id = id1 + col0;
-      mTemporaryCoefficients2D[id1] = (ncfRC = mCoefficientBound2D0[id])
-                                        ? chebyshevEvaluation1D(par[2], mCoefficients + mCoefficientBound2D1[id], ncfRC)
-                                        : 0.0;
+      Float_t val = evaluateSeries(id1 + col0, z);
+      yb2 = yb1;
+      yb1 = yb0;
+      yb0 = val + y2 * yb1 - yb2;
     }
-    mTemporaryCoefficients1D[id0] = nCLoc > 0 ? chebyshevEvaluation1D(par[1], mTemporaryCoefficients2D, nCLoc) : 0.0;
+    Float_t val = nCLoc > 0 ? yb0 - y * yb1 : 0;
+    xb2 = xb1;
+    xb1 = xb0;
+    xb0 = val + x2 * xb1 - xb2;
   }
-  return chebyshevEvaluation1D(par[0], mTemporaryCoefficients1D, mNumberOfRows);
+  return xb0 - x * xb1;
 }
 }
 }
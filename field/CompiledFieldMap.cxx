@@ -0,0 +1,32 @@
+/// \file CompiledFieldMap.cxx
+/// \brief Implementation of the CompiledFieldMap class
+
+#include <cstring>
+#include "CompiledFieldMap.h"
+
+using namespace AliceO2::Field;
+
+// zero-initialized before any dynamic initialization, so the registration order of the maps does not matter
+const CompiledFieldMap* CompiledFieldMap::sFirst = 0;
+
+CompiledFieldMap::CompiledFieldMap(const char* name, Int_t nSolenoid, const Evaluator_t* solenoid, Int_t nDipole,
+                                   const Evaluator_t* dipole)
+  : mName(name),
+    mNumberOfSolenoidSegments(nSolenoid),
+    mNumberOfDipoleSegments(nDipole),
+    mSolenoid(solenoid),
+    mDipole(dipole),
+    mNext(sFirst)
+{
+  sFirst = this;
+}
+
+const CompiledFieldMap* CompiledFieldMap::find(const char* name)
+{
+  for (const CompiledFieldMap* map = sFirst; map; map = map->mNext) {
+    if (!strcmp(map->mName, name)) {
+      return map;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+/// \file CompiledFieldMap.h
+/// \brief Definition of the CompiledFieldMap class
+
+#ifndef ALICEO2_FIELD_COMPILEDFIELDMAP_H_
+#define ALICEO2_FIELD_COMPILEDFIELDMAP_H_
+
+#include <Rtypes.h>
+
+namespace AliceO2 {
+namespace Field {
+
+/// Solenoid and Dipole parameterizations of a field map compiled into C++ by
+/// MagneticWrapperChebyshev::saveCompiledMap. Each output dimension of each segment is evaluated by a generated
+/// function with the coefficients and the row/column structure fixed at compile time, so that the recurrences
+/// are unrolled and no bounds are read. The generated source defines a static instance, which registers the map
+/// by its name when the library containing it is loaded, see MagneticWrapperChebyshev::useCompiledMap
+class CompiledFieldMap {
+
+public:
+  /// Generated evaluator of one output dimension of a segment, par being in the coordinates of the segment
+  typedef Double_t (*Evaluator_t)(const Double_t* par);
+
+  /// Registers the map, solenoid and dipole hold 3 evaluators per segment. To be used by the generated code only
+  CompiledFieldMap(const char* name, Int_t nSolenoid, const Evaluator_t* solenoid, Int_t nDipole,
+                   const Evaluator_t* dipole);
+
+  /// Returns the registered map of given name or 0 if it is not linked
+  static const CompiledFieldMap* find(const char* name);
+
+  const char* getName() const
+  {
+    return mName;
+  }
+
+  Int_t getNumberOfSolenoidSegments() const
+  {
+    return mNumberOfSolenoidSegments;
+  }
+
+  Int_t getNumberOfDipoleSegments() const
+  {
+    return mNumberOfDipoleSegments;
+  }
+
+  /// Returns the 3 evaluators of the solenoid segment id
+  const Evaluator_t* getSolenoidEvaluators(Int_t id) const
+  {
+    return mSolenoid + 3 * id;
+  }
+
+  /// Returns the 3 evaluators of the dipole segment id
+  const Evaluator_t* getDipoleEvaluators(Int_t id) const
+  {
+    return mDipole + 3 * id;
+  }
+
+  /// Clenshaw summation of N Chebyshev coefficients, the loop being unrolled for the compile time N
+  template <int N>
+  static Float_t clenshaw(const Float_t* a, Float_t x);
+
+  /// Maps x to [-1:1] as Chebyshev3D::mapToInternal
+  static Float_t mapToInternal(Double_t x, Float_t offset, Float_t scale);
+
+private:
+  CompiledFieldMap(const CompiledFieldMap&);
+  CompiledFieldMap& operator=(const CompiledFieldMap&);
+
+  const char* mName;                     ///< name of the parameterization
+  Int_t mNumberOfSolenoidSegments;       ///< number of solenoid segments
+  Int_t mNumberOfDipoleSegments;         ///< number of dipole segments
+  const Evaluator_t* mSolenoid;          ///< 3 evaluators per solenoid segment
+  const Evaluator_t* mDipole;            ///< 3 evaluators per dipole segment
+  const CompiledFieldMap* mNext;         ///< next registered map
+  static const CompiledFieldMap* sFirst; ///< first registered map
+};
+
+template <int N>
+inline Float_t CompiledFieldMap::clenshaw(const Float_t* a, Float_t x)
+{
+  Float_t b0 = 0, b1 = 0, b2, x2 = x + x;
+  for (int i = N; i--;) {
+    b2 = b1;
+    b1 = b0;
+    b0 = a[i] + x2 * b1 - b2;
+  }
+  return b0 - x * b1;
+}
+
+inline Float_t CompiledFieldMap::mapToInternal(Double_t x, Float_t offset, Float_t scale)
+{
+  Double_t res = (x - offset) * scale;
+#ifdef _BRING_TO_BOUNDARY_
+  if (res < -1) {
+    return -1;
+  }
+  if (res > 1) {
+    return 1;
+  }
+#endif
+  return res;
+}
+}
+}
+
+#endif
@@ -0,0 +1,105 @@
+/// \file MachineFieldTable.cxx
+/// \brief Implementation of the MachineFieldTable class
+
+#include <algorithm>
+#include <cstdio>
+#include "MachineFieldTable.h"
+
+using namespace AliceO2::Field;
+
+static bool compareElementZ(const MachineFieldElement& a, const MachineFieldElement& b)
+{
+  return a.mZMin < b.mZMin;
+}
+
+MachineFieldTable::MachineFieldTable() : mZMin(0), mZScale(0), mNumberOfBins(0)
+{
+}
+
+void MachineFieldTable::clear()
+{
+  mElements.clear();
+  mBinFirst.clear();
+  mBinLast.clear();
+  mZMin = mZScale = 0;
+  mNumberOfBins = 0;
+}
+
+void MachineFieldTable::addElement(Int_t type, Double_t zCenter, Double_t length, Double_t apertureR,
+                                   Double_t strength, Double_t offsetX, Bool_t scaleWithDipole)
+{
+  MachineFieldElement el;
+  el.mType = type;
+  el.mZMin = zCenter - length / 2;
+  el.mZMax = zCenter + length / 2;
+  el.mApertureSqR = apertureR * apertureR;
+  el.mOffsetX = offsetX;
+  el.mStrength = strength;
+  el.mScaleWithDipole = scaleWithDipole;
+  mElements.push_back(el);
+  mNumberOfBins = 0; // invalid until rebuilt
+}
+
+void MachineFieldTable::build()
+{
+  mBinFirst.clear();
+  mBinLast.clear();
+  mNumberOfBins = 0;
+  int nel = mElements.size();
+  if (!nel) {
+    return;
+  }
+  std::stable_sort(mElements.begin(), mElements.end(), compareElementZ);
+
+  // the bin size is such that the shortest element spans kBinsPerShortestElement bins
+  Double_t zMax = mElements[0].mZMax, minLength = mElements[0].mZMax - mElements[0].mZMin;
+  for (int i = 1; i < nel; i++) {
+    zMax = TMath::Max(zMax, mElements[i].mZMax);
+    minLength = TMath::Min(minLength, mElements[i].mZMax - mElements[i].mZMin);
+  }
+  mZMin = mElements[0].mZMin;
+  Double_t span = zMax - mZMin;
+  if (span <= 0 || minLength <= 0) {
+    return;
+  }
+  int nbins = int(TMath::Ceil(span * kBinsPerShortestElement / minLength));
+  mNumberOfBins = TMath::Min(int(kMaxBins), TMath::Max(1, nbins));
+  mZScale = mNumberOfBins / span;
+  mBinFirst.assign(mNumberOfBins, nel);
+  mBinLast.assign(mNumberOfBins, -1);
+  for (int i = 0; i < nel; i++) {
+    int first = TMath::Max(0, int((mElements[i].mZMin - mZMin) * mZScale));
+    int last = TMath::Min(mNumberOfBins - 1, int((mElements[i].mZMax - mZMin) * mZScale));
+    for (int bin = first; bin <= last; bin++) {
+      mBinFirst[bin] = TMath::Min(mBinFirst[bin], i);
+      mBinLast[bin] = TMath::Max(mBinLast[bin], i);
+    }
+  }
+}
+
+void MachineFieldTable::fieldBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bx,
+                                   Double_t* by, Double_t* bz, Double_t dipoleFactor) const
+{
+  for (int i = 0; i < n; i++) {
+    Double_t xyz[3] = { x[i], y[i], z[i] }, b[3];
+    Field(xyz, b, dipoleFactor);
+    bx[i] = b[0];
+    by[i] = b[1];
+    bz[i] = b[2];
+  }
+}
+
+void MachineFieldTable::Print() const
+{
+  const char* types[3] = { "Bx", "By", "Grad" };
+  printf("Machine field table of %d elements indexed by %d z bins\n", getNumberOfElements(), mNumberOfBins);
+  for (int i = 0; i < getNumberOfElements(); i++) {
+    const MachineFieldElement& el = mElements[i];
+    printf("%3d %4s %+10.4f %s Z: %+9.1f : %+9.1f R<%.3f", i, types[el.mType], el.mStrength,
+           el.mScaleWithDipole ? "*DipFactor" : "          ", el.mZMin, el.mZMax, TMath::Sqrt(el.mApertureSqR));
+    if (el.mOffsetX != 0.) {
+      printf(" twin at |X|=%.2f", el.mOffsetX);
+    }
+    printf("\n");
+  }
+}
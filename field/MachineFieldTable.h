@@ -0,0 +1,121 @@
+/// \file MachineFieldTable.h
+/// \brief Definition of the MachineFieldTable class
+
+#ifndef ALICEO2_FIELD_MACHINEFIELDTABLE_H_
+#define ALICEO2_FIELD_MACHINEFIELDTABLE_H_
+
+#include <TMath.h>
+#include <vector>
+
+namespace AliceO2 {
+namespace Field {
+
+/// Beam line element of the MachineFieldTable: a magnet with uniform field or a quadrupole occupying
+/// mZMin<z<mZMax within a circular aperture
+struct MachineFieldElement {
+  enum Type_t { kUniformX, kUniformY, kQuadrupole };
+
+  Int_t mType;             ///< one of Type_t
+  Double_t mZMin;          ///< lower z edge
+  Double_t mZMax;          ///< upper z edge
+  Double_t mApertureSqR;   ///< squared radius of the aperture
+  Double_t mOffsetX;       ///< for twin aperture magnets |x| of the aperture centres, 0 otherwise
+  Double_t mStrength;      ///< field (kGauss) or, for quadrupoles, gradient (kGauss/cm)
+  Bool_t mScaleWithDipole; ///< field follows the factor of the muon arm dipole
+};
+
+/// Field of the beam line elements outside of the measured map (compensators, triplet quadrupoles, D1 and
+/// D2 dipoles) described by a table of elements. The elements are sorted by their lower z edge and indexed
+/// by a uniform z grid, so that the field at a point is resolved by one multiplication and the check of the
+/// elements overlapping its z bin, whatever the number of elements in the table.
+/// For overlapping elements the first one (in z order) containing the point defines the field
+class MachineFieldTable {
+
+public:
+  enum { kBinsPerShortestElement = 2, kMaxBins = 1 << 16 };
+
+  /// Default constructor
+  MachineFieldTable();
+
+  /// Removes all elements
+  void clear();
+
+  /// Adds an element centred at zCenter with given length and aperture radius. The index is not updated
+  /// until build is called
+  void addElement(Int_t type, Double_t zCenter, Double_t length, Double_t apertureR, Double_t strength,
+                  Double_t offsetX = 0., Bool_t scaleWithDipole = kFALSE);
+
+  /// Sorts the elements and builds the z index, must be called after adding the elements
+  void build();
+
+  Int_t getNumberOfElements() const
+  {
+    return mElements.size();
+  }
+
+  const MachineFieldElement& getElement(Int_t i) const
+  {
+    return mElements[i];
+  }
+
+  /// Computes the field at cartesian point x, dipoleFactor scaling the elements following the muon arm dipole.
+  /// Returns kFALSE, with zero field, if the point is not inside any element
+  Bool_t Field(const Double_t* x, Double_t* b, Double_t dipoleFactor) const;
+
+  /// Computes the field for n points given as separate coordinate arrays, see Field
+  void fieldBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bx, Double_t* by,
+                  Double_t* bz, Double_t dipoleFactor) const;
+
+  /// Prints the elements
+  void Print() const;
+
+private:
+  std::vector<MachineFieldElement> mElements; ///< elements sorted by mZMin after build
+  std::vector<Int_t> mBinFirst;               ///< first element overlapping each z bin
+  std::vector<Int_t> mBinLast;                ///< last element overlapping each z bin
+  Double_t mZMin;                             ///< lower edge of the z index
+  Double_t mZScale;                           ///< inverse size of the z bin
+  Int_t mNumberOfBins;                        ///< number of z bins, 0 if the table is empty
+};
+
+inline Bool_t MachineFieldTable::Field(const Double_t* x, Double_t* b, Double_t dipoleFactor) const
+{
+  b[0] = b[1] = b[2] = 0;
+  Double_t t = (x[2] - mZMin) * mZScale;
+  if (!(t >= 0 && t < mNumberOfBins)) { // also rejects NaN and the empty table
+    return kFALSE;
+  }
+  int bin = int(t);
+  Double_t rad2 = x[0] * x[0] + x[1] * x[1];
+  for (int i = mBinFirst[bin]; i <= mBinLast[bin]; i++) {
+    const MachineFieldElement& el = mElements[i];
+    if (x[2] <= el.mZMin || x[2] >= el.mZMax || rad2 >= el.mApertureSqR) {
+      continue;
+    }
+    if (el.mOffsetX != 0.) { // twin aperture: the point must be inside one of the beam pipes
+      Double_t dxabs = TMath::Abs(x[0]) - el.mOffsetX;
+      if (dxabs * dxabs + x[1] * x[1] >= el.mApertureSqR) {
+        return kTRUE;
+      }
+    }
+    Double_t strength = el.mScaleWithDipole ? el.mStrength * dipoleFactor : el.mStrength;
+    switch (el.mType) {
+      case MachineFieldElement::kUniformX:
+        b[0] = strength;
+        break;
+      case MachineFieldElement::kUniformY:
+        b[1] = strength;
+        break;
+      case MachineFieldElement::kQuadrupole:
+        b[0] = strength * x[1];
+        b[1] = strength * x[0];
+        break;
+    }
+    return kTRUE;
+  }
+  return kFALSE;
+}
+}
+}
+
+#endif
@@ -5,12 +5,17 @@
 #include <TClass.h>
 #include <TFile.h>
 #include <TSystem.h>
+#include <TVectorD.h>
 #include <TPRegexp.h>
 #include "MagneticField.h"
+#include "MagneticFieldCache.h"
+#include "MagneticFieldCursor.h"
 #include "MagneticWrapperChebyshev.h"
 
 #include "FairLogger.h"
 
+#include <vector>
+
 using namespace AliceO2::Field;
 
 ClassImp(MagneticField)
@@ -54,6 +59,9 @@ const UShort_t MagneticField::sPolarityConvention = MagneticField::kConvLHC;
 MagneticField::MagneticField()
   : TVirtualMagField(),
     mMeasuredMap(0),
+    mFieldCache(0),
+    mTPCIntegralCache(0),
+    mTPCRatIntegralCache(0),
     mMapType(k5kG),
     mSolenoid(0),
     mBeamType(kNoBeamField),
@@ -75,9 +83,13 @@ MagneticField::MagneticField()
 }
 
 MagneticField::MagneticField(const char* name, const char* title, Double_t factorSol, Double_t factorDip,
-                             BMap_t maptype, BeamType_t bt, Double_t be, Int_t integ, Double_t fmax, const char* path)
+                             BMap_t maptype, BeamType_t bt, Double_t be, Int_t integ, Double_t fmax, const char* path,
+                             Bool_t compiledMap)
   : TVirtualMagField(name),
     mMeasuredMap(0),
+    mFieldCache(0),
+    mTPCIntegralCache(0),
+    mTPCRatIntegralCache(0),
     mMapType(maptype),
     mSolenoid(0),
     mBeamType(bt),
@@ -134,6 +146,9 @@ MagneticField::MagneticField(const char* name, const char* title, Double_t facto
   setParameterName(parname);
 
   loadParameterization();
+  if (compiledMap) {
+    mMeasuredMap->useCompiledMap(kTRUE);
+  }
   initializeMachineField(mBeamType, mBeamEnergy);
   double xyz[3] = { 0., 0., 0. };
   mSolenoid = getBz(xyz);
@@ -145,6 +160,9 @@ MagneticField::MagneticField(const char* name, const char* title, Double_t facto
 MagneticField::MagneticField(const MagneticField& src)
   : TVirtualMagField(src),
     mMeasuredMap(0),
+    mFieldCache(0),
+    mTPCIntegralCache(0),
+    mTPCRatIntegralCache(0),
     mMapType(src.mMapType),
     mSolenoid(src.mSolenoid),
     mBeamType(src.mBeamType),
@@ -160,17 +178,133 @@ MagneticField::MagneticField(const MagneticField& src)
     mCompensatorField2C(src.mCompensatorField2C),
     mCompensatorField1A(src.mCompensatorField1A),
     mCompensatorField2A(src.mCompensatorField2A),
+    mMachineFieldTable(src.mMachineFieldTable),
     mParameterNames(src.mParameterNames),
     mLogger(FairLogger::GetLogger())
 {
   if (src.mMeasuredMap) {
     mMeasuredMap = new MagneticWrapperChebyshev(*src.mMeasuredMap);
   }
+  if (src.mFieldCache) {
+    mFieldCache = new MagneticFieldCache(*src.mFieldCache);
+  }
+  if (src.mTPCIntegralCache) {
+    mTPCIntegralCache = new MagneticFieldCache(*src.mTPCIntegralCache);
+  }
+  if (src.mTPCRatIntegralCache) {
+    mTPCRatIntegralCache = new MagneticFieldCache(*src.mTPCRatIntegralCache);
+  }
 }
 
 MagneticField::~MagneticField()
 {
   delete mMeasuredMap;
+  delete mFieldCache;
+  clearTPCIntegralCache();
+}
+
+void MagneticField::setFieldCache(MagneticFieldCache* cache)
+{
+  if (cache != mFieldCache) {
+    delete mFieldCache;
+    mFieldCache = cache;
+  }
+}
+
+Bool_t MagneticField::setupTPCIntegralCache(const char* dir, const Double_t* step)
+{
+  clearTPCIntegralCache();
+  if (!mMeasuredMap) {
+    mLogger->Error(MESSAGE_ORIGIN, "No field map is loaded, cannot tabulate the TPC integrals");
+    return kFALSE;
+  }
+  const Double_t defStep[3] = { 5., 0.05, 5. };
+  if (!step) {
+    step = defStep;
+  }
+  Double_t min[3] = { 0., -TMath::Pi(), mMeasuredMap->getMinZTPCIntegral() };
+  Double_t max[3] = { mMeasuredMap->getMaxRTPCIntegral(), TMath::Pi(), mMeasuredMap->getMaxZTPCIntegral() };
+  Double_t ratMin[3] = { 0., -TMath::Pi(), mMeasuredMap->getMinZTPCRatIntegral() };
+  Double_t ratMax[3] = { mMeasuredMap->getMaxRTPCRatIntegral(), TMath::Pi(), mMeasuredMap->getMaxZTPCRatIntegral() };
+
+  // the stored tables are used only if tabulated from the current version of the data file on the same grids
+  Long64_t source[2];
+  char* dataName = gSystem->ExpandPathName(getDataFileName());
+  MagneticWrapperChebyshev::getSourceIdentity(dataName, source);
+  delete[] dataName;
+  TVectorD key(17);
+  key[0] = source[0];
+  key[1] = source[1];
+  for (int i = 0; i < 3; i++) {
+    key[2 + i] = step[i];
+    key[5 + i] = min[i];
+    key[8 + i] = max[i];
+    key[11 + i] = ratMin[i];
+    key[14 + i] = ratMax[i];
+  }
+
+  TString fname = Form("%s/TPCIntegrals_%s.root", dir, getParameterName());
+  gSystem->ExpandPathName(fname);
+  if (!gSystem->AccessPathName(fname)) {
+    TVectorD* storedKey = 0;
+    TFile* file = TFile::Open(fname);
+    if (file) {
+      storedKey = dynamic_cast<TVectorD*>(file->Get("TPCIntegralKey"));
+      mTPCIntegralCache = dynamic_cast<MagneticFieldCache*>(file->Get("TPCIntegral"));
+      mTPCRatIntegralCache = dynamic_cast<MagneticFieldCache*>(file->Get("TPCRatIntegral"));
+      file->Close();
+      delete file;
+    }
+    Bool_t sameKey = storedKey && storedKey->GetNrows() == key.GetNrows();
+    for (int i = 0; sameKey && i < key.GetNrows(); i++) {
+      sameKey = (*storedKey)[i] == key[i];
+    }
+    delete storedKey;
+    if (sameKey && mTPCIntegralCache && mTPCRatIntegralCache &&
+        mTPCIntegralCache->getQuantity() == MagneticFieldCache::kTPCIntegral &&
+        mTPCRatIntegralCache->getQuantity() == MagneticFieldCache::kTPCRatIntegral) {
+      mLogger->Info(MESSAGE_ORIGIN, "Loaded TPC integral tables from %s", fname.Data());
+      return kTRUE;
+    }
+    mLogger->Warning(MESSAGE_ORIGIN, "TPC integral tables in %s are invalid or do not match the map %s and the grid, "
+                                     "tabulating them",
+                     fname.Data(), getDataFileName());
+    clearTPCIntegralCache();
+  }
+
+  mTPCIntegralCache = new MagneticFieldCache(mMeasuredMap, MagneticFieldCache::kCylindrical, min, max, step,
+                                             MagneticFieldCache::kTPCIntegral);
+  mTPCRatIntegralCache = new MagneticFieldCache(mMeasuredMap, MagneticFieldCache::kCylindrical, ratMin, ratMax, step,
+                                                MagneticFieldCache::kTPCRatIntegral);
+  if (!mTPCIntegralCache->getNumberOfNodes() || !mTPCRatIntegralCache->getNumberOfNodes()) {
+    clearTPCIntegralCache();
+    return kFALSE;
+  }
+
+  // write to a temporary file renamed when complete, such that an interrupted job leaves no truncated tables
+  TString tmpName = Form("%s.tmp%d", fname.Data(), gSystem->GetPid());
+  TFile* file = TFile::Open(tmpName, "recreate");
+  Bool_t stored = file && !file->IsZombie();
+  if (stored) {
+    stored = key.Write("TPCIntegralKey") > 0 && mTPCIntegralCache->Write("TPCIntegral") > 0 &&
+             mTPCRatIntegralCache->Write("TPCRatIntegral") > 0;
+    file->Close();
+  }
+  delete file;
+  if (!stored || gSystem->Rename(tmpName, fname)) {
+    gSystem->Unlink(tmpName);
+    mLogger->Warning(MESSAGE_ORIGIN, "Failed to store TPC integral tables to %s", fname.Data());
+  } else {
+    mLogger->Info(MESSAGE_ORIGIN, "Stored TPC integral tables to %s", fname.Data());
+  }
+  return kTRUE;
+}
+
+void MagneticField::clearTPCIntegralCache()
+{
+  delete mTPCIntegralCache;
+  delete mTPCRatIntegralCache;
+  mTPCIntegralCache = mTPCRatIntegralCache = 0;
 }
 
 Bool_t MagneticField::loadParameterization()
@@ -179,7 +313,25 @@ Bool_t MagneticField::loadParameterization()
     mLogger->Fatal(MESSAGE_ORIGIN, "Field data %s are already loaded from %s\n", getParameterName(), getDataFileName());
   }
 
+  // the binary map <datafile>_<parameterization>.bin is mapped directly when available and converted from the
+  // current data file
   char* fname = gSystem->ExpandPathName(getDataFileName());
+  TString binName = fname;
+  if (binName.EndsWith(".root")) {
+    binName.Remove(binName.Length() - 5);
+  }
+  binName += Form("_%s.bin", getParameterName());
+  if (!gSystem->AccessPathName(binName)) {
+    mMeasuredMap = new MagneticWrapperChebyshev();
+    if (mMeasuredMap->loadBinaryData(binName, fname, getParameterName())) {
+      mLogger->Info(MESSAGE_ORIGIN, "Loaded field %s from binary map %s", getParameterName(), binName.Data());
+      delete[] fname;
+      return kTRUE;
+    }
+    delete mMeasuredMap;
+    mMeasuredMap = 0;
+  }
+
   TFile* file = TFile::Open(fname);
   if (!file) {
     mLogger->Fatal(MESSAGE_ORIGIN, "Failed to open magnetic field data file %s\n", fname);
@@ -189,41 +341,217 @@ Bool_t MagneticField::loadParameterization()
   if (!mMeasuredMap) {
     mLogger->Fatal(MESSAGE_ORIGIN, "Did not find field %s in %s\n", getParameterName(), fname);
   }
+  mMeasuredMap->buildSegmentGrids();
   file->Close();
   delete file;
+  mLogger->Info(MESSAGE_ORIGIN, "Loaded field %s from %s", getParameterName(), fname);
+  delete[] fname;
   return kTRUE;
 }
 
 void MagneticField::Field(const Double_t* xyz, Double_t* b)
 {
   //  b[0]=b[1]=b[2]=0.0;
+  if (mMeasuredMap && xyz[2] > mMeasuredMap->getMinZ() && xyz[2] < mMeasuredMap->getMaxZ()) {
+    if (!mFieldCache || !mFieldCache->Field(xyz, b)) {
+      mMeasuredMap->Field(xyz, b);
+    }
+    Double_t factor = getMeasuredMapFactor(xyz[2]);
+    for (int i = 3; i--;) {
+      b[i] *= factor;
+    }
+  } else {
+    MachineField(xyz, b);
+  }
+}
+
+void MagneticField::Field(const Float_t* xyz, Float_t* b) const
+{
   if (mMeasuredMap && xyz[2] > mMeasuredMap->getMinZ() && xyz[2] < mMeasuredMap->getMaxZ()) {
     mMeasuredMap->Field(xyz, b);
-    if (xyz[2] > sSolenoidToDipoleZ || mDipoleOnOffFlag) {
-      for (int i = 3; i--;) {
-        b[i] *= mMultipicativeFactorSolenoid;
-      }
-    } else {
-      for (int i = 3; i--;) {
-        b[i] *= mMultipicativeFactorDipole;
-      }
+    Float_t factor = getMeasuredMapFactor(xyz[2]);
+    for (int i = 3; i--;) {
+      b[i] *= factor;
+    }
+  } else {
+    Double_t xyzD[3] = { xyz[0], xyz[1], xyz[2] }, bD[3];
+    MachineField(xyzD, bD);
+    for (int i = 3; i--;) {
+      b[i] = bD[i];
+    }
+  }
+}
+
+void MagneticField::Field(const Double_t* xyz, Double_t* b, MagneticFieldCursor& cursor) const
+{
+  if (mMeasuredMap && xyz[2] > mMeasuredMap->getMinZ() && xyz[2] < mMeasuredMap->getMaxZ()) {
+    if (!mFieldCache || !mFieldCache->Field(xyz, b)) {
+      mMeasuredMap->Field(xyz, b, cursor);
+    }
+    Double_t factor = getMeasuredMapFactor(xyz[2]);
+    for (int i = 3; i--;) {
+      b[i] *= factor;
     }
   } else {
     MachineField(xyz, b);
   }
 }
 
+void MagneticField::fieldBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bx,
+                               Double_t* by, Double_t* bz) const
+{
+  if (n <= 0) {
+    return;
+  }
+  // collect the points falling into the measured map, evaluate them at once and scatter back
+  std::vector<Int_t> inMap;
+  inMap.reserve(n);
+  for (int i = 0; i < n; i++) {
+    if (mMeasuredMap && z[i] > mMeasuredMap->getMinZ() && z[i] < mMeasuredMap->getMaxZ()) {
+      Double_t xyz[3] = { x[i], y[i], z[i] }, b[3];
+      if (mFieldCache && mFieldCache->Field(xyz, b)) {
+        Double_t factor = getMeasuredMapFactor(z[i]);
+        bx[i] = b[0] * factor;
+        by[i] = b[1] * factor;
+        bz[i] = b[2] * factor;
+      } else {
+        inMap.push_back(i);
+      }
+    } else {
+      Double_t xyz[3] = { x[i], y[i], z[i] }, b[3];
+      MachineField(xyz, b);
+      bx[i] = b[0];
+      by[i] = b[1];
+      bz[i] = b[2];
+    }
+  }
+
+  int nMap = inMap.size();
+  if (!nMap) {
+    return;
+  }
+  std::vector<Double_t> buffer(6 * nMap);
+  Double_t *mx = &buffer[0], *my = mx + nMap, *mz = my + nMap, *mbx = mz + nMap, *mby = mbx + nMap,
+           *mbz = mby + nMap;
+  for (int j = nMap; j--;) {
+    int i = inMap[j];
+    mx[j] = x[i];
+    my[j] = y[i];
+    mz[j] = z[i];
+  }
+
+  mMeasuredMap->fieldBatch(nMap, mx, my, mz, mbx, mby, mbz);
+
+  for (int j = nMap; j--;) {
+    int i = inMap[j];
+    Double_t factor = getMeasuredMapFactor(mz[j]);
+    bx[i] = mbx[j] * factor;
+    by[i] = mby[j] * factor;
+    bz[i] = mbz[j] * factor;
+  }
+}
+
 Double_t MagneticField::getBz(const Double_t* xyz) const
 {
   if (mMeasuredMap && xyz[2] > mMeasuredMap->getMinZ() && xyz[2] < mMeasuredMap->getMaxZ()) {
-    double bz = mMeasuredMap->getBz(xyz);
-    return (xyz[2] > sSolenoidToDipoleZ || mDipoleOnOffFlag) ? bz * mMultipicativeFactorSolenoid
-                                                             : bz * mMultipicativeFactorDipole;
+    double bz;
+    if (!mFieldCache || !mFieldCache->getBz(xyz, bz)) {
+      bz = mMeasuredMap->getBz(xyz);
+    }
+    return bz * getMeasuredMapFactor(xyz[2]);
+  } else {
+    return 0.;
+  }
+}
+
+Double_t MagneticField::getBz(const Double_t* xyz, MagneticFieldCursor& cursor) const
+{
+  if (mMeasuredMap && xyz[2] > mMeasuredMap->getMinZ() && xyz[2] < mMeasuredMap->getMaxZ()) {
+    double bz;
+    if (!mFieldCache || !mFieldCache->getBz(xyz, bz)) {
+      bz = mMeasuredMap->getBz(xyz, cursor);
+    }
+    return bz * getMeasuredMapFactor(xyz[2]);
   } else {
     return 0.;
   }
 }
 
+void MagneticField::getBzBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bz) const
+{
+  if (n <= 0) {
+    return;
+  }
+  // same scheme as fieldBatch: the points not served by the cache are evaluated at once by the map
+  std::vector<Int_t> inMap;
+  inMap.reserve(n);
+  for (int i = 0; i < n; i++) {
+    bz[i] = 0.;
+    if (mMeasuredMap && z[i] > mMeasuredMap->getMinZ() && z[i] < mMeasuredMap->getMaxZ()) {
+      Double_t xyz[3] = { x[i], y[i], z[i] }, b;
+      if (mFieldCache && mFieldCache->getBz(xyz, b)) {
+        bz[i] = b * getMeasuredMapFactor(z[i]);
+      } else {
+        inMap.push_back(i);
+      }
+    }
+  }
+
+  int nMap = inMap.size();
+  if (!nMap) {
+    return;
+  }
+  std::vector<Double_t> buffer(4 * nMap);
+  Double_t *mx = &buffer[0], *my = mx + nMap, *mz = my + nMap, *mbz = mz + nMap;
+  for (int j = nMap; j--;) {
+    int i = inMap[j];
+    mx[j] = x[i];
+    my[j] = y[i];
+    mz[j] = z[i];
+  }
+
+  mMeasuredMap->getBzBatch(nMap, mx, my, mz, mbz);
+
+  for (int j = nMap; j--;) {
+    bz[inMap[j]] = mbz[j] * getMeasuredMapFactor(mz[j]);
+  }
+}
+
+void MagneticField::getBzGradientCylindricalBatch(Int_t n, const Double_t* r, const Double_t* phi, const Double_t* z,
+                                                  Double_t* bz, Double_t* dbzdr, Double_t* dbzdphi,
+                                                  Double_t* dbzdz) const
+{
+  if (n <= 0) {
+    return;
+  }
+  Double_t* res[4] = { bz, dbzdr, dbzdphi, dbzdz };
+  if (!mMeasuredMap) {
+    for (int k = 4; k--;) {
+      for (int i = n; res[k] && i--;) {
+        res[k][i] = 0.;
+      }
+    }
+    return;
+  }
+  mMeasuredMap->getBzGradientCylindricalBatch(n, r, phi, z, bz, dbzdr, dbzdphi, dbzdz);
+  for (int i = n; i--;) {
+    Double_t factor = getMeasuredMapFactor(z[i]);
+    for (int k = 4; k--;) {
+      if (res[k]) {
+        res[k][i] *= factor;
+      }
+    }
+  }
+}
+
+Float_t MagneticField::getBz(const Float_t* xyz) const
+{
+  if (mMeasuredMap && xyz[2] > mMeasuredMap->getMinZ() && xyz[2] < mMeasuredMap->getMaxZ()) {
+    return mMeasuredMap->getBz(xyz) * Float_t(getMeasuredMapFactor(xyz[2]));
+  }
+  return 0.f;
+}
+
 MagneticField& MagneticField::operator=(const MagneticField& src)
 {
   if (this != &src) {
@@ -233,6 +561,14 @@ MagneticField& MagneticField::operator=(const MagneticField& src)
       }
       mMeasuredMap = new MagneticWrapperChebyshev(*src.mMeasuredMap);
     }
+    setFieldCache(src.mFieldCache ? new MagneticFieldCache(*src.mFieldCache) : 0);
+    clearTPCIntegralCache();
+    if (src.mTPCIntegralCache) {
+      mTPCIntegralCache = new MagneticFieldCache(*src.mTPCIntegralCache);
+    }
+    if (src.mTPCRatIntegralCache) {
+      mTPCRatIntegralCache = new MagneticFieldCache(*src.mTPCRatIntegralCache);
+    }
     SetName(src.GetName());
     mSolenoid = src.mSolenoid;
     mBeamType = src.mBeamType;
@@ -243,6 +579,12 @@ MagneticField& MagneticField::operator=(const MagneticField& src)
     mMultipicativeFactorDipole = src.mMultipicativeFactorDipole;
     mMaxField = src.mMaxField;
     mDipoleOnOffFlag = src.mDipoleOnOffFlag;
+    mQuadrupoleGradient = src.mQuadrupoleGradient;
+    mDipoleField = src.mDipoleField;
+    mCompensatorField2C = src.mCompensatorField2C;
+    mCompensatorField1A = src.mCompensatorField1A;
+    mCompensatorField2A = src.mCompensatorField2A;
+    mMachineFieldTable = src.mMachineFieldTable;
     mParameterNames = src.mParameterNames;
   }
   return *this;
@@ -252,6 +594,7 @@ void MagneticField::initializeMachineField(BeamType_t btype, Double_t benergy)
 {
   if (btype == kNoBeamField) {
     mQuadrupoleGradient = mDipoleField = mCompensatorField2C = mCompensatorField1A = mCompensatorField2A = 0.;
+    mMachineFieldTable.clear();
     return;
   }
 
@@ -270,91 +613,65 @@ void MagneticField::initializeMachineField(BeamType_t btype, Double_t benergy)
   // SIDE A
   mCompensatorField1A = -13.2247;
   mCompensatorField2A = 11.7905;
+
+  buildMachineFieldTable();
 }
 
-void MagneticField::MachineField(const Double_t* x, Double_t* b) const
+void MagneticField::buildMachineFieldTable()
 {
   // ---- This is the ZDC part
   // Compansators for Alice Muon Arm Dipole
-  const Double_t kBComp1CZ = 1075., kBComp1hDZ = 260. / 2., kBComp1SqR = 4.0 * 4.0;
-  const Double_t kBComp2CZ = 2049., kBComp2hDZ = 153. / 2., kBComp2SqR = 4.5 * 4.5;
+  const Double_t kBComp1CZ = 1075., kBComp1DZ = 260., kBComp1R = 4.0;
+  const Double_t kBComp2CZ = 2049., kBComp2DZ = 153., kBComp2R = 4.5;
 
-  const Double_t kTripQ1CZ = 2615., kTripQ1hDZ = 637. / 2., kTripQ1SqR = 3.5 * 3.5;
-  const Double_t kTripQ2CZ = 3480., kTripQ2hDZ = 550. / 2., kTripQ2SqR = 3.5 * 3.5;
-  const Double_t kTripQ3CZ = 4130., kTripQ3hDZ = 550. / 2., kTripQ3SqR = 3.5 * 3.5;
-  const Double_t kTripQ4CZ = 5015., kTripQ4hDZ = 637. / 2., kTripQ4SqR = 3.5 * 3.5;
+  const Double_t kTripQ1CZ = 2615., kTripQ1DZ = 637., kTripQ1R = 3.5;
+  const Double_t kTripQ2CZ = 3480., kTripQ2DZ = 550., kTripQ2R = 3.5;
+  const Double_t kTripQ3CZ = 4130., kTripQ3DZ = 550., kTripQ3R = 3.5;
+  const Double_t kTripQ4CZ = 5015., kTripQ4DZ = 637., kTripQ4R = 3.5;
 
-  const Double_t kDip1CZ = 6310.8, kDip1hDZ = 945. / 2., kDip1SqRC = 4.5 * 4.5, kDip1SqRA = 3.375 * 3.375;
-  const Double_t kDip2CZ = 12640.3, kDip2hDZ = 945. / 2., kDip2SqRC = 4.5 * 4.5, kDip2SqRA = 3.75 * 3.75;
+  const Double_t kDip1CZ = 6310.8, kDip1DZ = 945., kDip1RC = 4.5, kDip1RA = 3.375;
+  const Double_t kDip2CZ = 12640.3, kDip2DZ = 945., kDip2RC = 4.5, kDip2RA = 3.75;
   const Double_t kDip2DXC = 9.7, kDip2DXA = 9.4;
 
-  double rad2 = x[0] * x[0] + x[1] * x[1];
-
-  b[0] = b[1] = b[2] = 0;
+  const Int_t kBx = MachineFieldElement::kUniformX, kBy = MachineFieldElement::kUniformY,
+              kQuad = MachineFieldElement::kQuadrupole;
 
+  mMachineFieldTable.clear();
   // SIDE C
-  if (x[2] < 0.) {
-    if (TMath::Abs(x[2] + kBComp2CZ) < kBComp2hDZ && rad2 < kBComp2SqR) {
-      b[0] = mCompensatorField2C * mMultipicativeFactorDipole;
-    } else if (TMath::Abs(x[2] + kTripQ1CZ) < kTripQ1hDZ && rad2 < kTripQ1SqR) {
-      b[0] = mQuadrupoleGradient * x[1];
-      b[1] = mQuadrupoleGradient * x[0];
-    } else if (TMath::Abs(x[2] + kTripQ2CZ) < kTripQ2hDZ && rad2 < kTripQ2SqR) {
-      b[0] = -mQuadrupoleGradient * x[1];
-      b[1] = -mQuadrupoleGradient * x[0];
-    } else if (TMath::Abs(x[2] + kTripQ3CZ) < kTripQ3hDZ && rad2 < kTripQ3SqR) {
-      b[0] = -mQuadrupoleGradient * x[1];
-      b[1] = -mQuadrupoleGradient * x[0];
-    } else if (TMath::Abs(x[2] + kTripQ4CZ) < kTripQ4hDZ && rad2 < kTripQ4SqR) {
-      b[0] = mQuadrupoleGradient * x[1];
-      b[1] = mQuadrupoleGradient * x[0];
-    } else if (TMath::Abs(x[2] + kDip1CZ) < kDip1hDZ && rad2 < kDip1SqRC) {
-      b[1] = mDipoleField;
-    } else if (TMath::Abs(x[2] + kDip2CZ) < kDip2hDZ && rad2 < kDip2SqRC) {
-      double dxabs = TMath::Abs(x[0]) - kDip2DXC;
-      if ((dxabs * dxabs + x[1] * x[1]) < kDip2SqRC) {
-        b[1] = -mDipoleField;
-      }
-    }
-  }
+  mMachineFieldTable.addElement(kBx, -kBComp2CZ, kBComp2DZ, kBComp2R, mCompensatorField2C, 0., kTRUE);
+  mMachineFieldTable.addElement(kQuad, -kTripQ1CZ, kTripQ1DZ, kTripQ1R, mQuadrupoleGradient);
+  mMachineFieldTable.addElement(kQuad, -kTripQ2CZ, kTripQ2DZ, kTripQ2R, -mQuadrupoleGradient);
+  mMachineFieldTable.addElement(kQuad, -kTripQ3CZ, kTripQ3DZ, kTripQ3R, -mQuadrupoleGradient);
+  mMachineFieldTable.addElement(kQuad, -kTripQ4CZ, kTripQ4DZ, kTripQ4R, mQuadrupoleGradient);
+  mMachineFieldTable.addElement(kBy, -kDip1CZ, kDip1DZ, kDip1RC, mDipoleField);
+  mMachineFieldTable.addElement(kBy, -kDip2CZ, kDip2DZ, kDip2RC, -mDipoleField, kDip2DXC);
 
   // SIDE A
-  else {
-    if (TMath::Abs(x[2] - kBComp1CZ) < kBComp1hDZ && rad2 < kBComp1SqR) {
-      // Compensator magnet at z = 1075 m
-      b[0] = mCompensatorField1A * mMultipicativeFactorDipole;
-    }
+  mMachineFieldTable.addElement(kBx, kBComp1CZ, kBComp1DZ, kBComp1R, mCompensatorField1A, 0., kTRUE);
+  mMachineFieldTable.addElement(kBx, kBComp2CZ, kBComp2DZ, kBComp2R, mCompensatorField2A, 0., kTRUE);
+  mMachineFieldTable.addElement(kQuad, kTripQ1CZ, kTripQ1DZ, kTripQ1R, -mQuadrupoleGradient);
+  mMachineFieldTable.addElement(kQuad, kTripQ2CZ, kTripQ2DZ, kTripQ2R, mQuadrupoleGradient);
+  mMachineFieldTable.addElement(kQuad, kTripQ3CZ, kTripQ3DZ, kTripQ3R, mQuadrupoleGradient);
+  mMachineFieldTable.addElement(kQuad, kTripQ4CZ, kTripQ4DZ, kTripQ4R, -mQuadrupoleGradient);
+  mMachineFieldTable.addElement(kBy, kDip1CZ, kDip1DZ, kDip1RA, -mDipoleField);
+  mMachineFieldTable.addElement(kBy, kDip2CZ, kDip2DZ, kDip2RA, mDipoleField, kDip2DXA);
+
+  mMachineFieldTable.build();
+}
 
-    if (TMath::Abs(x[2] - kBComp2CZ) < kBComp2hDZ && rad2 < kBComp2SqR) {
-      b[0] = mCompensatorField2A * mMultipicativeFactorDipole;
-    } else if (TMath::Abs(x[2] - kTripQ1CZ) < kTripQ1hDZ && rad2 < kTripQ1SqR) {
-      b[0] = -mQuadrupoleGradient * x[1];
-      b[1] = -mQuadrupoleGradient * x[0];
-    } else if (TMath::Abs(x[2] - kTripQ2CZ) < kTripQ2hDZ && rad2 < kTripQ2SqR) {
-      b[0] = mQuadrupoleGradient * x[1];
-      b[1] = mQuadrupoleGradient * x[0];
-    } else if (TMath::Abs(x[2] - kTripQ3CZ) < kTripQ3hDZ && rad2 < kTripQ3SqR) {
-      b[0] = mQuadrupoleGradient * x[1];
-      b[1] = mQuadrupoleGradient * x[0];
-    } else if (TMath::Abs(x[2] - kTripQ4CZ) < kTripQ4hDZ && rad2 < kTripQ4SqR) {
-      b[0] = -mQuadrupoleGradient * x[1];
-      b[1] = -mQuadrupoleGradient * x[0];
-    } else if (TMath::Abs(x[2] - kDip1CZ) < kDip1hDZ && rad2 < kDip1SqRA) {
-      b[1] = -mDipoleField;
-    } else if (TMath::Abs(x[2] - kDip2CZ) < kDip2hDZ && rad2 < kDip2SqRA) {
-      double dxabs = TMath::Abs(x[0]) - kDip2DXA;
-      if ((dxabs * dxabs + x[1] * x[1]) < kDip2SqRA) {
-        b[1] = mDipoleField;
-      }
-    }
-  }
+void MagneticField::machineFieldBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z,
+                                      Double_t* bx, Double_t* by, Double_t* bz) const
+{
+  mMachineFieldTable.fieldBatch(n, x, y, z, bx, by, bz, mMultipicativeFactorDipole);
 }
 
 void MagneticField::getTPCIntegral(const Double_t* xyz, Double_t* b) const
 {
   b[0] = b[1] = b[2] = 0.0;
   if (mMeasuredMap) {
-    mMeasuredMap->getTPCIntegral(xyz, b);
+    if (!mTPCIntegralCache || !mTPCIntegralCache->Field(xyz, b)) {
+      mMeasuredMap->getTPCIntegral(xyz, b);
+    }
     for (int i = 3; i--;) {
       b[i] *= mMultipicativeFactorSolenoid;
     }
@@ -365,7 +682,9 @@ void MagneticField::getTPCRatIntegral(const Double_t* xyz, Double_t* b) const
 {
   b[0] = b[1] = b[2] = 0.0;
   if (mMeasuredMap) {
-    mMeasuredMap->getTPCRatIntegral(xyz, b);
+    if (!mTPCRatIntegralCache || !mTPCRatIntegralCache->Field(xyz, b)) {
+      mMeasuredMap->getTPCRatIntegral(xyz, b);
+    }
     b[2] /= 100;
   }
 }
@@ -374,7 +693,13 @@ void MagneticField::getTPCIntegralCylindrical(const Double_t* rphiz, Double_t* b
 {
   b[0] = b[1] = b[2] = 0.0;
   if (mMeasuredMap) {
-    mMeasuredMap->getTPCIntegralCylindrical(rphiz, b);
+    Double_t xyz[3];
+    MagneticWrapperChebyshev::cylindricalToCartesian(rphiz, xyz);
+    if (mTPCIntegralCache && mTPCIntegralCache->Field(xyz, b)) {
+      MagneticWrapperChebyshev::cartesianToCylindricalCylB(rphiz, b, b);
+    } else {
+      mMeasuredMap->getTPCIntegralCylindrical(rphiz, b);
+    }
     for (int i = 3; i--;) {
       b[i] *= mMultipicativeFactorSolenoid;
     }
@@ -385,7 +710,13 @@ void MagneticField::getTPCRatIntegralCylindrical(const Double_t* rphiz, Double_t
 {
   b[0] = b[1] = b[2] = 0.0;
   if (mMeasuredMap) {
-    mMeasuredMap->getTPCRatIntegralCylindrical(rphiz, b);
+    Double_t xyz[3];
+    MagneticWrapperChebyshev::cylindricalToCartesian(rphiz, xyz);
+    if (mTPCRatIntegralCache && mTPCRatIntegralCache->Field(xyz, b)) {
+      MagneticWrapperChebyshev::cartesianToCylindricalCylB(rphiz, b, b);
+    } else {
+      mMeasuredMap->getTPCRatIntegralCylindrical(rphiz, b);
+    }
     b[2] /= 100;
   }
 }
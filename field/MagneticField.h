@@ -10,6 +10,7 @@
 #include <TVirtualMagField.h>
 
 #include "AliceO2Config.h"
+#include "MachineFieldTable.h"
 
 class FairLogger;
 
@@ -17,6 +18,8 @@ namespace AliceO2 {
 namespace Field {
 
 class MagneticWrapperChebyshev;
+class MagneticFieldCache;
+class MagneticFieldCursor;
 
 /// Interface between the TVirtualMagField and MagneticWrapperChebyshev: wrapper to the set of magnetic field data +
 /// Tosca
@@ -35,18 +38,33 @@ public:
   /// Initialize the field with Geant integration option "integ" and max field "fmax",
   /// Impose scaling of parameterized L3 field by factorSol and of dipole by factorDip.
   /// The "be" is the energy of the beam in GeV/nucleon
+  /// compiledMap selects the compiled version of the map, if linked, see MagneticWrapperChebyshev::useCompiledMap
   MagneticField(const char* name, const char* title, Double_t factorSol = 1., Double_t factorDip = 1.,
                 BMap_t maptype = k5kG, BeamType_t btype = kBeamTypepp, Double_t benergy = -1, Int_t integ = 2,
-                Double_t fmax = 15, const char* path = O2PROTO1_MAGF_DIR);
+                Double_t fmax = 15, const char* path = O2PROTO1_MAGF_DIR, Bool_t compiledMap = kFALSE);
   MagneticField(const MagneticField& src);
   MagneticField& operator=(const MagneticField& src);
 
   /// Default destructor
   virtual ~MagneticField();
 
-  /// Method to calculate the field at point xyz
+  /// Method to calculate the field at point xyz.
+  /// Does not modify the object, so one instance can be shared by several threads
   virtual void Field(const Double_t* x, Double_t* b);
 
+  /// Method to calculate the field at point xyz in single precision, see the Float_t version of
+  /// MagneticWrapperChebyshev::Field. The field cache is not used
+  void Field(const Float_t* x, Float_t* b) const;
+
+  /// Method to calculate the field at point xyz, reusing the parameterization segment remembered by the cursor
+  /// for the previous point of the trajectory, see MagneticFieldCursor
+  void Field(const Double_t* x, Double_t* b, MagneticFieldCursor& cursor) const;
+
+  /// Method to calculate the field for n points given as separate coordinate arrays.
+  /// Points inside the measured map are evaluated in one batch, the rest goes to the MachineField
+  void fieldBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bx, Double_t* by,
+                  Double_t* bz) const;
+
   /// Method to calculate the integral_0^z of br,bt,bz
   void getTPCIntegral(const Double_t* xyz, Double_t* b) const;
 
@@ -63,11 +81,46 @@ public:
   /// Method to calculate the field at point xyz
   Double_t getBz(const Double_t* xyz) const;
 
+  /// Method to calculate the field at point xyz using the segment remembered by the cursor
+  Double_t getBz(const Double_t* xyz, MagneticFieldCursor& cursor) const;
+
+  /// Method to calculate Bz at point xyz in single precision
+  Float_t getBz(const Float_t* xyz) const;
+
+  /// Method to calculate Bz for n points given as separate coordinate arrays, see getBz
+  void getBzBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bz) const;
+
+  /// Method to calculate Bz and its derivatives over R, phi and Z for n points given in cylindrical coordinates
+  /// ( -pi<phi<pi convention ). The derivatives are analytic ones of the Solenoid parameterization, points out of
+  /// it get zeros. Any of the derivative arrays may be null
+  void getBzGradientCylindricalBatch(Int_t n, const Double_t* r, const Double_t* phi, const Double_t* z, Double_t* bz,
+                                     Double_t* dbzdr, Double_t* dbzdphi, Double_t* dbzdz) const;
+
   MagneticWrapperChebyshev* getMeasuredMap() const
   {
     return mMeasuredMap;
   }
 
+  /// Sets the tabulated field (owned by the MagneticField) to be used instead of the Chebyshev parameterization
+  /// by Field, fieldBatch and getBz for the points it covers. 0 restores the full precision evaluation
+  void setFieldCache(MagneticFieldCache* cache);
+
+  MagneticFieldCache* getFieldCache() const
+  {
+    return mFieldCache;
+  }
+
+  /// Sets up the tables of the TPC integrals used by getTPCIntegral, getTPCRatIntegral and their cylindrical
+  /// versions. The tables are read from dir/TPCIntegrals_<parameterization>.root if present, otherwise the
+  /// integrals are tabulated on a cylindrical grid with given (R, phi, Z) steps covering their parameterized
+  /// regions and stored there for later jobs. The integrals are tabulated unscaled, so one file serves all
+  /// factors of the same map. The stored tables are tabulated again if the data file (size and modification
+  /// time), the steps or the ranges differ. Returns kFALSE if the tables could not be set up
+  Bool_t setupTPCIntegralCache(const char* dir = ".", const Double_t* step = 0);
+
+  /// Deletes the tables of the TPC integrals, restoring the evaluation of the parameterization
+  void clearTPCIntegralCache();
+
   // Former MagF methods or their aliases
 
   /// Sets the sign/scale of the current in the L3 according to sPolarityConvention
@@ -102,7 +155,26 @@ public:
     return mMapType == k5kGUniform;
   }
 
-  void MachineField(const Double_t* x, Double_t* b) const;
+  /// Field of the beam line elements outside of the measured map, see MachineFieldTable
+  void MachineField(const Double_t* x, Double_t* b) const
+  {
+    mMachineFieldTable.Field(x, b, mMultipicativeFactorDipole);
+  }
+
+  /// MachineField for n points given as separate coordinate arrays
+  void machineFieldBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bx,
+                         Double_t* by, Double_t* bz) const;
+
+  /// Table of the beam line elements used by MachineField. Elements can be added to it, followed by
+  /// MachineFieldTable::build; initializeMachineField restores the default ones
+  MachineFieldTable& getMachineFieldTable()
+  {
+    return mMachineFieldTable;
+  }
+
+  /// Fills the table of beam line elements (compensators, inner triplet, D1 and D2) from the current
+  /// machine field settings
+  void buildMachineFieldTable();
 
   BMap_t getMapType() const
   {
@@ -196,12 +268,21 @@ protected:
     mBeamEnergy = energy;
   }
 
+  /// Returns the factor to be applied to the measured map at given z
+  Double_t getMeasuredMapFactor(Double_t z) const
+  {
+    return (z > sSolenoidToDipoleZ || mDipoleOnOffFlag) ? mMultipicativeFactorSolenoid : mMultipicativeFactorDipole;
+  }
+
 protected:
-  MagneticWrapperChebyshev* mMeasuredMap; //! Measured part of the field map
-  BMap_t mMapType;                        ///< field map type
-  Double_t mSolenoid;                     ///< Solenoid field setting
-  BeamType_t mBeamType;                   ///< Beam type: A-A (mBeamType=0) or p-p (mBeamType=1)
-  Double_t mBeamEnergy;                   ///< Beam energy in GeV
+  MagneticWrapperChebyshev* mMeasuredMap;   //! Measured part of the field map
+  MagneticFieldCache* mFieldCache;          //! Optional tabulated measured field
+  MagneticFieldCache* mTPCIntegralCache;    //! Optional tabulated TPC field integrals
+  MagneticFieldCache* mTPCRatIntegralCache; //! Optional tabulated TPC field ratio integrals
+  BMap_t mMapType;                          ///< field map type
+  Double_t mSolenoid;                       ///< Solenoid field setting
+  BeamType_t mBeamType;                     ///< Beam type: A-A (mBeamType=0) or p-p (mBeamType=1)
+  Double_t mBeamEnergy;                     ///< Beam energy in GeV
 
   Int_t mDefaultIntegration;             ///< Default integration method as indicated in Geant
   Int_t mPrecisionInteg;                 ///< Alternative integration method, e.g. for higher precision
@@ -210,11 +291,12 @@ protected:
   Double_t mMaxField;                    ///< Max Field as indicated in Geant
   Bool_t mDipoleOnOffFlag;               ///< Dipole ON/OFF flag
 
-  Double_t mQuadrupoleGradient; ///< Gradient field for inner triplet quadrupoles
-  Double_t mDipoleField;        ///< Field value for D1 and D2 dipoles
-  Double_t mCompensatorField2C; ///< Side C 2nd compensator field
-  Double_t mCompensatorField1A; ///< Side A 1st compensator field
-  Double_t mCompensatorField2A; ///< Side A 2nd compensator field
+  Double_t mQuadrupoleGradient;         ///< Gradient field for inner triplet quadrupoles
+  Double_t mDipoleField;                ///< Field value for D1 and D2 dipoles
+  Double_t mCompensatorField2C;         ///< Side C 2nd compensator field
+  Double_t mCompensatorField1A;         ///< Side A 1st compensator field
+  Double_t mCompensatorField2A;         ///< Side A 2nd compensator field
+  MachineFieldTable mMachineFieldTable; //! Beam line elements built from the fields above
 
   TNamed mParameterNames; ///< file and parameterization loadad
 
@@ -0,0 +1,282 @@
+/// \file MagneticFieldCache.cxx
+/// \brief Implementation of the MagneticFieldCache class
+
+#include <TMath.h>
+#include <TRandom3.h>
+#include <vector>
+#include "MagneticFieldCache.h"
+#include "MagneticWrapperChebyshev.h"
+
+using namespace AliceO2::Field;
+
+ClassImp(MagneticFieldCache)
+
+MagneticFieldCache::MagneticFieldCache()
+  : TObject(), mGeometry(kCartesian), mQuantity(kField), mNumberOfNodes(0), mTableSize(0), mField(0)
+{
+  for (int i = 3; i--;) {
+    mNumberOfCells[i] = mNumberOfNodesDim[i] = 0;
+    mMin[i] = mScale[i] = 0;
+  }
+}
+
+MagneticFieldCache::MagneticFieldCache(const MagneticWrapperChebyshev* map, Geometry_t geom, const Double_t* min,
+                                       const Double_t* max, const Double_t* step, Quantity_t quantity)
+  : TObject(), mGeometry(kCartesian), mQuantity(kField), mNumberOfNodes(0), mTableSize(0), mField(0)
+{
+  initialize(map, geom, min, max, step, quantity);
+}
+
+MagneticFieldCache::MagneticFieldCache(const MagneticFieldCache& src)
+  : TObject(src),
+    mGeometry(src.mGeometry),
+    mQuantity(src.mQuantity),
+    mNumberOfNodes(src.mNumberOfNodes),
+    mTableSize(src.mTableSize),
+    mField(0)
+{
+  for (int i = 3; i--;) {
+    mNumberOfCells[i] = src.mNumberOfCells[i];
+    mNumberOfNodesDim[i] = src.mNumberOfNodesDim[i];
+    mMin[i] = src.mMin[i];
+    mScale[i] = src.mScale[i];
+  }
+  if (src.mField) {
+    memcpy(mField = new Float_t[mTableSize], src.mField, sizeof(Float_t) * mTableSize);
+  }
+}
+
+MagneticFieldCache& MagneticFieldCache::operator=(const MagneticFieldCache& rhs)
+{
+  if (this != &rhs) {
+    Clear();
+    TObject::operator=(rhs);
+    mGeometry = rhs.mGeometry;
+    mQuantity = rhs.mQuantity;
+    mNumberOfNodes = rhs.mNumberOfNodes;
+    mTableSize = rhs.mTableSize;
+    for (int i = 3; i--;) {
+      mNumberOfCells[i] = rhs.mNumberOfCells[i];
+      mNumberOfNodesDim[i] = rhs.mNumberOfNodesDim[i];
+      mMin[i] = rhs.mMin[i];
+      mScale[i] = rhs.mScale[i];
+    }
+    if (rhs.mField) {
+      memcpy(mField = new Float_t[mTableSize], rhs.mField, sizeof(Float_t) * mTableSize);
+    }
+  }
+  return *this;
+}
+
+MagneticFieldCache::~MagneticFieldCache()
+{
+  Clear();
+}
+
+void MagneticFieldCache::Clear(Option_t*)
+{
+  delete[] mField;
+  mField = 0;
+  mNumberOfNodes = mTableSize = 0;
+  for (int i = 3; i--;) {
+    mNumberOfCells[i] = mNumberOfNodesDim[i] = 0;
+  }
+}
+
+void MagneticFieldCache::initialize(const MagneticWrapperChebyshev* map, Geometry_t geom, const Double_t* min,
+                                    const Double_t* max, const Double_t* step, Quantity_t quantity)
+{
+  Clear();
+  mGeometry = geom;
+  mQuantity = quantity;
+  for (int i = 0; i < 3; i++) {
+    Double_t lo = min[i], hi = max[i];
+    if (geom == kCylindrical && i == 1) { // phi is periodic, the node at +pi is the one at -pi
+      lo = -TMath::Pi();
+      hi = TMath::Pi();
+    }
+    if (hi <= lo || step[i] <= 0) {
+      Error("initialize", "Wrong grid definition in dimension %d: %f:%f with step %f", i, lo, hi, step[i]);
+      Clear();
+      return;
+    }
+    mNumberOfCells[i] = TMath::Max(1, int(TMath::Ceil((hi - lo) / step[i])));
+    mNumberOfNodesDim[i] = (geom == kCylindrical && i == 1) ? mNumberOfCells[i] : mNumberOfCells[i] + 1;
+    mMin[i] = lo;
+    mScale[i] = mNumberOfCells[i] / (hi - lo);
+  }
+  mNumberOfNodes = mNumberOfNodesDim[0] * mNumberOfNodesDim[1] * mNumberOfNodesDim[2];
+  mTableSize = 3 * mNumberOfNodes;
+  mField = new Float_t[mTableSize];
+
+  // the nodes are tabulated by planes of constant first coordinate, using the batched evaluation of the map
+  // when available
+  int nPlane = mNumberOfNodesDim[1] * mNumberOfNodesDim[2];
+  std::vector<Double_t> buffer(6 * nPlane);
+  Double_t *x = &buffer[0], *y = x + nPlane, *z = y + nPlane, *bx = z + nPlane, *by = bx + nPlane, *bz = by + nPlane;
+  for (int i0 = 0; i0 < mNumberOfNodesDim[0]; i0++) {
+    Double_t c0 = mMin[0] + i0 / mScale[0];
+    for (int i1 = 0; i1 < mNumberOfNodesDim[1]; i1++) {
+      Double_t c1 = mMin[1] + i1 / mScale[1];
+      for (int i2 = 0; i2 < mNumberOfNodesDim[2]; i2++) {
+        int j = i1 * mNumberOfNodesDim[2] + i2;
+        if (geom == kCylindrical) {
+          x[j] = c0 * TMath::Cos(c1);
+          y[j] = c0 * TMath::Sin(c1);
+        } else {
+          x[j] = c0;
+          y[j] = c1;
+        }
+        z[j] = mMin[2] + i2 / mScale[2];
+      }
+    }
+    evaluateMap(map, nPlane, x, y, z, bx, by, bz);
+    Float_t* dest = mField + 3 * i0 * nPlane;
+    for (int j = 0; j < nPlane; j++) {
+      dest[3 * j] = bx[j];
+      dest[3 * j + 1] = by[j];
+      dest[3 * j + 2] = bz[j];
+    }
+  }
+}
+
+void MagneticFieldCache::evaluateMap(const MagneticWrapperChebyshev* map, Int_t n, const Double_t* x,
+                                     const Double_t* y, const Double_t* z, Double_t* bx, Double_t* by,
+                                     Double_t* bz) const
+{
+  if (mQuantity == kField) {
+    map->fieldBatch(n, x, y, z, bx, by, bz);
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    Double_t xyz[3] = { x[i], y[i], z[i] }, b[3];
+    if (mQuantity == kTPCIntegral) {
+      map->getTPCIntegral(xyz, b);
+    } else {
+      map->getTPCRatIntegral(xyz, b);
+    }
+    bx[i] = b[0];
+    by[i] = b[1];
+    bz[i] = b[2];
+  }
+}
+
+Bool_t MagneticFieldCache::findCell(const Double_t* xyz, Int_t* node, Double_t* frac) const
+{
+  Double_t pnt[3] = { xyz[0], xyz[1], xyz[2] };
+  if (mGeometry == kCylindrical) {
+    pnt[0] = TMath::Sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1]);
+    pnt[1] = TMath::ATan2(xyz[1], xyz[0]);
+  }
+  for (int i = 0; i < 3; i++) {
+    Double_t t = (pnt[i] - mMin[i]) * mScale[i];
+    if (!(t >= 0 && t <= mNumberOfCells[i])) { // also rejects NaN and the empty table
+      return kFALSE;
+    }
+    node[i] = TMath::Min(int(t), mNumberOfCells[i] - 1);
+    frac[i] = t - node[i];
+  }
+  return kTRUE;
+}
+
+Bool_t MagneticFieldCache::Field(const Double_t* xyz, Double_t* b) const
+{
+  Int_t node[3];
+  Double_t frac[3];
+  if (!findCell(xyz, node, frac)) {
+    return kFALSE;
+  }
+  // for the periodic phi the upper node of the last cell is the first one
+  int next1 = node[1] + 1 < mNumberOfNodesDim[1] ? node[1] + 1 : 0;
+  int stride0 = mNumberOfNodesDim[1] * mNumberOfNodesDim[2];
+  int offs[2][2] = { { node[1] * mNumberOfNodesDim[2], next1 * mNumberOfNodesDim[2] },
+                     { node[1] * mNumberOfNodesDim[2] + stride0, next1 * mNumberOfNodesDim[2] + stride0 } };
+  Double_t w0[2] = { 1. - frac[0], frac[0] }, w1[2] = { 1. - frac[1], frac[1] }, w2[2] = { 1. - frac[2], frac[2] };
+  const Float_t* base = mField + 3 * (node[0] * stride0 + node[2]);
+  b[0] = b[1] = b[2] = 0;
+  for (int i0 = 2; i0--;) {
+    for (int i1 = 2; i1--;) {
+      const Float_t* fld = base + 3 * offs[i0][i1];
+      Double_t w01 = w0[i0] * w1[i1];
+      for (int i2 = 2; i2--;) {
+        Double_t w = w01 * w2[i2];
+        b[0] += w * fld[3 * i2];
+        b[1] += w * fld[3 * i2 + 1];
+        b[2] += w * fld[3 * i2 + 2];
+      }
+    }
+  }
+  return kTRUE;
+}
+
+Bool_t MagneticFieldCache::getBz(const Double_t* xyz, Double_t& bz) const
+{
+  Int_t node[3];
+  Double_t frac[3];
+  if (!findCell(xyz, node, frac)) {
+    return kFALSE;
+  }
+  int next1 = node[1] + 1 < mNumberOfNodesDim[1] ? node[1] + 1 : 0;
+  int stride0 = mNumberOfNodesDim[1] * mNumberOfNodesDim[2];
+  int offs[2][2] = { { node[1] * mNumberOfNodesDim[2], next1 * mNumberOfNodesDim[2] },
+                     { node[1] * mNumberOfNodesDim[2] + stride0, next1 * mNumberOfNodesDim[2] + stride0 } };
+  Double_t w0[2] = { 1. - frac[0], frac[0] }, w1[2] = { 1. - frac[1], frac[1] }, w2[2] = { 1. - frac[2], frac[2] };
+  const Float_t* base = mField + 3 * (node[0] * stride0 + node[2]) + 2;
+  bz = 0;
+  for (int i0 = 2; i0--;) {
+    for (int i1 = 2; i1--;) {
+      const Float_t* fld = base + 3 * offs[i0][i1];
+      bz += w0[i0] * w1[i1] * (w2[0] * fld[0] + w2[1] * fld[3]);
+    }
+  }
+  return kTRUE;
+}
+
+void MagneticFieldCache::compareToMap(const MagneticWrapperChebyshev* map, Int_t npoints, Double_t* maxDev,
+                                      Double_t* rmsDev) const
+{
+  for (int i = 3; i--;) {
+    maxDev[i] = rmsDev[i] = 0;
+  }
+  if (!mField || npoints < 1) {
+    return;
+  }
+  TRandom3 rnd(12345);
+  Double_t pnt[3], xyz[3], bCache[3], bMap[3];
+  for (int ip = 0; ip < npoints; ip++) {
+    for (int i = 3; i--;) {
+      pnt[i] = mMin[i] + rnd.Rndm() * mNumberOfCells[i] / mScale[i];
+    }
+    if (mGeometry == kCylindrical) {
+      xyz[0] = pnt[0] * TMath::Cos(pnt[1]);
+      xyz[1] = pnt[0] * TMath::Sin(pnt[1]);
+      xyz[2] = pnt[2];
+    } else {
+      xyz[0] = pnt[0];
+      xyz[1] = pnt[1];
+      xyz[2] = pnt[2];
+    }
+    Field(xyz, bCache);
+    evaluateMap(map, 1, xyz, xyz + 1, xyz + 2, bMap, bMap + 1, bMap + 2);
+    for (int i = 3; i--;) {
+      Double_t dev = TMath::Abs(bCache[i] - bMap[i]);
+      maxDev[i] = TMath::Max(maxDev[i], dev);
+      rmsDev[i] += dev * dev;
+    }
+  }
+  for (int i = 3; i--;) {
+    rmsDev[i] = TMath::Sqrt(rmsDev[i] / npoints);
+  }
+}
+
+void MagneticFieldCache::Print(Option_t*) const
+{
+  const char* names[2][3] = { { "X", "Y", "Z" }, { "R", "Phi", "Z" } };
+  const char* quantities[3] = { "field", "TPC field integral", "TPC field ratio integral" };
+  printf("Magnetic %s cache on %s grid with %d nodes (%.1f MB)\n", quantities[mQuantity],
+         mGeometry == kCylindrical ? "cylindrical" : "cartesian", mNumberOfNodes, getMemorySize() / 1048576.);
+  for (int i = 0; i < 3; i++) {
+    printf("%3s: %+9.3f : %+9.3f in %d steps of %.4f\n", names[mGeometry][i], mMin[i],
+           mMin[i] + mNumberOfCells[i] / mScale[i], mNumberOfCells[i], 1. / mScale[i]);
+  }
+}
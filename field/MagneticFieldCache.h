@@ -0,0 +1,105 @@
+/// \file MagneticFieldCache.h
+/// \brief Definition of the MagneticFieldCache class
+
+#ifndef ALICEO2_FIELD_MAGNETICFIELDCACHE_H_
+#define ALICEO2_FIELD_MAGNETICFIELDCACHE_H_
+
+#include <TObject.h>
+
+namespace AliceO2 {
+namespace Field {
+
+class MagneticWrapperChebyshev;
+
+/// Field of the MagneticWrapperChebyshev tabulated on a regular grid, either Cartesian (x, y, z) or cylindrical
+/// (R, phi, Z) with the full -pi<phi<pi range, and interpolated trilinearly. It trades memory (12 bytes per
+/// node) and precision, controlled by the grid steps, for a much lower cost per query than the Chebyshev
+/// evaluation. Use compareToMap to check the precision of the chosen grid.
+/// Instead of the field, the TPC field integrals of the map (getTPCIntegral, getTPCRatIntegral) can be tabulated,
+/// the query methods then return the integral in place of the field.
+/// The cache stores the quantities of the map as is, the scaling by the currents is left to the MagneticField
+class MagneticFieldCache : public TObject {
+
+public:
+  enum Geometry_t { kCartesian, kCylindrical };
+  enum Quantity_t { kField, kTPCIntegral, kTPCRatIntegral };
+
+  /// Default constructor
+  MagneticFieldCache();
+
+  /// Tabulates the field of the map in the box min<pnt<max with given steps, the coordinates being (x, y, z)
+  /// for kCartesian and (R, phi, Z) for kCylindrical, in the latter case the phi limits are ignored
+  MagneticFieldCache(const MagneticWrapperChebyshev* map, Geometry_t geom, const Double_t* min, const Double_t* max,
+                     const Double_t* step, Quantity_t quantity = kField);
+
+  MagneticFieldCache(const MagneticFieldCache& src);
+  MagneticFieldCache& operator=(const MagneticFieldCache& rhs);
+
+  /// Default destructor
+  virtual ~MagneticFieldCache();
+
+  /// Tabulates the field, see the constructor
+  void initialize(const MagneticWrapperChebyshev* map, Geometry_t geom, const Double_t* min, const Double_t* max,
+                  const Double_t* step, Quantity_t quantity = kField);
+
+  /// Deletes the table
+  virtual void Clear(Option_t* = "");
+
+  /// Computes the field at cartesian point xyz. Returns kFALSE, leaving b untouched, if the point is not covered
+  Bool_t Field(const Double_t* xyz, Double_t* b) const;
+
+  /// Computes Bz at cartesian point xyz. Returns kFALSE, leaving bz untouched, if the point is not covered
+  Bool_t getBz(const Double_t* xyz, Double_t& bz) const;
+
+  /// Compares the cache with the map at npoints random points of the cached volume and fills the maximal and
+  /// RMS absolute deviations of the 3 cartesian components of the tabulated quantity
+  void compareToMap(const MagneticWrapperChebyshev* map, Int_t npoints, Double_t* maxDev, Double_t* rmsDev) const;
+
+  Geometry_t getGeometry() const
+  {
+    return mGeometry;
+  }
+
+  Quantity_t getQuantity() const
+  {
+    return mQuantity;
+  }
+
+  Int_t getNumberOfNodes() const
+  {
+    return mNumberOfNodes;
+  }
+
+  /// Size of the table in bytes
+  Long_t getMemorySize() const
+  {
+    return sizeof(Float_t) * mTableSize;
+  }
+
+  /// Prints the grid definition
+  virtual void Print(Option_t* = "") const;
+
+protected:
+  /// Finds the cell of the point and the fractional position inside it, returns kFALSE if outside
+  Bool_t findCell(const Double_t* xyz, Int_t* node, Double_t* frac) const;
+
+  /// Evaluates the tabulated quantity of the map for n points given in cartesian coordinates
+  void evaluateMap(const MagneticWrapperChebyshev* map, Int_t n, const Double_t* x, const Double_t* y,
+                   const Double_t* z, Double_t* bx, Double_t* by, Double_t* bz) const;
+
+  Geometry_t mGeometry;        ///< kCartesian or kCylindrical grid
+  Quantity_t mQuantity;        ///< tabulated quantity: field or one of the TPC integrals
+  Int_t mNumberOfCells[3];     ///< number of cells in each dimension
+  Int_t mNumberOfNodesDim[3];  ///< number of nodes in each dimension, equal to cells for the periodic phi
+  Double_t mMin[3];            ///< lower edge of the grid
+  Double_t mScale[3];          ///< inverse step of the grid
+  Int_t mNumberOfNodes;        ///< total number of nodes
+  Int_t mTableSize;            ///< size of the table, 3 values per node
+  Float_t* mField;             //[mTableSize] cartesian components at the nodes, last dimension varying fastest
+
+  ClassDef(AliceO2::Field::MagneticFieldCache, 2) // Tabulated magnetic field with trilinear interpolation
+};
+}
+}
+
+#endif
@@ -0,0 +1,32 @@
+/// \file MagneticFieldCursor.cxx
+/// \brief Implementation of the MagneticFieldCursor class
+
+#include "MagneticFieldCursor.h"
+
+using namespace AliceO2::Field;
+
+MagneticFieldCursor::MagneticFieldCursor(const MagneticField* field)
+  : mField(field),
+    mSegment(0),
+    mMap(0),
+    mMapIdentifier(0),
+    mIsSolenoidSegment(kFALSE),
+    mNumberOfQueries(0),
+    mNumberOfSearches(0)
+{
+}
+
+void MagneticFieldCursor::setField(const MagneticField* field)
+{
+  mField = field;
+  reset();
+}
+
+void MagneticFieldCursor::reset()
+{
+  mSegment = 0;
+  mMap = 0;
+  mMapIdentifier = 0;
+  mIsSolenoidSegment = kFALSE;
+  mNumberOfQueries = mNumberOfSearches = 0;
+}
@@ -0,0 +1,106 @@
+/// \file MagneticFieldCursor.h
+/// \brief Definition of the MagneticFieldCursor class
+
+#ifndef ALICEO2_FIELD_MAGNETICFIELDCURSOR_H_
+#define ALICEO2_FIELD_MAGNETICFIELDCURSOR_H_
+
+#include <Rtypes.h>
+#include "MagneticField.h"
+
+namespace AliceO2 {
+namespace Field {
+
+class Chebyshev3D;
+class MagneticWrapperChebyshev;
+
+/// Stateful helper for the field queries along a trajectory, e.g. by the stepping engines and the track
+/// propagators: it remembers the parameterization segment used for the previous point and, as long as the
+/// following points stay inside it, skips the segment search. On the common boundary of two segments either of
+/// them may be used, which makes a difference within the precision of the parameterization only.
+/// A cursor holds the state of one trajectory and must be used by one thread, the MagneticField can be shared
+class MagneticFieldCursor {
+
+public:
+  /// Default constructor
+  MagneticFieldCursor(const MagneticField* field = 0);
+
+  /// Sets the field to query and forgets the last segment
+  void setField(const MagneticField* field);
+
+  const MagneticField* getField() const
+  {
+    return mField;
+  }
+
+  /// Forgets the last segment, e.g. when starting a new trajectory
+  void reset();
+
+  /// Computes the field at point xyz, see MagneticField::Field
+  void Field(const Double_t* xyz, Double_t* b)
+  {
+    mNumberOfQueries++;
+    mField->Field(xyz, b, *this);
+  }
+
+  /// Computes Bz at point xyz, see MagneticField::getBz
+  Double_t getBz(const Double_t* xyz)
+  {
+    mNumberOfQueries++;
+    return mField->getBz(xyz, *this);
+  }
+
+  const Chebyshev3D* getSegment() const
+  {
+    return mSegment;
+  }
+
+  Bool_t isSolenoidSegment() const
+  {
+    return mIsSolenoidSegment;
+  }
+
+  /// Forgets the last segment unless it was found in map with the current set of parameterizations, see
+  /// MagneticWrapperChebyshev::getIdentifier, e.g. if the cursor is used with another field or the map was reloaded
+  void checkMap(const MagneticWrapperChebyshev* map, ULong64_t identifier)
+  {
+    if (map != mMap || identifier != mMapIdentifier) {
+      mSegment = 0;
+      mIsSolenoidSegment = kFALSE;
+      mMap = map;
+      mMapIdentifier = identifier;
+    }
+  }
+
+  /// Remembers the segment found by the full search
+  void setSegment(const Chebyshev3D* segment, Bool_t solenoid)
+  {
+    mSegment = segment;
+    mIsSolenoidSegment = solenoid;
+    mNumberOfSearches++;
+  }
+
+  /// Number of queries since the last reset
+  Long64_t getNumberOfQueries() const
+  {
+    return mNumberOfQueries;
+  }
+
+  /// Number of full segment searches since the last reset
+  Long64_t getNumberOfSearches() const
+  {
+    return mNumberOfSearches;
+  }
+
+private:
+  const MagneticField* mField;          ///< queried field
+  const Chebyshev3D* mSegment;          ///< segment of the last point inside the parameterized region
+  const MagneticWrapperChebyshev* mMap; ///< map of mSegment
+  ULong64_t mMapIdentifier;             ///< identifier of the parameterizations of mMap when mSegment was found
+  Bool_t mIsSolenoidSegment;            ///< the segment is in (R, phi, Z) of the Solenoid, otherwise of the Dipole
+  Long64_t mNumberOfQueries;            ///< statistics of the queries
+  Long64_t mNumberOfSearches;           ///< statistics of the full segment searches
+};
+}
+}
+
+#endif
@@ -3,15 +3,48 @@
 /// \author ruben.shahoyan@cern.ch 20/03/2007
 
 #include "MagneticWrapperChebyshev.h"
+#include "MagneticFieldCursor.h"
 #include <TSystem.h>
 #include <TArrayF.h>
 #include <TArrayI.h>
 #include "FairLogger.h"
 
+#include <atomic>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace AliceO2::Field;
 
 ClassImp(MagneticWrapperChebyshev)
 
+/// Layout of the binary map file: magic word, {version, byte order mark, file size, 0}, name of the map,
+/// {size, modification time} of the file the map was converted from, then the tables of Solenoid, TPC
+/// integral, TPC ratios integral and Dipole regions
+static const char kBinaryMagic[8] = { 'O', '2', 'M', 'F', 'C', 'H', 'E', 'B' };
+static const Int_t kBinaryVersion = 2;
+static const Int_t kBinaryByteOrder = 0x01020304;
+static const Int_t kBinaryNameLength = 64;
+
+/// Returns a new identifier of a set of parameterizations, see MagneticWrapperChebyshev::getIdentifier
+static ULong64_t nextIdentifier()
+{
+  static std::atomic<ULong64_t> sLastIdentifier(0);
+  return ++sLastIdentifier;
+}
+
+void MagneticWrapperChebyshev::getSourceIdentity(const char* fileName, Long64_t identity[2])
+{
+  identity[0] = identity[1] = 0;
+  struct stat st;
+  if (fileName && fileName[0] && !stat(fileName, &st)) {
+    identity[0] = st.st_size;
+    identity[1] = st.st_mtime;
+  }
+}
+
 MagneticWrapperChebyshev::MagneticWrapperChebyshev()
   : mNumberOfParameterizationSolenoid(0),
     mNumberOfDistinctZSegmentsSolenoid(0),
@@ -76,6 +109,11 @@ MagneticWrapperChebyshev::MagneticWrapperChebyshev()
     mMinDipoleZ(1.e6),
     mMaxDipoleZ(-1.e6),
     mParameterizationDipole(0),
+    mMappedData(0),
+    mMappedSize(0),
+    mPackedData(0),
+    mPackedSize(0),
+    mIdentifier(nextIdentifier()),
     mLogger(FairLogger::GetLogger())
 {
 }
@@ -145,6 +183,11 @@ MagneticWrapperChebyshev::MagneticWrapperChebyshev(const MagneticWrapperChebyshe
     mMinDipoleZ(1.e6),
     mMaxDipoleZ(-1.e6),
     mParameterizationDipole(0),
+    mMappedData(0),
+    mMappedSize(0),
+    mPackedData(0),
+    mPackedSize(0),
+    mIdentifier(nextIdentifier()),
     mLogger(FairLogger::GetLogger())
 {
   copyFrom(src);
@@ -274,6 +317,7 @@ void MagneticWrapperChebyshev::copyFrom(const MagneticWrapperChebyshev& src)
       mParameterizationDipole->AddAtAndExpand(new Chebyshev3D(*src.getParameterDipole(i)), i);
     }
   }
+  buildSegmentGrids();
 }
 
 MagneticWrapperChebyshev& MagneticWrapperChebyshev::operator=(const MagneticWrapperChebyshev& rhs)
@@ -287,6 +331,7 @@ MagneticWrapperChebyshev& MagneticWrapperChebyshev::operator=(const MagneticWrap
 
 void MagneticWrapperChebyshev::Clear(const Option_t*)
 {
+  mIdentifier = nextIdentifier(); // invalidates the segments remembered by the cursors
   if (mNumberOfParameterizationSolenoid) {
     mParameterizationSolenoid->SetOwner(kTRUE);
     delete mParameterizationSolenoid;
@@ -397,6 +442,17 @@ void MagneticWrapperChebyshev::Clear(const Option_t*)
     mNumberOfDistinctXSegmentsDipole = 0;
   mMinDipoleZ = 1e6;
   mMaxDipoleZ = -1e6;
+  clearSegmentGrids();
+
+  // the parameterizations using the mapped binary data are deleted already
+  if (mMappedData) {
+    munmap(mMappedData, mMappedSize);
+    mMappedData = 0;
+    mMappedSize = 0;
+  }
+  delete[] mPackedData;
+  mPackedData = 0;
+  mPackedSize = 0;
 }
 
 void MagneticWrapperChebyshev::Field(const Double_t* xyz, Double_t* b) const
@@ -450,6 +506,700 @@ Double_t MagneticWrapperChebyshev::getBz(const Double_t* xyz) const
   return par->Eval(xyz, 2);
 }
 
+void MagneticWrapperChebyshev::Field(const Float_t* xyz, Float_t* b) const
+{
+  Float_t rphiz[3];
+
+#ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
+  b[0] = b[1] = b[2] = 0;
+#endif
+
+  if (xyz[2] > mMinZSolenoid) {
+    cartesianToCylindrical(xyz, rphiz);
+    Double_t pnt[3] = { rphiz[0], rphiz[1], rphiz[2] }; // the segment search is done on the exact float values
+    int id = findSolenoidSegment(pnt);
+    if (id < 0) {
+      return;
+    }
+    Chebyshev3D* par = getParameterSolenoid(id);
+#ifndef _BRING_TO_BOUNDARY_
+    if (!par->isInside(rphiz)) {
+      return;
+    }
+#endif
+    par->Eval(rphiz, b);
+    cylindricalToCartesianCylB(rphiz, b, b);
+    return;
+  }
+
+  Double_t pnt[3] = { xyz[0], xyz[1], xyz[2] };
+  int iddip = findDipoleSegment(pnt);
+  if (iddip < 0) {
+    return;
+  }
+  Chebyshev3D* par = getParameterDipole(iddip);
+#ifndef _BRING_TO_BOUNDARY_
+  if (!par->isInside(xyz)) {
+    return;
+  }
+#endif
+  par->Eval(xyz, b);
+}
+
+Float_t MagneticWrapperChebyshev::getBz(const Float_t* xyz) const
+{
+  Chebyshev3D* par = 0;
+  Float_t rphiz[3];
+  const Float_t* pnt = xyz;
+  if (xyz[2] > mMinZSolenoid) {
+    cartesianToCylindrical(xyz, rphiz);
+    Double_t rphizD[3] = { rphiz[0], rphiz[1], rphiz[2] };
+    int id = findSolenoidSegment(rphizD);
+    par = id < 0 ? 0 : getParameterSolenoid(id);
+    pnt = rphiz;
+  } else {
+    Double_t xyzD[3] = { xyz[0], xyz[1], xyz[2] };
+    int iddip = findDipoleSegment(xyzD);
+    par = iddip < 0 ? 0 : getParameterDipole(iddip);
+  }
+  if (!par) {
+    return 0.f;
+  }
+#ifndef _BRING_TO_BOUNDARY_
+  if (!par->isInside(pnt)) {
+    return 0.f;
+  }
+#endif
+  return par->Eval(pnt, 2);
+}
+
+void MagneticWrapperChebyshev::Field(const Double_t* xyz, Double_t* b, MagneticFieldCursor& cursor) const
+{
+  cursor.checkMap(this, mIdentifier);
+  Double_t rphiz[3];
+
+#ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
+  b[0] = b[1] = b[2] = 0;
+#endif
+
+  const Chebyshev3D* par = cursor.getSegment();
+  if (xyz[2] > mMinZSolenoid) {
+    cartesianToCylindrical(xyz, rphiz);
+    if (!par || !cursor.isSolenoidSegment() || !par->isInside(rphiz)) {
+      int id = findSolenoidSegment(rphiz);
+      par = id < 0 ? 0 : getParameterSolenoid(id);
+      cursor.setSegment(par, kTRUE);
+      if (!par) {
+        return;
+      }
+#ifndef _BRING_TO_BOUNDARY_
+      if (!par->isInside(rphiz)) {
+        return;
+      }
+#endif
+    }
+    par->Eval(rphiz, b);
+    // convert field to cartesian system
+    cylindricalToCartesianCylB(rphiz, b, b);
+    return;
+  }
+
+  if (!par || cursor.isSolenoidSegment() || !par->isInside(xyz)) {
+    int iddip = findDipoleSegment(xyz);
+    par = iddip < 0 ? 0 : getParameterDipole(iddip);
+    cursor.setSegment(par, kFALSE);
+    if (!par) {
+      return;
+    }
+#ifndef _BRING_TO_BOUNDARY_
+    if (!par->isInside(xyz)) {
+      return;
+    }
+#endif
+  }
+  par->Eval(xyz, b);
+}
+
+Double_t MagneticWrapperChebyshev::getBz(const Double_t* xyz, MagneticFieldCursor& cursor) const
+{
+  cursor.checkMap(this, mIdentifier);
+  Double_t rphiz[3];
+
+  const Chebyshev3D* par = cursor.getSegment();
+  if (xyz[2] > mMinZSolenoid) {
+    cartesianToCylindrical(xyz, rphiz);
+    if (!par || !cursor.isSolenoidSegment() || !par->isInside(rphiz)) {
+      int id = findSolenoidSegment(rphiz);
+      par = id < 0 ? 0 : getParameterSolenoid(id);
+      cursor.setSegment(par, kTRUE);
+      if (!par) {
+        return 0.;
+      }
+#ifndef _BRING_TO_BOUNDARY_
+      if (!par->isInside(rphiz)) {
+        return 0.;
+      }
+#endif
+    }
+    return par->Eval(rphiz, 2);
+  }
+
+  if (!par || cursor.isSolenoidSegment() || !par->isInside(xyz)) {
+    int iddip = findDipoleSegment(xyz);
+    par = iddip < 0 ? 0 : getParameterDipole(iddip);
+    cursor.setSegment(par, kFALSE);
+    if (!par) {
+      return 0.;
+    }
+#ifndef _BRING_TO_BOUNDARY_
+    if (!par->isInside(xyz)) {
+      return 0.;
+    }
+#endif
+  }
+  return par->Eval(xyz, 2);
+}
+
+void MagneticWrapperChebyshev::sortBySegment(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z,
+                                             Int_t* order, Int_t* groupStart, Double_t* par0, Double_t* par1,
+                                             Double_t* par2) const
+{
+  // solenoid segments are numbered first, dipole ones follow, the last slot collects points outside of the map
+  const int nSegments = mNumberOfParameterizationSolenoid + mNumberOfParameterizationDipole;
+  std::vector<Int_t> segment(n);
+  std::vector<Double_t> radius(n), phi(n);
+  for (int is = nSegments + 2; is--;) {
+    groupStart[is] = 0;
+  }
+
+  for (int i = 0; i < n; i++) {
+    Double_t xyz[3] = { x[i], y[i], z[i] }, rphiz[3];
+    int id = -1;
+    if (xyz[2] > mMinZSolenoid) {
+      cartesianToCylindrical(xyz, rphiz);
+      radius[i] = rphiz[0];
+      phi[i] = rphiz[1];
+      id = findSolenoidSegment(rphiz);
+    } else if ((id = findDipoleSegment(xyz)) >= 0) {
+      id += mNumberOfParameterizationSolenoid;
+    }
+    segment[i] = id < 0 ? nSegments : id;
+    groupStart[segment[i] + 1]++;
+  }
+
+  // counting sort of the point indices by segment
+  for (int is = 0; is <= nSegments; is++) {
+    groupStart[is + 1] += groupStart[is];
+  }
+  // arguments of every point in the frame of its parameterization, ordered by segment
+  std::vector<Int_t> fill(groupStart, groupStart + nSegments + 1);
+  for (int i = 0; i < n; i++) {
+    int ip = fill[segment[i]]++;
+    order[ip] = i;
+    Bool_t isSolenoid = segment[i] < mNumberOfParameterizationSolenoid;
+    par0[ip] = isSolenoid ? radius[i] : x[i];
+    par1[ip] = isSolenoid ? phi[i] : y[i];
+    par2[ip] = z[i];
+  }
+}
+
+void MagneticWrapperChebyshev::fieldBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z,
+                                          Double_t* bx, Double_t* by, Double_t* bz) const
+{
+  if (n <= 0) {
+    return;
+  }
+  const int nSegments = mNumberOfParameterizationSolenoid + mNumberOfParameterizationDipole;
+  std::vector<Int_t> order(n), groupStart(nSegments + 2);
+  std::vector<Double_t> buffer(6 * n);
+  Double_t *p0 = &buffer[0], *p1 = p0 + n, *p2 = p1 + n;
+  Double_t* res[3] = { p2 + n, p2 + 2 * n, p2 + 3 * n };
+  sortBySegment(n, x, y, z, &order[0], &groupStart[0], p0, p1, p2);
+
+  for (int is = 0; is < nSegments; is++) {
+    int beg = groupStart[is], end = groupStart[is + 1];
+    if (beg == end) {
+      continue;
+    }
+    Bool_t isSolenoid = is < mNumberOfParameterizationSolenoid;
+    Chebyshev3D* par =
+      isSolenoid ? getParameterSolenoid(is) : getParameterDipole(is - mNumberOfParameterizationSolenoid);
+    Double_t* resGroup[3] = { res[0] + beg, res[1] + beg, res[2] + beg };
+    par->Eval(end - beg, p0 + beg, p1 + beg, p2 + beg, resGroup);
+
+    for (int ip = beg; ip < end; ip++) {
+      int i = order[ip];
+      Double_t pnt[3] = { p0[ip], p1[ip], p2[ip] }, b[3] = { res[0][ip], res[1][ip], res[2][ip] };
+#ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
+      if (!par->isInside(pnt)) {
+        b[0] = b[1] = b[2] = 0.;
+      }
+#endif
+      if (isSolenoid) {
+        cylindricalToCartesianCylB(pnt, b, b);
+      }
+      bx[i] = b[0];
+      by[i] = b[1];
+      bz[i] = b[2];
+    }
+  }
+
+  for (int ip = groupStart[nSegments]; ip < n; ip++) {
+    int i = order[ip];
+    bx[i] = by[i] = bz[i] = 0.;
+  }
+}
+
+void MagneticWrapperChebyshev::getBzBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z,
+                                          Double_t* bz) const
+{
+  if (n <= 0) {
+    return;
+  }
+  const int nSegments = mNumberOfParameterizationSolenoid + mNumberOfParameterizationDipole;
+  std::vector<Int_t> order(n), groupStart(nSegments + 2);
+  std::vector<Double_t> buffer(4 * n);
+  Double_t *p0 = &buffer[0], *p1 = p0 + n, *p2 = p1 + n;
+  // Bz is the 3rd component in both the cylindrical and the cartesian frame, the other ones are not evaluated
+  Double_t* res[3] = { 0, 0, p2 + n };
+  sortBySegment(n, x, y, z, &order[0], &groupStart[0], p0, p1, p2);
+
+  for (int is = 0; is < nSegments; is++) {
+    int beg = groupStart[is], end = groupStart[is + 1];
+    if (beg == end) {
+      continue;
+    }
+    Chebyshev3D* par = is < mNumberOfParameterizationSolenoid
+                         ? getParameterSolenoid(is)
+                         : getParameterDipole(is - mNumberOfParameterizationSolenoid);
+    Double_t* resGroup[3] = { 0, 0, res[2] + beg };
+    par->Eval(end - beg, p0 + beg, p1 + beg, p2 + beg, resGroup);
+
+    for (int ip = beg; ip < end; ip++) {
+      int i = order[ip];
+      bz[i] = res[2][ip];
+#ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
+      Double_t pnt[3] = { p0[ip], p1[ip], p2[ip] };
+      if (!par->isInside(pnt)) {
+        bz[i] = 0.;
+      }
+#endif
+    }
+  }
+
+  for (int ip = groupStart[nSegments]; ip < n; ip++) {
+    bz[order[ip]] = 0.;
+  }
+}
+
+void MagneticWrapperChebyshev::getBzGradientCylindricalBatch(Int_t n, const Double_t* r, const Double_t* phi,
+                                                             const Double_t* z, Double_t* bz, Double_t* dbzdr,
+                                                             Double_t* dbzdphi, Double_t* dbzdz) const
+{
+  // dense grids are scanned in order, so the segment of the previous point is tried first
+  const Chebyshev3D* par = 0;
+  for (int i = 0; i < n; i++) {
+    Double_t rphiz[3] = { r[i], phi[i], z[i] }, grad[3] = { 0., 0., 0. }, val = 0.;
+    if (!par || !par->isInside(rphiz)) {
+      int id = findSolenoidSegment(rphiz);
+      par = id < 0 ? 0 : getParameterSolenoid(id);
+    }
+#ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
+    if (par && par->isInside(rphiz)) {
+#else
+    if (par) {
+#endif
+      val = par->evaluateGradient(rphiz, 2, grad);
+    }
+    bz[i] = val;
+    if (dbzdr) {
+      dbzdr[i] = grad[0];
+    }
+    if (dbzdphi) {
+      dbzdphi[i] = grad[1];
+    }
+    if (dbzdz) {
+      dbzdz[i] = grad[2];
+    }
+  }
+}
+
+void MagneticWrapperChebyshev::saveBinaryData(const char* outfile, const char* sourceFile) const
+{
+  TString strf = outfile;
+  gSystem->ExpandPathName(strf);
+  FILE* stream = fopen(strf, "wb");
+  if (!stream) {
+    mLogger->Error(MESSAGE_ORIGIN, "Failed to open output file %s", strf.Data());
+    return;
+  }
+
+  Int_t info[4] = { kBinaryVersion, kBinaryByteOrder, 0, 0 };
+  char name[kBinaryNameLength] = { 0 };
+  strncpy(name, GetName(), kBinaryNameLength - 1);
+  Long64_t source[2];
+  TString strs = sourceFile ? sourceFile : "";
+  gSystem->ExpandPathName(strs);
+  getSourceIdentity(strs.Data(), source);
+  if (sourceFile && !source[0]) {
+    mLogger->Warning(MESSAGE_ORIGIN, "Cannot find source file %s of %s, the binary map will not be checked against it",
+                     strs.Data(), strf.Data());
+  }
+  Chebyshev3DCalc::writeBinaryBlock(stream, kBinaryMagic, sizeof(kBinaryMagic));
+  Chebyshev3DCalc::writeBinaryBlock(stream, info, sizeof(info));
+  Chebyshev3DCalc::writeBinaryBlock(stream, name, sizeof(name));
+  Chebyshev3DCalc::writeBinaryBlock(stream, source, sizeof(source));
+
+  saveBinaryTable(stream, mNumberOfParameterizationSolenoid, mParameterizationSolenoid,
+                  mNumberOfDistinctZSegmentsSolenoid, mNumberOfDistinctPSegmentsSolenoid,
+                  mNumberOfDistinctRSegmentsSolenoid, mMinZSolenoid, mMaxZSolenoid, mMaxRadiusSolenoid,
+                  mCoordinatesSegmentsZSolenoid, mCoordinatesSegmentsPSolenoid, mCoordinatesSegmentsRSolenoid,
+                  mBeginningOfSegmentsPSolenoid, mNumberOfSegmentsPSolenoid, mBeginningOfSegmentsRSolenoid,
+                  mNumberOfRSegmentsSolenoid, mSegmentIdSolenoid);
+
+  saveBinaryTable(stream, mNumberOfParameterizationTPC, mParameterizationTPC, mNumberOfDistinctZSegmentsTPC,
+                  mNumberOfDistinctPSegmentsTPC, mNumberOfDistinctRSegmentsTPC, mMinZTPC, mMaxZTPC, mMaxRadiusTPC,
+                  mCoordinatesSegmentsZTPC, mCoordinatesSegmentsPTPC, mCoordinatesSegmentsRTPC,
+                  mBeginningOfSegmentsPTPC, mNumberOfSegmentsPTPC, mBeginningOfSegmentsRTPC, mNumberOfRSegmentsTPC,
+                  mSegmentIdTPC);
+
+  saveBinaryTable(stream, mNumberOfParameterizationTPCRat, mParameterizationTPCRat, mNumberOfDistinctZSegmentsTPCRat,
+                  mNumberOfDistinctPSegmentsTPCRat, mNumberOfDistinctRSegmentsTPCRat, mMinZTPCRat, mMaxZTPCRat,
+                  mMaxRadiusTPCRat, mCoordinatesSegmentsZTPCRat, mCoordinatesSegmentsPTPCRat,
+                  mCoordinatesSegmentsRTPCRat, mBeginningOfSegmentsPTPCRat, mNumberOfSegmentsPTPCRat,
+                  mBeginningOfSegmentsRTPCRat, mNumberOfRSegmentsTPCRat, mSegmentIdTPCRat);
+
+  saveBinaryTable(stream, mNumberOfParameterizationDipole, mParameterizationDipole, mNumberOfDistinctZSegmentsDipole,
+                  mNumberOfDistinctYSegmentsDipole, mNumberOfDistinctXSegmentsDipole, mMinDipoleZ, mMaxDipoleZ, 0.f,
+                  mCoordinatesSegmentsZDipole, mCoordinatesSegmentsYDipole, mCoordinatesSegmentsXDipole,
+                  mBeginningOfSegmentsYDipole, mNumberOfSegmentsYDipole, mBeginningOfSegmentsXDipole,
+                  mNumberOfSegmentsXDipole, mSegmentIdDipole);
+
+  // store the total size to detect truncated files
+  info[2] = ftell(stream);
+  fseek(stream, sizeof(kBinaryMagic), SEEK_SET);
+  fwrite(info, sizeof(info), 1, stream);
+  fclose(stream);
+}
+
+void MagneticWrapperChebyshev::saveCompiledMap(const char* outfile) const
+{
+  for (int ip = 0; ip < mNumberOfParameterizationSolenoid + mNumberOfParameterizationDipole; ip++) {
+    Chebyshev3D* par = ip < mNumberOfParameterizationSolenoid
+                         ? getParameterSolenoid(ip)
+                         : getParameterDipole(ip - mNumberOfParameterizationSolenoid);
+    if (par->getNumberOfOutputDimensions() != 3) {
+      mLogger->Error(MESSAGE_ORIGIN, "Segment %d has %d output dimensions instead of 3", ip,
+                     par->getNumberOfOutputDimensions());
+      return;
+    }
+  }
+  TString strf = outfile;
+  gSystem->ExpandPathName(strf);
+  FILE* stream = fopen(strf, "w");
+  if (!stream) {
+    mLogger->Error(MESSAGE_ORIGIN, "Failed to open output file %s", strf.Data());
+    return;
+  }
+
+  fprintf(stream, "// Generated by MagneticWrapperChebyshev::saveCompiledMap from %s, do not edit\n\n", GetName());
+  fprintf(stream, "#include \"CompiledFieldMap.h\"\n\nusing AliceO2::Field::CompiledFieldMap;\n\n");
+  fprintf(stream, "namespace {\n\n");
+  for (int ip = 0; ip < mNumberOfParameterizationSolenoid; ip++) {
+    getParameterSolenoid(ip)->saveCompiledEvaluator(stream, Form("sol%d", ip));
+  }
+  for (int ip = 0; ip < mNumberOfParameterizationDipole; ip++) {
+    getParameterDipole(ip)->saveCompiledEvaluator(stream, Form("dip%d", ip));
+  }
+
+  const char* prefix[2] = { "sol", "dip" };
+  const char* table[2] = { "kSolenoid", "kDipole" };
+  Int_t npar[2] = { mNumberOfParameterizationSolenoid, mNumberOfParameterizationDipole };
+  for (int ir = 0; ir < 2; ir++) {
+    fprintf(stream, "const CompiledFieldMap::Evaluator_t %s[%d] = {", table[ir], TMath::Max(1, 3 * npar[ir]));
+    for (int ip = 0; ip < npar[ir]; ip++) {
+      fprintf(stream, "%s\n  %s%d_0, %s%d_1, %s%d_2", ip ? "," : "", prefix[ir], ip, prefix[ir], ip, prefix[ir], ip);
+    }
+    fprintf(stream, "%s};\n\n", npar[ir] ? "\n" : "0");
+  }
+  fprintf(stream, "const CompiledFieldMap kCompiledMap(\"%s\", %d, kSolenoid, %d, kDipole);\n}\n", GetName(),
+          npar[0], npar[1]);
+  fclose(stream);
+}
+
+Bool_t MagneticWrapperChebyshev::useCompiledMap(Bool_t use)
+{
+  const CompiledFieldMap* compiled = 0;
+  if (use) {
+    compiled = CompiledFieldMap::find(GetName());
+    if (!compiled) {
+      mLogger->Warning(MESSAGE_ORIGIN, "No compiled version of the field map %s is linked", GetName());
+      return kFALSE;
+    }
+    if (compiled->getNumberOfSolenoidSegments() != mNumberOfParameterizationSolenoid ||
+        compiled->getNumberOfDipoleSegments() != mNumberOfParameterizationDipole) {
+      mLogger->Error(MESSAGE_ORIGIN, "Compiled field map %s has %d+%d segments instead of %d+%d", GetName(),
+                     compiled->getNumberOfSolenoidSegments(), compiled->getNumberOfDipoleSegments(),
+                     mNumberOfParameterizationSolenoid, mNumberOfParameterizationDipole);
+      return kFALSE;
+    }
+    // the compiled code must reproduce the coefficients exactly, check it on the 3x3x3 points made of the
+    // bounds and the center of every segment, the corners included. The evaluators set by an earlier call are
+    // detached meanwhile, so that the compiled map is compared to the coefficients and not to itself
+    for (int ip = 0; ip < mNumberOfParameterizationSolenoid + mNumberOfParameterizationDipole; ip++) {
+      Bool_t isSolenoid = ip < mNumberOfParameterizationSolenoid;
+      int id = isSolenoid ? ip : ip - mNumberOfParameterizationSolenoid;
+      Chebyshev3D* par = isSolenoid ? getParameterSolenoid(id) : getParameterDipole(id);
+      const CompiledFieldMap::Evaluator_t* eval =
+        isSolenoid ? compiled->getSolenoidEvaluators(id) : compiled->getDipoleEvaluators(id);
+      const CompiledFieldMap::Evaluator_t* current = par->getCompiledEvaluators();
+      par->setCompiledEvaluators(0);
+      Bool_t same = kTRUE;
+      for (int ipnt = 0; ipnt < 27 && same; ipnt++) {
+        Double_t pnt[3], b[3];
+        for (int i = 0, step = ipnt; i < 3; i++, step /= 3) {
+          pnt[i] = par->getBoundMin(i) + 0.5 * (step % 3) * (par->getBoundMax(i) - par->getBoundMin(i));
+        }
+        par->Eval(pnt, b);
+        for (int i = 3; i--;) {
+          same = same && eval[i](pnt) == b[i];
+        }
+      }
+      par->setCompiledEvaluators(current);
+      if (!same) {
+        mLogger->Error(MESSAGE_ORIGIN, "Compiled field map %s differs from the parameterization in segment %d",
+                       GetName(), ip);
+        return kFALSE;
+      }
+    }
+  }
+  for (int ip = 0; ip < mNumberOfParameterizationSolenoid; ip++) {
+    getParameterSolenoid(ip)->setCompiledEvaluators(compiled ? compiled->getSolenoidEvaluators(ip) : 0);
+  }
+  for (int ip = 0; ip < mNumberOfParameterizationDipole; ip++) {
+    getParameterDipole(ip)->setCompiledEvaluators(compiled ? compiled->getDipoleEvaluators(ip) : 0);
+  }
+  return kTRUE;
+}
+
+Long_t MagneticWrapperChebyshev::packParameterizations(Float_t tolerance, Float_t integralTolerance)
+{
+  const int kNRegions = 4;
+  TObjArray* parArr[kNRegions] = { mParameterizationSolenoid, mParameterizationTPC, mParameterizationTPCRat,
+                                   mParameterizationDipole };
+  Int_t npar[kNRegions] = { mNumberOfParameterizationSolenoid, mNumberOfParameterizationTPC,
+                            mNumberOfParameterizationTPCRat, mNumberOfParameterizationDipole };
+  // the integrals are in kGauss*cm, the field in kGauss
+  Float_t tol[kNRegions] = { tolerance, integralTolerance, integralTolerance, tolerance };
+  // the first pass only computes the sizes of the data read by the evaluation and of the rest
+  size_t hotSize = 0, coldSize = 0;
+  for (int ir = 0; ir < kNRegions; ir++) {
+    for (int ip = 0; ip < npar[ir]; ip++) {
+      ((Chebyshev3D*)parArr[ir]->UncheckedAt(ip))->packData(0, hotSize, coldSize, tol[ir]);
+    }
+  }
+  char* arena = new char[hotSize + coldSize];
+  size_t hotOffset = 0, coldOffset = hotSize;
+  Int_t nQuantized = 0, nCalc = 0;
+  for (int ir = 0; ir < kNRegions; ir++) {
+    for (int ip = 0; ip < npar[ir]; ip++) {
+      Chebyshev3D* par = (Chebyshev3D*)parArr[ir]->UncheckedAt(ip);
+      nQuantized += par->packData(arena, hotOffset, coldOffset, tol[ir]);
+      nCalc += par->getNumberOfOutputDimensions();
+    }
+  }
+
+  // neither the previous arena nor the mapped binary file are used any more
+  delete[] mPackedData;
+  mPackedData = arena;
+  mPackedSize = hotSize + coldSize;
+  if (mMappedData) {
+    munmap(mMappedData, mMappedSize);
+    mMappedData = 0;
+    mMappedSize = 0;
+  }
+  mLogger->Info(MESSAGE_ORIGIN, "Packed %d parameterizations of %s into %ld+%ld bytes, %d of them quantized",
+                nCalc, GetName(), (Long_t)hotSize, (Long_t)coldSize, nQuantized);
+  return hotSize;
+}
+
+Bool_t MagneticWrapperChebyshev::loadBinaryData(const char* inpfile, const char* sourceFile, const char* mapName)
+{
+  TString strf = inpfile;
+  gSystem->ExpandPathName(strf);
+  int fd = open(strf.Data(), O_RDONLY);
+  if (fd < 0) {
+    mLogger->Error(MESSAGE_ORIGIN, "Failed to open binary field map %s", strf.Data());
+    return kFALSE;
+  }
+  struct stat st;
+  void* addr = MAP_FAILED;
+  Long_t headerSize = sizeof(kBinaryMagic) + 4 * sizeof(Int_t) + kBinaryNameLength + 2 * sizeof(Long64_t);
+  if (!fstat(fd, &st) && st.st_size > headerSize) {
+    addr = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (addr == MAP_FAILED) {
+    mLogger->Error(MESSAGE_ORIGIN, "Failed to map binary field map %s", strf.Data());
+    return kFALSE;
+  }
+
+  const char* data = (const char*)addr;
+  const char* end = data + st.st_size;
+  const char* magic = Chebyshev3DCalc::readBinaryBlock(data, end, sizeof(kBinaryMagic));
+  const Int_t* info = (const Int_t*)Chebyshev3DCalc::readBinaryBlock(data, end, 4 * sizeof(Int_t));
+  const char* name = Chebyshev3DCalc::readBinaryBlock(data, end, kBinaryNameLength);
+  const Long64_t* source = (const Long64_t*)Chebyshev3DCalc::readBinaryBlock(data, end, 2 * sizeof(Long64_t));
+  if (memcmp(magic, kBinaryMagic, sizeof(kBinaryMagic)) || info[0] != kBinaryVersion ||
+      info[1] != kBinaryByteOrder || info[2] != st.st_size) {
+    mLogger->Error(MESSAGE_ORIGIN, "File %s is not a valid binary field map of version %d", strf.Data(),
+                   kBinaryVersion);
+    munmap(addr, st.st_size);
+    return kFALSE;
+  }
+  if (mapName && strncmp(name, mapName, kBinaryNameLength)) {
+    mLogger->Warning(MESSAGE_ORIGIN, "Binary field map %s holds %s instead of %s", strf.Data(), name, mapName);
+    munmap(addr, st.st_size);
+    return kFALSE;
+  }
+  if (sourceFile) {
+    TString strs = sourceFile;
+    gSystem->ExpandPathName(strs);
+    Long64_t identity[2];
+    getSourceIdentity(strs.Data(), identity);
+    if (!source[0] || source[0] != identity[0] || source[1] != identity[1]) {
+      mLogger->Warning(MESSAGE_ORIGIN, "Binary field map %s was not converted from the current %s", strf.Data(),
+                       strs.Data());
+      munmap(addr, st.st_size);
+      return kFALSE;
+    }
+  }
+
+  Clear();
+  mMappedData = addr;
+  mMappedSize = st.st_size;
+  SetName(name); // written zero-terminated
+
+  data = mapBinaryTable(data, end, mNumberOfParameterizationSolenoid, &mParameterizationSolenoid,
+                        mNumberOfDistinctZSegmentsSolenoid, mNumberOfDistinctPSegmentsSolenoid,
+                        mNumberOfDistinctRSegmentsSolenoid, mMinZSolenoid, mMaxZSolenoid, mMaxRadiusSolenoid,
+                        &mCoordinatesSegmentsZSolenoid, &mCoordinatesSegmentsPSolenoid, &mCoordinatesSegmentsRSolenoid,
+                        &mBeginningOfSegmentsPSolenoid, &mNumberOfSegmentsPSolenoid, &mBeginningOfSegmentsRSolenoid,
+                        &mNumberOfRSegmentsSolenoid, &mSegmentIdSolenoid);
+
+  data = mapBinaryTable(data, end, mNumberOfParameterizationTPC, &mParameterizationTPC, mNumberOfDistinctZSegmentsTPC,
+                        mNumberOfDistinctPSegmentsTPC, mNumberOfDistinctRSegmentsTPC, mMinZTPC, mMaxZTPC,
+                        mMaxRadiusTPC, &mCoordinatesSegmentsZTPC, &mCoordinatesSegmentsPTPC, &mCoordinatesSegmentsRTPC,
+                        &mBeginningOfSegmentsPTPC, &mNumberOfSegmentsPTPC, &mBeginningOfSegmentsRTPC,
+                        &mNumberOfRSegmentsTPC, &mSegmentIdTPC);
+
+  data = mapBinaryTable(data, end, mNumberOfParameterizationTPCRat, &mParameterizationTPCRat,
+                        mNumberOfDistinctZSegmentsTPCRat, mNumberOfDistinctPSegmentsTPCRat,
+                        mNumberOfDistinctRSegmentsTPCRat, mMinZTPCRat, mMaxZTPCRat, mMaxRadiusTPCRat,
+                        &mCoordinatesSegmentsZTPCRat, &mCoordinatesSegmentsPTPCRat, &mCoordinatesSegmentsRTPCRat,
+                        &mBeginningOfSegmentsPTPCRat, &mNumberOfSegmentsPTPCRat, &mBeginningOfSegmentsRTPCRat,
+                        &mNumberOfRSegmentsTPCRat, &mSegmentIdTPCRat);
+
+  Float_t dummyR;
+  data = mapBinaryTable(data, end, mNumberOfParameterizationDipole, &mParameterizationDipole,
+                        mNumberOfDistinctZSegmentsDipole, mNumberOfDistinctYSegmentsDipole,
+                        mNumberOfDistinctXSegmentsDipole, mMinDipoleZ, mMaxDipoleZ, dummyR,
+                        &mCoordinatesSegmentsZDipole, &mCoordinatesSegmentsYDipole, &mCoordinatesSegmentsXDipole,
+                        &mBeginningOfSegmentsYDipole, &mNumberOfSegmentsYDipole, &mBeginningOfSegmentsXDipole,
+                        &mNumberOfSegmentsXDipole, &mSegmentIdDipole);
+  if (!data) {
+    mLogger->Error(MESSAGE_ORIGIN, "Binary field map %s is corrupted, its tables overrun the file", strf.Data());
+    Clear(); // unmaps the file
+    return kFALSE;
+  }
+  buildSegmentGrids();
+  return kTRUE;
+}
+
+void MagneticWrapperChebyshev::saveBinaryTable(FILE* stream, Int_t npar, const TObjArray* parArr, Int_t nZSeg,
+                                               Int_t nYSeg, Int_t nXSeg, Float_t minZ, Float_t maxZ, Float_t maxR,
+                                               const Float_t* segZ, const Float_t* segY, const Float_t* segX,
+                                               const Int_t* begSegY, const Int_t* nSegY, const Int_t* begSegX,
+                                               const Int_t* nSegX, const Int_t* segID)
+{
+  Int_t counts[4] = { npar, nZSeg, nYSeg, nXSeg };
+  Float_t limits[4] = { minZ, maxZ, maxR, 0.f };
+  Chebyshev3DCalc::writeBinaryBlock(stream, counts, sizeof(counts));
+  Chebyshev3DCalc::writeBinaryBlock(stream, limits, sizeof(limits));
+  if (!npar) {
+    return;
+  }
+  Chebyshev3DCalc::writeBinaryBlock(stream, segZ, nZSeg * sizeof(Float_t));
+  Chebyshev3DCalc::writeBinaryBlock(stream, segY, nYSeg * sizeof(Float_t));
+  Chebyshev3DCalc::writeBinaryBlock(stream, segX, nXSeg * sizeof(Float_t));
+  Chebyshev3DCalc::writeBinaryBlock(stream, begSegY, nZSeg * sizeof(Int_t));
+  Chebyshev3DCalc::writeBinaryBlock(stream, nSegY, nZSeg * sizeof(Int_t));
+  Chebyshev3DCalc::writeBinaryBlock(stream, begSegX, nYSeg * sizeof(Int_t));
+  Chebyshev3DCalc::writeBinaryBlock(stream, nSegX, nYSeg * sizeof(Int_t));
+  Chebyshev3DCalc::writeBinaryBlock(stream, segID, nXSeg * sizeof(Int_t));
+  for (int i = 0; i < npar; i++) {
+    ((Chebyshev3D*)parArr->UncheckedAt(i))->saveBinaryData(stream);
+  }
+}
+
+const char* MagneticWrapperChebyshev::mapBinaryTable(const char* data, const char* end, Int_t& npar,
+                                                     TObjArray** parArr, Int_t& nZSeg, Int_t& nYSeg, Int_t& nXSeg,
+                                                     Float_t& minZ, Float_t& maxZ, Float_t& maxR, Float_t** segZ,
+                                                     Float_t** segY, Float_t** segX, Int_t** begSegY, Int_t** nSegY,
+                                                     Int_t** begSegX, Int_t** nSegX, Int_t** segID)
+{
+  const Int_t* counts = (const Int_t*)Chebyshev3DCalc::readBinaryBlock(data, end, 4 * sizeof(Int_t));
+  const Float_t* limits = (const Float_t*)Chebyshev3DCalc::readBinaryBlock(data, end, 4 * sizeof(Float_t));
+  if (!data || counts[0] < 0) {
+    return 0;
+  }
+  if (!counts[0]) {
+    npar = 0;
+    nZSeg = counts[1];
+    nYSeg = counts[2];
+    nXSeg = counts[3];
+    minZ = limits[0];
+    maxZ = limits[1];
+    maxR = limits[2];
+    return data;
+  }
+  // all blocks are checked against the end of the data before the tables are allocated
+  const char* zBlock = Chebyshev3DCalc::readBinaryBlock(data, end, counts[1] * sizeof(Float_t));
+  const char* yBlock = Chebyshev3DCalc::readBinaryBlock(data, end, counts[2] * sizeof(Float_t));
+  const char* xBlock = Chebyshev3DCalc::readBinaryBlock(data, end, counts[3] * sizeof(Float_t));
+  const char* begYBlock = Chebyshev3DCalc::readBinaryBlock(data, end, counts[1] * sizeof(Int_t));
+  const char* nYBlock = Chebyshev3DCalc::readBinaryBlock(data, end, counts[1] * sizeof(Int_t));
+  const char* begXBlock = Chebyshev3DCalc::readBinaryBlock(data, end, counts[2] * sizeof(Int_t));
+  const char* nXBlock = Chebyshev3DCalc::readBinaryBlock(data, end, counts[2] * sizeof(Int_t));
+  const char* idBlock = Chebyshev3DCalc::readBinaryBlock(data, end, counts[3] * sizeof(Int_t));
+  if (!data) {
+    return 0;
+  }
+  npar = counts[0];
+  nZSeg = counts[1];
+  nYSeg = counts[2];
+  nXSeg = counts[3];
+  minZ = limits[0];
+  maxZ = limits[1];
+  maxR = limits[2];
+  // the lookup tables are small and owned by the object, the coefficients stay in the mapped data
+  memcpy(*segZ = new Float_t[nZSeg], zBlock, nZSeg * sizeof(Float_t));
+  memcpy(*segY = new Float_t[nYSeg], yBlock, nYSeg * sizeof(Float_t));
+  memcpy(*segX = new Float_t[nXSeg], xBlock, nXSeg * sizeof(Float_t));
+  memcpy(*begSegY = new Int_t[nZSeg], begYBlock, nZSeg * sizeof(Int_t));
+  memcpy(*nSegY = new Int_t[nZSeg], nYBlock, nZSeg * sizeof(Int_t));
+  memcpy(*begSegX = new Int_t[nYSeg], begXBlock, nYSeg * sizeof(Int_t));
+  memcpy(*nSegX = new Int_t[nYSeg], nXBlock, nYSeg * sizeof(Int_t));
+  memcpy(*segID = new Int_t[nXSeg], idBlock, nXSeg * sizeof(Int_t));
+  *parArr = new TObjArray(npar);
+  for (int i = 0; i < npar && data; i++) {
+    Chebyshev3D* par = new Chebyshev3D();
+    data = par->mapBinaryData(data, end);
+    (*parArr)->AddAtAndExpand(par, i);
+  }
+  return data;
+}
+
 void MagneticWrapperChebyshev::Print(Option_t*) const
 {
   printf("Alice magnetic field parameterized by Chebyshev polynomials\n");
@@ -491,11 +1241,45 @@ void MagneticWrapperChebyshev::Print(Option_t*) const
   }
 }
 
+void MagneticWrapperChebyshev::buildSegmentGrids()
+{
+  Double_t pnt[3];
+  mSegmentGridSolenoid.initialize(mParameterizationSolenoid, mNumberOfParameterizationSolenoid);
+  for (int i = mSegmentGridSolenoid.getNumberOfCells(); i--;) {
+    int id = mSegmentGridSolenoid.getCell(i);
+    if (id != SegmentLookupGrid::kAmbiguous) { // keep the cell only if the search agrees
+      mSegmentGridSolenoid.setCell(i, SegmentLookupGrid::kAmbiguous);
+      mSegmentGridSolenoid.getCellCenter(i, pnt);
+      mSegmentGridSolenoid.setCell(i, findSolenoidSegment(pnt) == id ? id : SegmentLookupGrid::kAmbiguous);
+    }
+  }
+
+  mSegmentGridDipole.initialize(mParameterizationDipole, mNumberOfParameterizationDipole);
+  for (int i = mSegmentGridDipole.getNumberOfCells(); i--;) {
+    int id = mSegmentGridDipole.getCell(i);
+    if (id != SegmentLookupGrid::kAmbiguous) {
+      mSegmentGridDipole.setCell(i, SegmentLookupGrid::kAmbiguous);
+      mSegmentGridDipole.getCellCenter(i, pnt);
+      mSegmentGridDipole.setCell(i, findDipoleSegment(pnt) == id ? id : SegmentLookupGrid::kAmbiguous);
+    }
+  }
+}
+
+void MagneticWrapperChebyshev::clearSegmentGrids()
+{
+  mSegmentGridSolenoid.reset();
+  mSegmentGridDipole.reset();
+}
+
 Int_t MagneticWrapperChebyshev::findDipoleSegment(const Double_t* xyz) const
 {
   if (!mNumberOfParameterizationDipole) {
     return -1;
   }
+  int gid = mSegmentGridDipole.find(xyz);
+  if (gid != SegmentLookupGrid::kAmbiguous) {
+    return gid;
+  }
   int xid, yid, zid = TMath::BinarySearch(mNumberOfDistinctZSegmentsDipole, mCoordinatesSegmentsZDipole,
                                           (Float_t)xyz[2]); // find zsegment
 
@@ -542,6 +1326,10 @@ Int_t MagneticWrapperChebyshev::findSolenoidSegment(const Double_t* rpz) const
   if (!mNumberOfParameterizationSolenoid) {
     return -1;
   }
+  int gid = mSegmentGridSolenoid.find(rpz);
+  if (gid != SegmentLookupGrid::kAmbiguous) {
+    return gid;
+  }
   int rid, pid, zid = TMath::BinarySearch(mNumberOfDistinctZSegmentsSolenoid, mCoordinatesSegmentsZSolenoid,
                                           (Float_t)rpz[2]); // find zsegment
 
@@ -673,7 +1461,7 @@ Int_t MagneticWrapperChebyshev::findTPCRatSegment(const Double_t* rpz) const
 
 void MagneticWrapperChebyshev::getTPCIntegral(const Double_t* xyz, Double_t* b) const
 {
-  static Double_t rphiz[3];
+  Double_t rphiz[3];
 
   // TPCInt region
   // convert coordinates to cyl system
@@ -695,7 +1483,7 @@ void MagneticWrapperChebyshev::getTPCIntegral(const Double_t* xyz, Double_t* b)
 
 void MagneticWrapperChebyshev::getTPCRatIntegral(const Double_t* xyz, Double_t* b) const
 {
-  static Double_t rphiz[3];
+  Double_t rphiz[3];
 
   // TPCRatIntegral region
   // convert coordinates to cylindrical system
@@ -917,6 +1705,7 @@ void MagneticWrapperChebyshev::loadData(const char* inpfile)
   buildTableDipole();
   buildTableTPCIntegral();
   buildTableTPCRatIntegral();
+  buildSegmentGrids();
 
   printf("Loaded magnetic field \"%s\" from %s\n", GetName(), strf.Data());
 }
@@ -8,7 +8,9 @@
 #include <TMath.h>
 #include <TNamed.h>
 #include <TObjArray.h>
+#include <cmath>
 #include "Chebyshev3D.h"
+#include "SegmentLookupGrid.h"
 
 class TSystem;
 class TArrayF;
@@ -18,6 +20,8 @@ class FairLogger;
 namespace AliceO2 {
 namespace Field {
 
+class MagneticFieldCursor;
+
 ///  Wrapper for the set of mag.field parameterizations by Chebyshev polinomials
 ///  To obtain the field in cartesian coordinates/components use
 ///    Field(double* xyz, double* bxyz);
@@ -39,6 +43,9 @@ namespace Field {
 ///  getTPCIntegral(double* xyz, double* bxyz);  for cartesian frame
 ///  or getTPCIntegralCylindrical(Double_t *rphiz, Double_t *b); for cylindrical frame
 ///  The units are kiloGauss and cm.
+///  The evaluation methods (Field, getBz, fieldBatch, fieldCylindrical and the TPC integrals) do not modify
+///  the object and use no shared scratch buffers, so a single instance can be queried concurrently from
+///  several threads.
 class MagneticWrapperChebyshev : public TNamed {
 
 public:
@@ -195,12 +202,45 @@ public:
   virtual void Print(Option_t* = "") const;
 
   /// Computes field in cartesian coordinates. If point is outside of the parameterized region
-  /// it gets it at closest valid point
+  /// it gets it at closest valid point. Thread-safe
   virtual void Field(const Double_t* xyz, Double_t* b) const;
   /// Computes Bz for the point in cartesian coordinates. If point is outside of the parameterized region
   /// it gets it at closest valid point
   Double_t getBz(const Double_t* xyz) const;
 
+  /// Computes field in cartesian coordinates keeping the whole computation in single precision: the coordinate
+  /// conversions, the boundary mapping and the Chebyshev evaluation. The segment search is the same as for
+  /// Field. Use macro/validateFloatField.C to quantify the deviation from the double precision evaluation
+  void Field(const Float_t* xyz, Float_t* b) const;
+
+  /// Computes Bz in single precision, see the Float_t version of Field
+  Float_t getBz(const Float_t* xyz) const;
+
+  /// Computes field in cartesian coordinates, starting with the segment remembered by the cursor and updating
+  /// it when the point left it
+  void Field(const Double_t* xyz, Double_t* b, MagneticFieldCursor& cursor) const;
+
+  /// Computes Bz for the point in cartesian coordinates using the segment remembered by the cursor
+  Double_t getBz(const Double_t* xyz, MagneticFieldCursor& cursor) const;
+
+  /// Computes field in cartesian coordinates for n points given as separate coordinate arrays.
+  /// The points are grouped by the parameterization segment they belong to and each group is evaluated
+  /// in one go, so that the coefficients of the segment are reused while they are in cache.
+  /// Points outside of the parameterized region get zero field
+  void fieldBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bx, Double_t* by,
+                  Double_t* bz) const;
+
+  /// Computes Bz for n points given in cartesian coordinates as separate arrays. The points are grouped by
+  /// segment as in fieldBatch, but only the Bz parameterization of every segment is evaluated.
+  /// Points outside of the parameterized region get zero field
+  void getBzBatch(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Double_t* bz) const;
+
+  /// Computes Bz and its analytic derivatives over R, phi and Z for n points of the Solenoid region given in
+  /// cylindrical coordinates as separate arrays. Any of the derivative arrays may be null if not needed.
+  /// Points outside of the Solenoid parameterization get zero field and gradient
+  void getBzGradientCylindricalBatch(Int_t n, const Double_t* r, const Double_t* phi, const Double_t* z, Double_t* bz,
+                                     Double_t* dbzdr, Double_t* dbzdphi, Double_t* dbzdz) const;
+
   void fieldCylindrical(const Double_t* rphiz, Double_t* b) const;
 
   /// Computes TPC region field integral in cartesian coordinates.
@@ -219,6 +259,13 @@ public:
   // note: the check for the point being inside the parameterized region is done outside
   void getTPCRatIntegralCylindrical(const Double_t* rphiz, Double_t* b) const;
 
+  /// Builds the segment lookup grids of the Solenoid and Dipole regions, must be called after the
+  /// parameterizations were loaded or modified
+  void buildSegmentGrids();
+
+  /// Deletes the segment lookup grids, the segments are then found by the search in the lookup tables
+  void clearSegmentGrids();
+
   /// Finds the segment containing point xyz. If it is outside it finds the closest segment
   Int_t findSolenoidSegment(const Double_t* xyz) const;
 
@@ -235,8 +282,57 @@ public:
   static void cartesianToCylindricalCartB(const Double_t* xyz, const Double_t* bxyz, Double_t* brphiz);
   static void cartesianToCylindricalCylB(const Double_t* rphiz, const Double_t* bxyz, Double_t* brphiz);
   static void cartesianToCylindrical(const Double_t* xyz, Double_t* rphiz);
+  /// Single precision versions of the conversions, the field is rotated by a single sin/cos pair
+  static void cylindricalToCartesianCylB(const Float_t* rphiz, const Float_t* brphiz, Float_t* bxyz);
+  static void cartesianToCylindrical(const Float_t* xyz, Float_t* rphiz);
   static void cylindricalToCartesian(const Double_t* rphiz, Double_t* xyz);
 
+  /// Writes the lookup tables and parameterizations of all regions to a binary file in the native byte order.
+  /// The blocks are aligned such that the file can be used in place by loadBinaryData. The size and
+  /// modification time of sourceFile, the file the map was read from, are stored to identify it
+  void saveBinaryData(const char* outfile, const char* sourceFile = 0) const;
+
+  /// Maps read-only the binary file produced by saveBinaryData. Only the small lookup tables are copied, the
+  /// Chebyshev coefficients are used directly from the mapped memory, which is shared by all processes
+  /// mapping the same file. Returns kFALSE if the file cannot be mapped or has wrong format, if it does not
+  /// hold the map mapName or was not converted from the current version of sourceFile (when given)
+  Bool_t loadBinaryData(const char* inpfile, const char* sourceFile = 0, const char* mapName = 0);
+
+  /// Gets the size and modification time of fileName, identifying the version of a map file, 0 if it is missing
+  static void getSourceIdentity(const char* fileName, Long64_t identity[2]);
+
+  /// Writes C++ source with the Solenoid and Dipole parameterizations compiled into unrolled evaluators with
+  /// constexpr coefficients, registered as CompiledFieldMap under the name of this map. The source is meant to
+  /// be linked to the Field library for a frozen production map, see macro/generateCompiledFieldMap.C
+  void saveCompiledMap(const char* outfile) const;
+
+  /// Switches the Solenoid and Dipole parameterizations to the compiled evaluators registered under the name
+  /// of this map, or back to the coefficients if use is kFALSE. The compiled map must reproduce the evaluation of
+  /// the coefficients exactly at the corners, the centers of the faces and edges and the center of every
+  /// segment. Returns kFALSE if no matching compiled map is linked, in which case the evaluation is unchanged
+  Bool_t useCompiledMap(Bool_t use = kTRUE);
+
+  /// Packs the coefficients and bound arrays of all parameterizations into one arena, segment after segment,
+  /// in place of the separate allocations of every parameterization or of the mapped binary file. If
+  /// tolerance>0, the field parameterizations whose error with 16-bit coefficients does not exceed tolerance
+  /// (kGauss) are evaluated from them, see Chebyshev3DCalc::quantizeCoefficients, and likewise the TPC and
+  /// TPCRat integral parameterizations with integralTolerance (kGauss*cm); their float coefficients, used only
+  /// by the derivatives, are moved to the end of the arena so that the data read by the evaluation stays
+  /// contiguous. Returns the size of the data read by the evaluation in bytes
+  Long_t packParameterizations(Float_t tolerance = 0, Float_t integralTolerance = 0);
+
+  Long_t getPackedSize() const
+  {
+    return mPackedSize;
+  }
+
+  /// Identifier of the current set of parameterizations, unique in the process and changed whenever they are
+  /// cleared or replaced, such that the segments remembered by a MagneticFieldCursor can be checked
+  ULong64_t getIdentifier() const
+  {
+    return mIdentifier;
+  }
+
 #ifdef _INC_CREATION_ALICHEB3D_ // see Cheb3D.h for explanation
   /// Reads coefficients data from the text file
   void loadData(const char* inpfile);
@@ -306,6 +402,27 @@ protected:
   /// note: if the point is outside the volume it gets the field in closest parameterized point
   Double_t fieldCylindricalSolenoidBz(const Double_t* rphiz) const;
 
+  /// Groups n points given in cartesian coordinates by parameterization segment: solenoid segments come first,
+  /// dipole ones follow and the last group collects the points outside of the map. order receives the point
+  /// indices group by group, groupStart (nSolenoid+nDipole+2 elements) the beginning of every group and
+  /// par0, par1, par2 the arguments of the ordered points in the frame of their parameterization
+  void sortBySegment(Int_t n, const Double_t* x, const Double_t* y, const Double_t* z, Int_t* order,
+                     Int_t* groupStart, Double_t* par0, Double_t* par1, Double_t* par2) const;
+
+  /// Writes the lookup table and parameterizations of one field region in the binary format
+  static void saveBinaryTable(FILE* stream, Int_t npar, const TObjArray* parArr, Int_t nZSeg, Int_t nYSeg, Int_t nXSeg,
+                              Float_t minZ, Float_t maxZ, Float_t maxR, const Float_t* segZ, const Float_t* segY,
+                              const Float_t* segX, const Int_t* begSegY, const Int_t* nSegY, const Int_t* begSegX,
+                              const Int_t* nSegX, const Int_t* segID);
+
+  /// Reads the lookup table and parameterizations of one field region written by saveBinaryTable, the binary
+  /// data ending at end. Returns the pointer beyond the data of this region, 0 if data is 0 or the data are
+  /// corrupted. The lookup table is set only if it is complete
+  static const char* mapBinaryTable(const char* data, const char* end, Int_t& npar, TObjArray** parArr,
+                                    Int_t& nZSeg, Int_t& nYSeg, Int_t& nXSeg, Float_t& minZ, Float_t& maxZ,
+                                    Float_t& maxR, Float_t** segZ, Float_t** segY, Float_t** segX, Int_t** begSegY,
+                                    Int_t** nSegY, Int_t** begSegX, Int_t** nSegX, Int_t** segID);
+
 protected:
   Int_t mNumberOfParameterizationSolenoid;  ///< Total number of parameterization pieces for solenoid
   Int_t mNumberOfDistinctZSegmentsSolenoid; ///< number of distinct Z segments in Solenoid
@@ -395,6 +512,15 @@ protected:
   Float_t mMaxDipoleZ;     ///< Max Z of Dipole parameterization
   TObjArray* mParameterizationDipole; ///< Parameterization pieces for Dipole field
 
+  SegmentLookupGrid mSegmentGridSolenoid; //! acceleration grid for findSolenoidSegment
+  SegmentLookupGrid mSegmentGridDipole;   //! acceleration grid for findDipoleSegment
+
+  void* mMappedData;     //! binary map file mapped by loadBinaryData, used by the parameterizations
+  Long_t mMappedSize;    //! size of the mapped binary map file
+  char* mPackedData;     //! arena of the parameterizations packed by packParameterizations
+  Long_t mPackedSize;    //! size of the arena
+  ULong64_t mIdentifier; //! identifier of the current set of parameterizations, see getIdentifier
+
   FairLogger* mLogger;
   ClassDef(AliceO2::Field::MagneticWrapperChebyshev, 2) // Wrapper class for the set of Chebishev parameterizations of Alice mag.field
 };
@@ -459,6 +585,22 @@ inline void MagneticWrapperChebyshev::cartesianToCylindrical(const Double_t* xyz
   rphiz[2] = xyz[2];
 }
 
+inline void MagneticWrapperChebyshev::cylindricalToCartesianCylB(const Float_t* rphiz, const Float_t* brphiz,
+                                                                 Float_t* bxyz)
+{
+  Float_t cs = std::cos(rphiz[1]), sn = std::sin(rphiz[1]), br = brphiz[0], bphi = brphiz[1];
+  bxyz[0] = br * cs - bphi * sn;
+  bxyz[1] = br * sn + bphi * cs;
+  bxyz[2] = brphiz[2];
+}
+
+inline void MagneticWrapperChebyshev::cartesianToCylindrical(const Float_t* xyz, Float_t* rphiz)
+{
+  rphiz[0] = std::sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1]);
+  rphiz[1] = std::atan2(xyz[1], xyz[0]);
+  rphiz[2] = xyz[2];
+}
+
 inline void MagneticWrapperChebyshev::cylindricalToCartesian(const Double_t* rphiz, Double_t* xyz)
 {
   xyz[0] = rphiz[0] * TMath::Cos(rphiz[1]);
@@ -0,0 +1,102 @@
+/// \file SegmentLookupGrid.cxx
+/// \brief Implementation of the SegmentLookupGrid class
+
+#include <TMath.h>
+#include <TObjArray.h>
+#include <algorithm>
+#include <vector>
+#include "Chebyshev3D.h"
+#include "SegmentLookupGrid.h"
+
+using namespace AliceO2::Field;
+
+/// Margin (in the units of the parameterization) kept between a cell and the boundary of the segment it is
+/// assigned to, covering the float precision of the boundaries and the recheck tolerance of the segment search
+static const Double_t kSegmentMargin = 1.e-4;
+
+SegmentLookupGrid::SegmentLookupGrid() : mCells(0)
+{
+  for (int i = 3; i--;) {
+    mNumberOfCells[i] = 0;
+    mMin[i] = 0;
+    mScale[i] = 0;
+  }
+}
+
+void SegmentLookupGrid::reset()
+{
+  delete[] mCells;
+  mCells = 0;
+  for (int i = 3; i--;) {
+    mNumberOfCells[i] = 0;
+  }
+}
+
+void SegmentLookupGrid::initialize(const TObjArray* parArr, Int_t npar)
+{
+  reset();
+  if (npar < 1 || npar > 32767) { // ids are stored as Short_t
+    return;
+  }
+
+  // distinct boundaries in each dimension define the granularity of the grid
+  std::vector<Float_t> bounds[3];
+  for (int ip = 0; ip < npar; ip++) {
+    const Chebyshev3D* par = (const Chebyshev3D*)parArr->UncheckedAt(ip);
+    for (int i = 3; i--;) {
+      bounds[i].push_back(par->getBoundMin(i));
+      bounds[i].push_back(par->getBoundMax(i));
+    }
+  }
+  Double_t ncells = 1, nb[3];
+  for (int i = 3; i--;) {
+    std::sort(bounds[i].begin(), bounds[i].end());
+    nb[i] = std::unique(bounds[i].begin(), bounds[i].end()) - bounds[i].begin();
+    nb[i] *= kCellsPerBoundary;
+    ncells *= nb[i];
+  }
+  Double_t shrink = ncells > kMaxCells ? TMath::Power(kMaxCells / ncells, 1. / 3) : 1.;
+  for (int i = 3; i--;) {
+    mNumberOfCells[i] = TMath::Max(1, int(nb[i] * shrink));
+    mMin[i] = bounds[i].front();
+    mScale[i] = mNumberOfCells[i] / (bounds[i].back() - mMin[i]);
+  }
+
+  int ntot = getNumberOfCells();
+  mCells = new Short_t[ntot];
+  for (int i = ntot; i--;) {
+    mCells[i] = kAmbiguous;
+  }
+
+  // cells overlapping with several segments are marked by -2 and released at the end
+  for (int ip = 0; ip < npar; ip++) {
+    const Chebyshev3D* par = (const Chebyshev3D*)parArr->UncheckedAt(ip);
+    int beg[3], end[3];
+    for (int i = 3; i--;) {
+      beg[i] = TMath::Max(0, int(TMath::Ceil((par->getBoundMin(i) + kSegmentMargin - mMin[i]) * mScale[i])));
+      end[i] = TMath::Min(mNumberOfCells[i],
+                          int(TMath::Floor((par->getBoundMax(i) - kSegmentMargin - mMin[i]) * mScale[i])));
+    }
+    for (int i0 = beg[0]; i0 < end[0]; i0++) {
+      for (int i1 = beg[1]; i1 < end[1]; i1++) {
+        Short_t* cell = mCells + (i0 * mNumberOfCells[1] + i1) * mNumberOfCells[2];
+        for (int i2 = beg[2]; i2 < end[2]; i2++) {
+          cell[i2] = cell[i2] == kAmbiguous ? ip : -2;
+        }
+      }
+    }
+  }
+  for (int i = ntot; i--;) {
+    if (mCells[i] < 0) {
+      mCells[i] = kAmbiguous;
+    }
+  }
+}
+
+void SegmentLookupGrid::getCellCenter(Int_t cell, Double_t* pnt) const
+{
+  for (int i = 3; i--;) {
+    pnt[i] = mMin[i] + ((cell % mNumberOfCells[i]) + 0.5) / mScale[i];
+    cell /= mNumberOfCells[i];
+  }
+}
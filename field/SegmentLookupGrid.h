@@ -0,0 +1,86 @@
+/// \file SegmentLookupGrid.h
+/// \brief Definition of the SegmentLookupGrid class
+
+#ifndef ALICEO2_FIELD_SEGMENTLOOKUPGRID_H_
+#define ALICEO2_FIELD_SEGMENTLOOKUPGRID_H_
+
+#include <Rtypes.h>
+
+class TObjArray;
+
+namespace AliceO2 {
+namespace Field {
+
+/// Uniform acceleration grid over the box covering a set of Chebyshev3D parameterization segments.
+/// Each cell lying fully (with a small margin) inside one segment stores the id of this segment, so that
+/// the segment of a point is resolved by 3 multiplications and one table read. Cells crossed by a segment
+/// boundary, as well as points outside of the grid, are reported as kAmbiguous and must be resolved by
+/// the ordinary segment search.
+class SegmentLookupGrid {
+
+public:
+  enum { kAmbiguous = -1, kMaxCells = 1 << 18, kCellsPerBoundary = 8 };
+
+  /// Default constructor
+  SegmentLookupGrid();
+
+  /// Default destructor
+  ~SegmentLookupGrid()
+  {
+    reset();
+  }
+
+  /// Deletes the grid, after which all points are reported as kAmbiguous
+  void reset();
+
+  /// Defines the grid covering the npar segments in parArr and assigns the segment id to each cell fully
+  /// contained in a single segment. The ids can then be validated with getCellCenter/setCell
+  void initialize(const TObjArray* parArr, Int_t npar);
+
+  Int_t getNumberOfCells() const
+  {
+    return mNumberOfCells[0] * mNumberOfCells[1] * mNumberOfCells[2];
+  }
+
+  Int_t getCell(Int_t cell) const
+  {
+    return mCells[cell];
+  }
+
+  void setCell(Int_t cell, Int_t id)
+  {
+    mCells[cell] = id;
+  }
+
+  /// Returns the center of the cell in the coordinates of the parameterization
+  void getCellCenter(Int_t cell, Double_t* pnt) const;
+
+  /// Returns the id of the segment containing the point or kAmbiguous if it cannot be resolved by the grid
+  Int_t find(const Double_t* pnt) const;
+
+private:
+  SegmentLookupGrid(const SegmentLookupGrid&);
+  SegmentLookupGrid& operator=(const SegmentLookupGrid&);
+
+  Int_t mNumberOfCells[3]; ///< number of cells in each dimension
+  Double_t mMin[3];        ///< lower edge of the grid in each dimension
+  Double_t mScale[3];      ///< inverse cell size in each dimension
+  Short_t* mCells;         ///< segment id per cell, kAmbiguous if not unique
+};
+
+inline Int_t SegmentLookupGrid::find(const Double_t* pnt) const
+{
+  int cell = 0;
+  for (int i = 0; i < 3; i++) {
+    Double_t t = (pnt[i] - mMin[i]) * mScale[i];
+    if (!(t >= 0 && t < mNumberOfCells[i])) { // also rejects NaN and the empty grid
+      return kAmbiguous;
+    }
+    cell = cell * mNumberOfCells[i] + int(t);
+  }
+  return mCells[cell];
+}
+}
+}
+
+#endif
@@ -8,6 +8,7 @@
 #pragma link C++ class AliceO2::Field::MagneticField+;
 #pragma link C++ class AliceO2::Field::MagneticWrapperChebyshev+;
 #pragma link C++ class AliceO2::Field::Chebyshev3DCalc+;
+#pragma link C++ class AliceO2::Field::MagneticFieldCache+;
 
 //map the old to the new variables:
 //AliCheb3D-------OLD
@@ -0,0 +1,333 @@
+/// \file benchmarkField.cxx
+/// \brief Micro-benchmarks of the magnetic field evaluation and regression check of their timing
+///
+/// Usage: benchmarkField [-n npoints] [-r repetitions] [-o results.csv] [-c reference.csv] [-t tolerance]
+///                       [-p packTolerance] [-i packIntegralTolerance]
+///
+/// Times MagneticField::Field, getBz, getTPCIntegral, MachineField and the raw Chebyshev3DCalc::Eval on
+/// points along helical tracks from the interaction point, uniformly sampled in the Solenoid and TPC
+/// volumes, in the muon arm dipole and along the beam line up to the ZDC. For every benchmark the best of
+/// the repetitions is reported in ns/call and calls/s and written to the results file as CSV lines
+/// "benchmark,region,calls,ns_per_call,calls_per_s,checksum". If a reference file produced by an earlier run
+/// is given, every benchmark slower than the reference by more than the relative tolerance is reported and
+/// the exit code is 1. With -p the parameterizations are packed first, see
+/// MagneticWrapperChebyshev::packParameterizations, with the quantization tolerance of the field given in kGauss
+/// (0 to only pack them) and with -i that of the TPC integrals in kGauss*cm (not quantized by default)
+
+#include "MagneticField.h"
+#include "MagneticWrapperChebyshev.h"
+#include "Chebyshev3D.h"
+#include "Chebyshev3DCalc.h"
+#include "BenchmarkTools.h"
+
+#include <TMath.h>
+#include <TRandom3.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace AliceO2::Field;
+using namespace AliceO2::Benchmark;
+
+namespace {
+
+/// Timing of one benchmark on one point distribution
+struct BenchmarkResult {
+  std::string mBenchmark; ///< evaluated method
+  std::string mRegion;    ///< point distribution
+  Int_t mCalls;           ///< calls per repetition
+  Double_t mNsPerCall;    ///< best time per call over the repetitions
+  Double_t mChecksum;     ///< sum of the results, keeps the evaluation from being optimized away
+};
+
+/// Points given as consecutive (x, y, z) triplets
+typedef std::vector<Double_t> Points_t;
+
+/// Runs body(i) for i<n, repetitions times, and returns the best time per call in ns
+template <typename Body>
+Double_t timeLoop(Int_t n, Int_t repetitions, Body body)
+{
+  Double_t best = -1;
+  for (int rep = repetitions; rep--;) {
+    Clock_t::time_point start = Clock_t::now();
+    for (int i = 0; i < n; i++) {
+      body(i);
+    }
+    Double_t ns = elapsedMs(start) * 1e6;
+    if (best < 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return n > 0 ? best / n : 0.;
+}
+
+/// Points along helices from the interaction point in the solenoid field bz (kGauss), log-uniform in pT in
+/// [0.1, 10] GeV and uniform in tan(lambda) in [-1, 1], sampled every 2 cm until leaving the Solenoid map
+void generateHelicalTracks(TRandom3& rnd, const MagneticWrapperChebyshev* map, Double_t bz, Int_t npoints,
+                           Points_t& pnt)
+{
+  const Double_t kB2C = 0.299792458e-3, kStep = 2.;
+  pnt.clear();
+  while (Int_t(pnt.size()) < 3 * npoints) {
+    Double_t pt = 0.1 * TMath::Power(100., rnd.Rndm()), tgl = 2 * (rnd.Rndm() - 0.5);
+    Double_t phi0 = TMath::TwoPi() * rnd.Rndm(), q = rnd.Rndm() < 0.5 ? -1. : 1.;
+    Double_t radius = pt / (kB2C * TMath::Max(TMath::Abs(bz), 1e-3)), sign = bz < 0 ? -q : q;
+    for (Double_t s = 0; Int_t(pnt.size()) < 3 * npoints; s += kStep) {
+      Double_t phi = phi0 - sign * s / radius;
+      Double_t x = sign * radius * (TMath::Sin(phi0) - TMath::Sin(phi));
+      Double_t y = sign * radius * (TMath::Cos(phi) - TMath::Cos(phi0));
+      Double_t z = s * tgl;
+      if (x * x + y * y >= map->getMaxRSol() * map->getMaxRSol() || z <= map->getMinZSol() ||
+          z >= map->getMaxZSol() || s > TMath::Pi() * radius) { // stop looping tracks after half a turn
+        break;
+      }
+      pnt.push_back(x);
+      pnt.push_back(y);
+      pnt.push_back(z);
+    }
+  }
+}
+
+/// Points uniform in the cylinder r<rMax, zMin<z<zMax
+void generateCylinder(TRandom3& rnd, Double_t rMax, Double_t zMin, Double_t zMax, Int_t npoints, Points_t& pnt)
+{
+  pnt.resize(3 * npoints);
+  for (int i = 0; i < npoints; i++) {
+    Double_t r = rMax * TMath::Sqrt(rnd.Rndm()), phi = TMath::TwoPi() * rnd.Rndm();
+    pnt[3 * i] = r * TMath::Cos(phi);
+    pnt[3 * i + 1] = r * TMath::Sin(phi);
+    pnt[3 * i + 2] = zMin + (zMax - zMin) * rnd.Rndm();
+  }
+}
+
+/// Points inside the apertures of the beam line elements, on both sides of the interaction point
+void generateBeamLine(TRandom3& rnd, const MachineFieldTable& table, Int_t npoints, Points_t& pnt)
+{
+  pnt.clear();
+  if (!table.getNumberOfElements()) {
+    generateCylinder(rnd, 1., -2000., 2000., npoints, pnt);
+    return;
+  }
+  for (int i = 0; i < npoints; i++) {
+    const MachineFieldElement& el = table.getElement(rnd.Integer(table.getNumberOfElements()));
+    Double_t r = TMath::Sqrt(el.mApertureSqR * rnd.Rndm()), phi = TMath::TwoPi() * rnd.Rndm();
+    Double_t xc = el.mOffsetX * (rnd.Rndm() < 0.5 ? -1. : 1.);
+    pnt.push_back(xc + r * TMath::Cos(phi));
+    pnt.push_back(r * TMath::Sin(phi));
+    pnt.push_back(el.mZMin + (el.mZMax - el.mZMin) * rnd.Rndm());
+  }
+}
+
+/// Reads the results written by writeResults, returns kFALSE if the file cannot be opened
+Bool_t readResults(const char* fileName, std::vector<BenchmarkResult>& results)
+{
+  FILE* stream = fopen(fileName, "r");
+  if (!stream) {
+    return kFALSE;
+  }
+  char line[1024], benchmark[256], region[256];
+  while (fgets(line, sizeof(line), stream)) {
+    BenchmarkResult res;
+    Double_t callsPerS;
+    if (line[0] == '#' || sscanf(line, "%255[^,],%255[^,],%d,%lf,%lf,%lf", benchmark, region, &res.mCalls,
+                                 &res.mNsPerCall, &callsPerS, &res.mChecksum) != 6) {
+      continue;
+    }
+    res.mBenchmark = benchmark;
+    res.mRegion = region;
+    results.push_back(res);
+  }
+  fclose(stream);
+  return kTRUE;
+}
+
+/// Writes the results as CSV with a commented header line, returns kFALSE if the file cannot be created
+Bool_t writeResults(const char* fileName, const std::vector<BenchmarkResult>& results)
+{
+  FILE* stream = fopen(fileName, "w");
+  if (!stream) {
+    return kFALSE;
+  }
+  fprintf(stream, "# benchmark,region,calls,ns_per_call,calls_per_s,checksum\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& res = results[i];
+    fprintf(stream, "%s,%s,%d,%.3f,%.6e,%.10e\n", res.mBenchmark.c_str(), res.mRegion.c_str(), res.mCalls,
+            res.mNsPerCall, res.mNsPerCall > 0 ? 1e9 / res.mNsPerCall : 0., res.mChecksum);
+  }
+  fclose(stream);
+  return kTRUE;
+}
+
+/// Compares the results to the reference ones and returns the number of benchmarks slower by more than the
+/// relative tolerance
+Int_t compareResults(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& reference,
+                     Double_t tolerance)
+{
+  Int_t nSlower = 0;
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& res = results[i];
+    const BenchmarkResult* ref = 0;
+    for (size_t j = 0; j < reference.size() && !ref; j++) {
+      if (reference[j].mBenchmark == res.mBenchmark && reference[j].mRegion == res.mRegion) {
+        ref = &reference[j];
+      }
+    }
+    if (!ref) {
+      printf("%-24s %-10s: no reference\n", res.mBenchmark.c_str(), res.mRegion.c_str());
+      continue;
+    }
+    Double_t ratio = ref->mNsPerCall > 0 ? res.mNsPerCall / ref->mNsPerCall : 1.;
+    Bool_t slower = ratio > 1. + tolerance;
+    printf("%-24s %-10s: %8.1f ns/call, reference %8.1f ns/call, ratio %5.2f%s\n", res.mBenchmark.c_str(),
+           res.mRegion.c_str(), res.mNsPerCall, ref->mNsPerCall, ratio, slower ? "  REGRESSION" : "");
+    if (slower) {
+      nSlower++;
+    }
+  }
+  return nSlower;
+}
+
+void printUsage(const char* exe)
+{
+  printf("Usage: %s [-n npoints] [-r repetitions] [-o results.csv] [-c reference.csv] [-t tolerance] "
+         "[-p packTolerance] [-i packIntegralTolerance]\n",
+         exe);
+}
+}
+
+int main(int argc, char** argv)
+{
+  Int_t npoints = 1000000, repetitions = 5;
+  Double_t tolerance = 0.1, packTolerance = -1, packIntegralTolerance = 0;
+  const char* outFile = "benchmarkField.csv";
+  const char* refFile = 0;
+  Options options;
+  options.add("-n", &npoints);
+  options.add("-r", &repetitions);
+  options.add("-o", &outFile);
+  options.add("-c", &refFile);
+  options.add("-t", &tolerance);
+  options.add("-p", &packTolerance);
+  options.add("-i", &packIntegralTolerance);
+  if (!options.parse(argc, argv) || npoints < 1 || repetitions < 1) {
+    printUsage(argv[0]);
+    return 2;
+  }
+
+  MagneticField field("Maps", "Maps", -1., -1., MagneticField::k5kG);
+  MagneticWrapperChebyshev* map = field.getMeasuredMap();
+  if (packTolerance >= 0) {
+    map->packParameterizations(packTolerance, packIntegralTolerance);
+  }
+  const Double_t origin[3] = { 0., 0., 0. };
+  TRandom3 rnd(12345);
+
+  // point distributions
+  const int kNRegions = 5;
+  const char* regionNames[kNRegions] = { "tracks", "uniform", "tpc", "dipole", "beamline" };
+  enum { kTracks, kUniform, kTPC, kDipole, kBeamLine };
+  Points_t regions[kNRegions];
+  generateHelicalTracks(rnd, map, field.getBz(origin), npoints, regions[kTracks]);
+  generateCylinder(rnd, map->getMaxRSol() * 0.999, map->getMinZSol(), map->getMaxZSol(), npoints,
+                   regions[kUniform]);
+  generateCylinder(rnd, 250., -250., 250., npoints, regions[kTPC]);
+  generateCylinder(rnd, map->getMaxRSol(), map->getMinZDip(), map->getMaxZDip(), npoints, regions[kDipole]);
+  generateBeamLine(rnd, field.getMachineFieldTable(), npoints, regions[kBeamLine]);
+
+  std::vector<BenchmarkResult> results;
+  Double_t b[3], sum;
+  BenchmarkResult res;
+  res.mCalls = npoints;
+
+  for (int ir = 0; ir < kNRegions; ir++) {
+    const Double_t* p = &regions[ir][0];
+    res.mRegion = regionNames[ir];
+
+    sum = 0;
+    res.mBenchmark = "Field";
+    res.mNsPerCall = timeLoop(npoints, repetitions, [&](int i) {
+      field.Field(p + 3 * i, b);
+      sum += b[0] + b[1] + b[2];
+    });
+    res.mChecksum = sum / repetitions;
+    results.push_back(res);
+
+    if (ir == kBeamLine) {
+      sum = 0;
+      res.mBenchmark = "MachineField";
+      res.mNsPerCall = timeLoop(npoints, repetitions, [&](int i) {
+        field.MachineField(p + 3 * i, b);
+        sum += b[0] + b[1] + b[2];
+      });
+      res.mChecksum = sum / repetitions;
+      results.push_back(res);
+      continue;
+    }
+
+    sum = 0;
+    res.mBenchmark = "getBz";
+    res.mNsPerCall = timeLoop(npoints, repetitions, [&](int i) { sum += field.getBz(p + 3 * i); });
+    res.mChecksum = sum / repetitions;
+    results.push_back(res);
+
+    if (ir == kTPC) {
+      sum = 0;
+      res.mBenchmark = "getTPCIntegral";
+      res.mNsPerCall = timeLoop(npoints, repetitions, [&](int i) {
+        field.getTPCIntegral(p + 3 * i, b);
+        sum += b[0] + b[1] + b[2];
+      });
+      res.mChecksum = sum / repetitions;
+      results.push_back(res);
+    }
+
+    if (ir == kTracks || ir == kUniform) {
+      // raw evaluation of Bz by the parameterization of the Solenoid segment containing each point, the segment
+      // lookup and the mapping to [-1:1] are done beforehand
+      std::vector<const Chebyshev3DCalc*> calcs(npoints);
+      std::vector<Float_t> mapped(3 * npoints);
+      for (int i = 0; i < npoints; i++) {
+        Double_t rphiz[3];
+        MagneticWrapperChebyshev::cartesianToCylindrical(p + 3 * i, rphiz);
+        const Chebyshev3D* par = map->getParameterSolenoid(map->findSolenoidSegment(rphiz));
+        calcs[i] = par->getChebyshevCalc(2);
+        for (int id = 3; id--;) {
+          Float_t bmin = par->getBoundMin(id), bmax = par->getBoundMax(id);
+          Float_t t = 2 * (rphiz[id] - 0.5 * (bmin + bmax)) / (bmax - bmin);
+          mapped[3 * i + id] = TMath::Max(-1.f, TMath::Min(1.f, t));
+        }
+      }
+      sum = 0;
+      res.mBenchmark = "Chebyshev3DCalc::Eval";
+      res.mNsPerCall = timeLoop(npoints, repetitions, [&](int i) { sum += calcs[i]->Eval(&mapped[3 * i]); });
+      res.mChecksum = sum / repetitions;
+      results.push_back(res);
+    }
+  }
+
+  printf("%-24s %-10s %10s %12s %12s\n", "benchmark", "region", "calls", "ns/call", "Mcalls/s");
+  for (size_t i = 0; i < results.size(); i++) {
+    printf("%-24s %-10s %10d %12.1f %12.2f\n", results[i].mBenchmark.c_str(), results[i].mRegion.c_str(),
+           results[i].mCalls, results[i].mNsPerCall, 1e3 / results[i].mNsPerCall);
+  }
+
+  if (outFile && !writeResults(outFile, results)) {
+    printf("Failed to write the results to %s\n", outFile);
+    return 2;
+  }
+
+  if (refFile) {
+    std::vector<BenchmarkResult> reference;
+    if (!readResults(refFile, reference)) {
+      printf("Failed to read the reference results from %s\n", refFile);
+      return 2;
+    }
+    Int_t nSlower = compareResults(results, reference, tolerance);
+    if (nSlower) {
+      printf("%d benchmarks slower than the reference by more than %.0f%%\n", nSlower, tolerance * 100);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+/// \file testChebyshev3DFit.cxx
+/// \brief Test of the multithreaded fit of Chebyshev3D parameterizations
+///
+/// Usage: testChebyshev3DFit [-t nThreads]
+///
+/// Fits one segment of a smooth solenoid-like field with the automatic choice of the grid, once on 1 thread and
+/// once on nThreads threads (default 4), see Chebyshev3D::setNumberOfFitThreads. The grids, the row and column
+/// structure and the coefficients of every output dimension must be identical bit by bit, the exit code is 1
+/// otherwise. Built with -DFIELD_FIT=ON, which compiles the fitting code of Chebyshev3D
+
+#include "Chebyshev3D.h"
+#include "Chebyshev3DCalc.h"
+#include "BenchmarkTools.h"
+
+#include <TMath.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace AliceO2::Field;
+using namespace AliceO2::Benchmark;
+
+namespace {
+/// Smooth field in kGauss of a finite solenoid with a radial component and a dipole-like term, reentrant
+void testField(float* xyz, float* b)
+{
+  float r2 = xyz[0] * xyz[0] + xyz[1] * xyz[1];
+  float zs = xyz[2] / 400.f;
+  float fall = 1.f / (1.f + zs * zs * zs * zs);
+  b[0] = 0.02f * xyz[0] * zs * fall + 0.1f * TMath::Sin(xyz[1] / 150.f);
+  b[1] = 0.02f * xyz[1] * zs * fall - 0.1f * TMath::Cos(xyz[0] / 170.f);
+  b[2] = 5.f * fall * (1.f - 1.e-6f * r2) + 0.05f * TMath::Cos(xyz[2] / 30.f) * TMath::Exp(-r2 / 4.e4f);
+}
+
+/// Compares the parameterizations of all output dimensions bit by bit, returns the number of differing dimensions
+int compareFits(const Chebyshev3D& ref, const Chebyshev3D& fit)
+{
+  int nDiff = 0;
+  for (int id = 0; id < ref.getNumberOfOutputDimensions(); id++) {
+    const Chebyshev3DCalc* cr = ref.getChebyshevCalc(id);
+    const Chebyshev3DCalc* cf = fit.getChebyshevCalc(id);
+    Bool_t same = cr->getNumberOfRows() == cf->getNumberOfRows() &&
+                  cr->getNumberOfColumns() == cf->getNumberOfColumns() &&
+                  cr->getNumberOfCoefficients() == cf->getNumberOfCoefficients() &&
+                  cr->getNumberOfElementsBound2D() == cf->getNumberOfElementsBound2D();
+    same = same && !memcmp(cr->getNumberOfColumnsAtRow(), cf->getNumberOfColumnsAtRow(),
+                           cr->getNumberOfRows() * sizeof(UShort_t));
+    same = same && !memcmp(cr->getCoefficientBound2D0(), cf->getCoefficientBound2D0(),
+                           cr->getNumberOfElementsBound2D() * sizeof(UShort_t));
+    same = same && !memcmp(cr->getCoefficients(), cf->getCoefficients(),
+                           cr->getNumberOfCoefficients() * sizeof(Float_t));
+    printf("Dim%d: %d rows, %d columns, %d coefficients: %s\n", id, cr->getNumberOfRows(), cr->getNumberOfColumns(),
+           cr->getNumberOfCoefficients(), same ? "identical" : "DIFFERENT");
+    if (!same) {
+      nDiff++;
+    }
+  }
+  return nDiff;
+}
+}
+
+int main(int argc, char** argv)
+{
+  Int_t nThreads = 4;
+  Options options;
+  options.add("-t", &nThreads);
+  if (!options.parse(argc, argv) || nThreads < 2) {
+    printf("Usage: %s [-t nThreads], at least 2 threads\n", argv[0]);
+    return 2;
+  }
+
+  Float_t bmin[3] = { -250.f, -250.f, -300.f };
+  Float_t bmax[3] = { 250.f, 250.f, 0.f };
+  const Float_t prec = 1.e-6;
+
+  Chebyshev3D::setNumberOfFitThreads(1);
+  Clock_t::time_point start = Clock_t::now();
+  Chebyshev3D serial(testField, 3, bmin, bmax, prec);
+  Double_t serialMs = elapsedMs(start);
+
+  Chebyshev3D::setNumberOfFitThreads(nThreads);
+  start = Clock_t::now();
+  Chebyshev3D parallel(testField, 3, bmin, bmax, prec);
+  Double_t parallelMs = elapsedMs(start);
+
+  printf("Fit on 1 thread: %.1f ms, on %d threads: %.1f ms\n", serialMs, nThreads, parallelMs);
+  if (compareFits(serial, parallel)) {
+    printf("The parameterizations fitted on 1 and %d threads differ\n", nThreads);
+    return 1;
+  }
+  return 0;
+}
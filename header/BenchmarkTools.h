@@ -0,0 +1,82 @@
+/// \file BenchmarkTools.h
+/// \brief Timer and command line options shared by the benchmark executables
+
+#ifndef ALICEO2_BENCHMARKTOOLS_H_
+#define ALICEO2_BENCHMARKTOOLS_H_
+
+#include "Rtypes.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace AliceO2 {
+namespace Benchmark {
+typedef std::chrono::steady_clock Clock_t;
+
+/// Returns the time in ms elapsed since start
+inline Double_t elapsedMs(Clock_t::time_point start)
+{
+  return std::chrono::duration<Double_t, std::milli>(Clock_t::now() - start).count();
+}
+
+/// Command line options of a benchmark, each given as a flag followed by its value, e.g. "-n 1000"
+class Options {
+public:
+  /// Registers an option, value keeps its default if the flag is not given
+  void add(const char* flag, Int_t* value) { addOption(flag, kInt, value); }
+  void add(const char* flag, Double_t* value) { addOption(flag, kDouble, value); }
+  void add(const char* flag, const char** value) { addOption(flag, kString, value); }
+
+  /// Sets the registered options from the arguments, returns kFALSE on an unknown flag or a missing value
+  Bool_t parse(int argc, char** argv) const
+  {
+    for (int i = 1; i < argc; i++) {
+      const Option* opt = find(argv[i]);
+      if (!opt || i + 1 >= argc) {
+        return kFALSE;
+      }
+      const char* value = argv[++i];
+      if (opt->mType == kInt) {
+        *static_cast<Int_t*>(opt->mValue) = atoi(value);
+      } else if (opt->mType == kDouble) {
+        *static_cast<Double_t*>(opt->mValue) = atof(value);
+      } else {
+        *static_cast<const char**>(opt->mValue) = value;
+      }
+    }
+    return kTRUE;
+  }
+
+private:
+  enum Type { kInt, kDouble, kString };
+
+  struct Option {
+    const char* mFlag; ///< flag preceding the value
+    Type mType;        ///< type of the value
+    void* mValue;      ///< variable set from the value
+  };
+
+  void addOption(const char* flag, Type type, void* value)
+  {
+    Option opt = { flag, type, value };
+    mOptions.push_back(opt);
+  }
+
+  const Option* find(const char* flag) const
+  {
+    for (size_t i = 0; i < mOptions.size(); i++) {
+      if (!strcmp(mOptions[i].mFlag, flag)) {
+        return &mOptions[i];
+      }
+    }
+    return 0;
+  }
+
+  std::vector<Option> mOptions; ///< registered options
+};
+}
+}
+
+#endif
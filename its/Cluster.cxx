@@ -0,0 +1,31 @@
+/// \file Cluster.cxx
+/// \brief Implementation of the ITS Cluster class
+
+#include "Cluster.h"
+
+#include <iostream>
+
+using std::cout;
+using std::endl;
+using namespace AliceO2::ITS;
+
+Cluster::Cluster() : TObject(), mChipIndex(-1), mX(0.), mZ(0.), mNumberOfPixels(0), mCharge(0.), mLabel(-1)
+{
+}
+
+Cluster::Cluster(Int_t chipIndex, Float_t x, Float_t z, Int_t nPixels, Float_t charge, Int_t label)
+  : TObject(), mChipIndex(chipIndex), mX(x), mZ(z), mNumberOfPixels(nPixels), mCharge(charge), mLabel(label)
+{
+}
+
+Cluster::~Cluster()
+{
+}
+
+void Cluster::Print(const Option_t* opt) const
+{
+  cout << "-I- Cluster: chip " << mChipIndex << " local (" << mX << ", " << mZ << ") cm, " << mNumberOfPixels
+       << " pixels, charge " << mCharge << " e, track " << mLabel << endl;
+}
+
+ClassImp(AliceO2::ITS::Cluster)
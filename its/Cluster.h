@@ -0,0 +1,76 @@
+/// \file Cluster.h
+/// \brief Definition of the ITS Cluster class
+
+#ifndef ALICEO2_ITS_CLUSTER_H_
+#define ALICEO2_ITS_CLUSTER_H_
+
+#include "TObject.h"
+
+namespace AliceO2 {
+namespace ITS {
+
+/// Group of adjacent fired pixels of a chip, as produced by the Clusterizer from the Digits
+class Cluster : public TObject {
+
+public:
+  /// Default constructor
+  Cluster();
+
+  /// Class Constructor
+  /// \param chipIndex Index of the chip
+  /// \param x,z Centroid in the sensor local frame [cm]
+  /// \param nPixels Number of pixels
+  /// \param charge Sum of the charge of the pixels [electrons]
+  /// \param label Label of the first pixel, in column then row order
+  Cluster(Int_t chipIndex, Float_t x, Float_t z, Int_t nPixels, Float_t charge, Int_t label);
+
+  /// Default destructor
+  virtual ~Cluster();
+
+  Int_t getChipIndex() const
+  {
+    return mChipIndex;
+  }
+
+  Float_t getX() const
+  {
+    return mX;
+  }
+
+  Float_t getZ() const
+  {
+    return mZ;
+  }
+
+  Int_t getNumberOfPixels() const
+  {
+    return mNumberOfPixels;
+  }
+
+  Float_t getCharge() const
+  {
+    return mCharge;
+  }
+
+  Int_t getLabel() const
+  {
+    return mLabel;
+  }
+
+  /// Output to screen
+  virtual void Print(const Option_t* opt) const;
+
+private:
+  Int_t mChipIndex;      ///< index of the chip
+  Float_t mX;            ///< local x of the centroid [cm]
+  Float_t mZ;            ///< local z of the centroid [cm]
+  Int_t mNumberOfPixels; ///< number of pixels
+  Float_t mCharge;       ///< sum of the charge of the pixels [electrons]
+  Int_t mLabel;          ///< MCTrack index of the first pixel
+
+  ClassDef(Cluster, 1)
+};
+}
+}
+
+#endif
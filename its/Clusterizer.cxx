@@ -0,0 +1,341 @@
+/// \file Clusterizer.cxx
+/// \brief Implementation of the ITS pixel Clusterizer class
+
+#include "Clusterizer.h"
+#include "Cluster.h"
+#include "Digit.h"
+#include "UpgradeGeometryTGeo.h"
+#include "UpgradeSegmentationPixel.h"
+
+#include "FairLogger.h"
+
+#include "TClonesArray.h"
+#include "TMath.h"
+
+#include <mutex>
+#include <thread>
+
+using namespace AliceO2::ITS;
+
+namespace {
+const Int_t kBitsPerWord = 64;
+
+/// Calls fun(i, thread) for i in [0:n) on nThreads threads. Each thread starts with a contiguous block of
+/// indices and, once it is exhausted, steals the upper half of the indices left to another thread
+template <typename F>
+void runWorkStealing(int nThreads, int n, F fun)
+{
+  if (nThreads < 2 || n < 2) {
+    for (int i = 0; i < n; i++) {
+      fun(i, 0);
+    }
+    return;
+  }
+  if (nThreads > n) {
+    nThreads = n;
+  }
+  struct Queue {
+    std::mutex mLock;
+    int mFirst;
+    int mLast;
+  };
+  std::vector<Queue> queues(nThreads);
+  for (int ith = 0; ith < nThreads; ith++) {
+    queues[ith].mFirst = Long64_t(n) * ith / nThreads;
+    queues[ith].mLast = Long64_t(n) * (ith + 1) / nThreads;
+  }
+
+  auto work = [&](int ith) {
+    Queue& own = queues[ith];
+    while (true) {
+      int i = -1;
+      {
+        std::lock_guard<std::mutex> lock(own.mLock);
+        if (own.mFirst < own.mLast) {
+          i = own.mFirst++;
+        }
+      }
+      if (i >= 0) {
+        fun(i, ith);
+        continue;
+      }
+      // own queue is empty, look for a victim
+      bool stolen = false;
+      for (int iv = 1; iv < nThreads && !stolen; iv++) {
+        Queue& victim = queues[(ith + iv) % nThreads];
+        int first, last;
+        {
+          std::lock_guard<std::mutex> lock(victim.mLock);
+          int left = victim.mLast - victim.mFirst;
+          if (left < 1) {
+            continue;
+          }
+          last = victim.mLast;
+          first = victim.mLast = victim.mLast - (left + 1) / 2;
+        }
+        std::lock_guard<std::mutex> lock(own.mLock);
+        own.mFirst = first;
+        own.mLast = last;
+        stolen = true;
+      }
+      if (!stolen) {
+        return; // work is only moved between queues, none can appear anymore
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int ith = 1; ith < nThreads; ith++) {
+    workers.push_back(std::thread(work, ith));
+  }
+  work(0);
+  for (size_t ith = 0; ith < workers.size(); ith++) {
+    workers[ith].join();
+  }
+}
+}
+
+Clusterizer::Clusterizer()
+  : mChipSegmentation(),
+    mNumberOfThreads(1),
+    mWordsPerColumn(0),
+    mMaximumNumberOfColumns(0),
+    mHitChips(),
+    mHitChipFirstDigit(),
+    mChipOutputs(),
+    mWorkspaces()
+{
+}
+
+Clusterizer::~Clusterizer()
+{
+}
+
+void Clusterizer::init(UpgradeGeometryTGeo* geometry)
+{
+  Int_t nChips = geometry->getNumberOfChips();
+  mChipSegmentation.assign(nChips, 0);
+  for (Int_t ic = 0; ic < nChips; ic++) {
+    const UpgradeSegmentationPixel* seg =
+      dynamic_cast<const UpgradeSegmentationPixel*>(geometry->getSegmentation(geometry->getLayer(ic)));
+    if (!seg) {
+      LOG(FATAL) << "No pixel segmentation for chip " << ic << FairLogger::endl;
+    }
+    mChipSegmentation[ic] = seg;
+  }
+  initBuffers();
+}
+
+void Clusterizer::init(const UpgradeSegmentationPixel* segmentation, Int_t nChips)
+{
+  mChipSegmentation.assign(nChips, segmentation);
+  initBuffers();
+}
+
+void Clusterizer::initBuffers()
+{
+  Int_t maxRows = 0;
+  mMaximumNumberOfColumns = 0;
+  for (size_t ic = 0; ic < mChipSegmentation.size(); ic++) {
+    maxRows = TMath::Max(maxRows, mChipSegmentation[ic]->getNumberOfRows());
+    mMaximumNumberOfColumns = TMath::Max(mMaximumNumberOfColumns, mChipSegmentation[ic]->getNumberOfColumns());
+  }
+  mWordsPerColumn = (maxRows + kBitsPerWord - 1) / kBitsPerWord;
+  // the bitmasks are sized by the workspaces at their first use
+  mWorkspaces.clear();
+}
+
+void Clusterizer::process(const TClonesArray* digits, TClonesArray* clusters)
+{
+  clusters->Clear();
+  Int_t nChips = mChipSegmentation.size();
+  Int_t nDigits = digits->GetEntriesFast();
+
+  // find the range of Digits of each chip
+  mHitChips.clear();
+  mHitChipFirstDigit.clear();
+  Int_t lastChip = -1;
+  for (Int_t id = 0; id < nDigits; id++) {
+    Int_t chip = ((const Digit*)digits->UncheckedAt(id))->getChipIndex();
+    if (chip == lastChip) {
+      continue;
+    }
+    if (chip < lastChip || chip < 0 || chip >= nChips) {
+      LOG(FATAL) << "Digit " << id << " of chip " << chip << " is out of chip order or range" << FairLogger::endl;
+    }
+    mHitChips.push_back(chip);
+    mHitChipFirstDigit.push_back(id);
+    lastChip = chip;
+  }
+  mHitChipFirstDigit.push_back(nDigits);
+
+  Int_t nHitChips = mHitChips.size();
+  Int_t nThreads = TMath::Max(1, TMath::Min(mNumberOfThreads, nHitChips));
+  if (Int_t(mWorkspaces.size()) < nThreads) {
+    mWorkspaces.resize(nThreads);
+  }
+  for (Int_t ith = 0; ith < nThreads; ith++) {
+    mWorkspaces[ith].mOutputSums.clear();
+  }
+  mChipOutputs.resize(nHitChips);
+  runWorkStealing(nThreads, nHitChips, [&](int k, int ith) {
+    Workspace& ws = mWorkspaces[ith];
+    ChipOutput& out = mChipOutputs[k];
+    out.mWorkspace = ith;
+    out.mFirst = ws.mOutputSums.size();
+    processChip(mHitChips[k], digits, mHitChipFirstDigit[k], mHitChipFirstDigit[k + 1], ws);
+    out.mLast = ws.mOutputSums.size();
+  });
+
+  // collect the clusters in chip order
+  TClonesArray& clusterArray = *clusters;
+  Int_t nClusters = 0;
+  for (Int_t k = 0; k < nHitChips; k++) {
+    const ChipOutput& out = mChipOutputs[k];
+    const std::vector<ClusterSums>& sums = mWorkspaces[out.mWorkspace].mOutputSums;
+    for (Int_t i = out.mFirst; i < out.mLast; i++) {
+      const ClusterSums& cl = sums[i];
+      new (clusterArray[nClusters++]) Cluster(mHitChips[k], cl.mSumX / cl.mNumberOfPixels,
+                                              cl.mSumZ / cl.mNumberOfPixels, cl.mNumberOfPixels, cl.mCharge, cl.mLabel);
+    }
+  }
+}
+
+void Clusterizer::processChip(Int_t chipIndex, const TClonesArray* digits, Int_t first, Int_t last,
+                              Workspace& ws) const
+{
+  const UpgradeSegmentationPixel* seg = mChipSegmentation[chipIndex];
+  if (ws.mColumnBits.empty()) {
+    ws.mColumnBits.assign(size_t(mWordsPerColumn) * mMaximumNumberOfColumns, 0);
+  }
+
+  // set the bits of the fired pixels, the Digits coming by increasing column
+  ws.mColumns.clear();
+  for (Int_t id = first; id < last; id++) {
+    const Digit* digit = (const Digit*)digits->UncheckedAt(id);
+    Int_t col = digit->getColumn(), row = digit->getRow();
+    if (ws.mColumns.empty() || ws.mColumns.back() != col) {
+      ws.mColumns.push_back(col);
+    }
+    ws.mColumnBits[size_t(col) * mWordsPerColumn + row / kBitsPerWord] |= 1ULL << (row % kBitsPerWord);
+  }
+
+  // extract the runs of each column and clear its bits
+  ws.mRuns.clear();
+  ws.mColumnFirstRun.clear();
+  for (size_t ic = 0; ic < ws.mColumns.size(); ic++) {
+    ws.mColumnFirstRun.push_back(ws.mRuns.size());
+    ULong64_t* bits = &ws.mColumnBits[size_t(ws.mColumns[ic]) * mWordsPerColumn];
+    extractRuns(bits, mWordsPerColumn, ws.mColumns[ic], ws.mRuns);
+    for (Int_t iw = mWordsPerColumn; iw--;) {
+      bits[iw] = 0;
+    }
+  }
+  ws.mColumnFirstRun.push_back(ws.mRuns.size());
+
+  // merge the runs of adjacent columns touching by a side or a corner, the runs of a column being ordered
+  for (size_t ic = 1; ic < ws.mColumns.size(); ic++) {
+    if (ws.mColumns[ic] != ws.mColumns[ic - 1] + 1) {
+      continue;
+    }
+    Int_t ip = ws.mColumnFirstRun[ic - 1], ipEnd = ws.mColumnFirstRun[ic];
+    Int_t ir = ws.mColumnFirstRun[ic], irEnd = ws.mColumnFirstRun[ic + 1];
+    while (ip < ipEnd && ir < irEnd) {
+      const PixelRun& prev = ws.mRuns[ip];
+      const PixelRun& cur = ws.mRuns[ir];
+      if (prev.mLastRow + 1 < cur.mFirstRow) {
+        ip++;
+      } else if (cur.mLastRow + 1 < prev.mFirstRow) {
+        ir++;
+      } else {
+        Int_t rootPrev = findRoot(ws.mRuns, ip), rootCur = findRoot(ws.mRuns, ir);
+        if (rootPrev < rootCur) {
+          ws.mRuns[rootCur].mParent = rootPrev;
+        } else if (rootCur < rootPrev) {
+          ws.mRuns[rootPrev].mParent = rootCur;
+        }
+        // advance the run ending first, the other may touch the next one
+        if (prev.mLastRow < cur.mLastRow) {
+          ip++;
+        } else {
+          ir++;
+        }
+      }
+    }
+  }
+
+  // accumulate the pixels of each cluster, the Digits being in the order of the runs
+  Int_t nRuns = ws.mRuns.size();
+  ws.mRunCluster.resize(nRuns);
+  Int_t id = first;
+  for (Int_t ir = 0; ir < nRuns; ir++) {
+    const PixelRun& run = ws.mRuns[ir];
+    Int_t root = findRoot(ws.mRuns, ir);
+    if (root == ir) {
+      ClusterSums sums = { 0, 0., 0., 0., -1 };
+      ws.mRunCluster[ir] = ws.mOutputSums.size();
+      ws.mOutputSums.push_back(sums);
+    }
+    ClusterSums& sums = ws.mOutputSums[ws.mRunCluster[root]];
+    // the pixel centres of a run differ only in x
+    Float_t x0, z0, x1, z1;
+    seg->detectorToLocal(run.mFirstRow, run.mColumn, x0, z0);
+    seg->detectorToLocal(run.mLastRow, run.mColumn, x1, z1);
+    Int_t n = run.mLastRow - run.mFirstRow + 1;
+    sums.mNumberOfPixels += n;
+    sums.mSumX += 0.5 * (x0 + x1) * n;
+    sums.mSumZ += z0 * n;
+    for (Int_t ip = 0; ip < n && id < last; ip++, id++) {
+      const Digit* digit = (const Digit*)digits->UncheckedAt(id);
+      sums.mCharge += digit->getCharge();
+      if (sums.mLabel < 0) {
+        sums.mLabel = digit->getLabel();
+      }
+    }
+  }
+  if (id != last) {
+    LOG(ERROR) << "Chip " << chipIndex << ": " << last - id << " Digits are duplicated or out of order"
+               << FairLogger::endl;
+  }
+}
+
+void Clusterizer::extractRuns(const ULong64_t* bits, Int_t nWords, Int_t column, std::vector<PixelRun>& runs)
+{
+  Int_t runStart = -1;
+  for (Int_t iw = 0; iw < nWords; iw++) {
+    ULong64_t word = bits[iw];
+    Int_t bit = 0;
+    while (bit < kBitsPerWord) {
+      if (runStart < 0) {
+        ULong64_t rest = word >> bit;
+        if (!rest) {
+          break;
+        }
+        bit += __builtin_ctzll(rest);
+        runStart = iw * kBitsPerWord + bit;
+      }
+      // the run ends at the first cleared bit, or continues in the next word
+      ULong64_t rest = ~word >> bit;
+      if (!rest) {
+        break;
+      }
+      bit += __builtin_ctzll(rest);
+      PixelRun run = { column, runStart, iw * kBitsPerWord + bit - 1, Int_t(runs.size()) };
+      runs.push_back(run);
+      runStart = -1;
+    }
+  }
+  if (runStart >= 0) {
+    PixelRun run = { column, runStart, nWords * kBitsPerWord - 1, Int_t(runs.size()) };
+    runs.push_back(run);
+  }
+}
+
+Int_t Clusterizer::findRoot(std::vector<PixelRun>& runs, Int_t i)
+{
+  while (runs[i].mParent != i) {
+    runs[i].mParent = runs[runs[i].mParent].mParent;
+    i = runs[i].mParent;
+  }
+  return i;
+}
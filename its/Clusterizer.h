@@ -0,0 +1,121 @@
+/// \file Clusterizer.h
+/// \brief Definition of the ITS pixel Clusterizer class
+
+#ifndef ALICEO2_ITS_CLUSTERIZER_H_
+#define ALICEO2_ITS_CLUSTERIZER_H_
+
+#include "Rtypes.h"
+
+#include <vector>
+
+class TClonesArray;
+
+namespace AliceO2 {
+namespace ITS {
+
+class UpgradeGeometryTGeo;
+class UpgradeSegmentationPixel;
+
+/// Groups the fired pixels (Digits) of each chip into Clusters of pixels touching by a side or a corner.
+/// The pixels of a chip are stored as one bitmask per column, from which the runs of consecutive fired rows
+/// are extracted word by word. Runs of adjacent columns overlapping by at least a corner are merged with a
+/// union-find, and the centroid of each cluster is the mean of the pixel centres given by
+/// UpgradeSegmentationPixel::detectorToLocal.
+/// The chips are processed concurrently: each thread starts with a contiguous block of chips and, when done,
+/// steals half of the chips left to another thread. All buffers are kept between events
+class Clusterizer {
+
+public:
+  /// Default constructor
+  Clusterizer();
+
+  /// Default destructor
+  ~Clusterizer();
+
+  /// Fetches the segmentation of each chip, the geometry must be built with its segmentations
+  void init(UpgradeGeometryTGeo* geometry);
+
+  /// Uses the same segmentation for nChips chips, the segmentation is not owned
+  void init(const UpgradeSegmentationPixel* segmentation, Int_t nChips);
+
+  /// Clusterizes the Digits of an event
+  /// \param digits Array of AliceO2::ITS::Digit ordered by chip index, then by column and row, without duplicated
+  /// pixels, as filled by the Digitizer
+  /// \param clusters Array of AliceO2::ITS::Cluster, cleared and filled ordered by chip index
+  void process(const TClonesArray* digits, TClonesArray* clusters);
+
+  /// Set the number of threads processing the chips
+  void setNumberOfThreads(Int_t n)
+  {
+    mNumberOfThreads = n < 1 ? 1 : n;
+  }
+
+  Int_t getNumberOfThreads() const
+  {
+    return mNumberOfThreads;
+  }
+
+private:
+  Clusterizer(const Clusterizer&);
+  Clusterizer& operator=(const Clusterizer&);
+
+  /// Consecutive fired rows of a column
+  struct PixelRun {
+    Int_t mColumn;
+    Int_t mFirstRow;
+    Int_t mLastRow;
+    Int_t mParent; ///< union-find parent, the run itself for a root
+  };
+
+  /// Cluster being accumulated
+  struct ClusterSums {
+    Int_t mNumberOfPixels;
+    Double_t mSumX;
+    Double_t mSumZ;
+    Float_t mCharge;
+    Int_t mLabel;
+  };
+
+  /// Buffers of a thread, the bitmasks being sized for the largest pixel matrix
+  struct Workspace {
+    std::vector<ULong64_t> mColumnBits;   ///< fired rows, mWordsPerColumn words per column
+    std::vector<Int_t> mColumns;          ///< columns having fired pixels, increasing
+    std::vector<Int_t> mColumnFirstRun;   ///< index of the first run of each column of mColumns, size +1
+    std::vector<PixelRun> mRuns;          ///< runs of the chip being processed
+    std::vector<Int_t> mRunCluster;       ///< cluster of each root run
+    std::vector<ClusterSums> mOutputSums; ///< clusters of all chips processed by the thread
+  };
+
+  /// Output of a chip: workspace and range in its mOutputSums
+  struct ChipOutput {
+    Int_t mWorkspace;
+    Int_t mFirst;
+    Int_t mLast;
+  };
+
+  /// Sets the buffers depending on the segmentations
+  void initBuffers();
+
+  /// Clusterizes the Digits [first, last) of one chip into a workspace
+  void processChip(Int_t chipIndex, const TClonesArray* digits, Int_t first, Int_t last, Workspace& ws) const;
+
+  /// Extracts the runs of consecutive set bits of a column bitmask
+  static void extractRuns(const ULong64_t* bits, Int_t nWords, Int_t column, std::vector<PixelRun>& runs);
+
+  /// Root of a run, with path halving
+  static Int_t findRoot(std::vector<PixelRun>& runs, Int_t i);
+
+  std::vector<const UpgradeSegmentationPixel*> mChipSegmentation; ///< segmentation of each chip
+  Int_t mNumberOfThreads;                                         ///< number of threads processing the chips
+  Int_t mWordsPerColumn;                                          ///< bitmask words per column, for the most rows
+  Int_t mMaximumNumberOfColumns;                                  ///< largest number of columns
+
+  std::vector<Int_t> mHitChips;          ///< chips having Digits, increasing
+  std::vector<Int_t> mHitChipFirstDigit; ///< first Digit of each chip of mHitChips, size +1
+  std::vector<ChipOutput> mChipOutputs;  ///< output of each chip of mHitChips
+  std::vector<Workspace> mWorkspaces;    ///< buffers of each thread
+};
+}
+}
+
+#endif
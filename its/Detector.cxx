@@ -296,7 +296,7 @@ Bool_t Detector::ProcessHits(FairVolume* vol)
 
   // Record information on the points
   mEnergyLoss = gMC->Edep();
-  mTime = gMC->TrackTime();
+  mTime = gMC->TrackTime() * 1.0e09; // the Points store the time in ns
   mTrackNumberID = gMC->GetStack()->GetCurrentTrackNumber();
   mVolumeID = vol->getMCid();
 
@@ -315,7 +315,8 @@ Bool_t Detector::ProcessHits(FairVolume* vol)
   }
 
   // Create Point on every step of the active volume
-  addHit(mTrackNumberID, mVolumeID,
+  // the chip index is used as detector ID, it allows the digitization to group the points by chip
+  addHit(mTrackNumberID, mod,
          TVector3(mEntrancePosition.X(), mEntrancePosition.Y(), mEntrancePosition.Z()),
          TVector3(mPosition.X(), mPosition.Y(), mPosition.Z()),
          TVector3(mMomentum.Px(), mMomentum.Py(), mMomentum.Pz()), mEntranceTime, mTime, mLength,
@@ -254,8 +254,8 @@ private:
   TLorentzVector mPosition;         //! position
   TLorentzVector mEntrancePosition; //! position at entrance
   TLorentzVector mMomentum;         //! momentum
-  Double32_t mEntranceTime;         //! time at entrance
-  Double32_t mTime;                 //! time
+  Double32_t mEntranceTime;         //! time at entrance [ns]
+  Double32_t mTime;                 //! time [ns]
   Double32_t mLength;               //! length
   Double32_t mEnergyLoss;           //! energy loss
 
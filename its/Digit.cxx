@@ -0,0 +1,31 @@
+/// \file Digit.cxx
+/// \brief Implementation of the ITS Digit class
+
+#include "Digit.h"
+
+#include <iostream>
+
+using std::cout;
+using std::endl;
+using namespace AliceO2::ITS;
+
+Digit::Digit() : TObject(), mChipIndex(-1), mRow(-1), mColumn(-1), mCharge(0.), mLabel(-1)
+{
+}
+
+Digit::Digit(Int_t chipIndex, Int_t row, Int_t column, Float_t charge, Int_t label)
+  : TObject(), mChipIndex(chipIndex), mRow(row), mColumn(column), mCharge(charge), mLabel(label)
+{
+}
+
+Digit::~Digit()
+{
+}
+
+void Digit::Print(const Option_t* opt) const
+{
+  cout << "-I- Digit: chip " << mChipIndex << " row " << mRow << " column " << mColumn << " charge " << mCharge
+       << " e, track " << mLabel << endl;
+}
+
+ClassImp(AliceO2::ITS::Digit)
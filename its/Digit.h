@@ -0,0 +1,70 @@
+/// \file Digit.h
+/// \brief Definition of the ITS Digit class
+
+#ifndef ALICEO2_ITS_DIGIT_H_
+#define ALICEO2_ITS_DIGIT_H_
+
+#include "TObject.h"
+
+namespace AliceO2 {
+namespace ITS {
+
+/// Fired pixel of a chip, as produced by the Digitizer from the Points of an event
+class Digit : public TObject {
+
+public:
+  /// Default constructor
+  Digit();
+
+  /// Class Constructor
+  /// \param chipIndex Index of the chip
+  /// \param row Pixel row (detector x cell coordinate)
+  /// \param column Pixel column (detector z cell coordinate)
+  /// \param charge Collected charge [electrons]
+  /// \param label Index of the MCTrack of the first Point contributing to the pixel
+  Digit(Int_t chipIndex, Int_t row, Int_t column, Float_t charge, Int_t label);
+
+  /// Default destructor
+  virtual ~Digit();
+
+  Int_t getChipIndex() const
+  {
+    return mChipIndex;
+  }
+
+  Int_t getRow() const
+  {
+    return mRow;
+  }
+
+  Int_t getColumn() const
+  {
+    return mColumn;
+  }
+
+  Float_t getCharge() const
+  {
+    return mCharge;
+  }
+
+  Int_t getLabel() const
+  {
+    return mLabel;
+  }
+
+  /// Output to screen
+  virtual void Print(const Option_t* opt) const;
+
+private:
+  Int_t mChipIndex; ///< index of the chip
+  Int_t mRow;       ///< pixel row
+  Int_t mColumn;    ///< pixel column
+  Float_t mCharge;  ///< collected charge [electrons]
+  Int_t mLabel;     ///< MCTrack index of the first contributing Point
+
+  ClassDef(Digit, 1)
+};
+}
+}
+
+#endif
@@ -0,0 +1,250 @@
+/// \file Digitizer.cxx
+/// \brief Implementation of the ITS pixel Digitizer class
+
+#include "Digitizer.h"
+#include "Digit.h"
+#include "Point.h"
+#include "UpgradeGeometryTGeo.h"
+#include "UpgradeSegmentationPixel.h"
+
+#include "FairLogger.h"
+
+#include "TClonesArray.h"
+#include "TMath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace AliceO2::ITS;
+
+namespace {
+const Double_t kIonisationEnergy = 3.6e-9; ///< energy per electron-hole pair in silicon [GeV]
+const Int_t kMaximumNumberOfSteps = 200;   ///< bound on the sampling steps of a Point
+}
+
+Digitizer::Digitizer()
+  : mGeometry(0),
+    mChipSegmentation(),
+    mMinimumPitch(0.),
+    mThreshold(150.),
+    mChargeSharingWidth(0.2),
+    mStepFraction(0.5),
+    mNumberOfThreads(1),
+    mMaximumNumberOfPixels(0),
+    mChipFirstPoint(),
+    mPointOrder(),
+    mHitChips(),
+    mChipOutputs(),
+    mWorkspaces()
+{
+}
+
+Digitizer::~Digitizer()
+{
+}
+
+void Digitizer::init(UpgradeGeometryTGeo* geometry)
+{
+  mGeometry = geometry;
+  Int_t nChips = geometry->getNumberOfChips();
+  mChipSegmentation.assign(nChips, 0);
+  mMinimumPitch = 0.;
+  mMaximumNumberOfPixels = 0;
+  for (Int_t ic = 0; ic < nChips; ic++) {
+    const UpgradeSegmentationPixel* seg =
+      dynamic_cast<const UpgradeSegmentationPixel*>(geometry->getSegmentation(geometry->getLayer(ic)));
+    if (!seg) {
+      LOG(FATAL) << "No pixel segmentation for chip " << ic << FairLogger::endl;
+    }
+    mChipSegmentation[ic] = seg;
+    mMaximumNumberOfPixels = TMath::Max(mMaximumNumberOfPixels, seg->getNumberOfPads());
+    Float_t pitch = TMath::Min(seg->cellSizeX(), seg->cellSizeZ(0));
+    if (mMinimumPitch <= 0. || pitch < mMinimumPitch) {
+      mMinimumPitch = pitch;
+    }
+  }
+  // the sensor transforms are filled on first use, which must not happen concurrently in the threads of process
+  if (nChips > 0) {
+    geometry->getSensorTransform(0);
+  }
+  mChipFirstPoint.assign(nChips + 1, 0);
+  LOG(INFO) << "ITS Digitizer: " << nChips << " chips, largest matrix of " << mMaximumNumberOfPixels << " pixels"
+            << FairLogger::endl;
+}
+
+void Digitizer::process(const TClonesArray* points, TClonesArray* digits)
+{
+  if (!mGeometry) {
+    LOG(FATAL) << "ITS Digitizer is not initialized" << FairLogger::endl;
+  }
+  digits->Clear();
+  Int_t nChips = mChipSegmentation.size();
+  Int_t nPoints = points->GetEntriesFast();
+
+  // group the Points by chip with a counting sort
+  std::fill(mChipFirstPoint.begin(), mChipFirstPoint.end(), 0);
+  for (Int_t ip = 0; ip < nPoints; ip++) {
+    Int_t chip = ((const Point*)points->UncheckedAt(ip))->GetDetectorID();
+    if (chip < 0 || chip >= nChips) {
+      LOG(ERROR) << "Point " << ip << " has invalid chip index " << chip << FairLogger::endl;
+      continue;
+    }
+    mChipFirstPoint[chip + 1]++;
+  }
+  mHitChips.clear();
+  for (Int_t ic = 0; ic < nChips; ic++) {
+    if (mChipFirstPoint[ic + 1]) {
+      mHitChips.push_back(ic);
+    }
+    mChipFirstPoint[ic + 1] += mChipFirstPoint[ic];
+  }
+  mPointOrder.resize(mChipFirstPoint[nChips]);
+  for (Int_t ip = 0; ip < nPoints; ip++) {
+    Int_t chip = ((const Point*)points->UncheckedAt(ip))->GetDetectorID();
+    if (chip >= 0 && chip < nChips) {
+      mPointOrder[mChipFirstPoint[chip]++] = ip;
+    }
+  }
+  // the insertion moved each start to the start of the next chip
+  for (Int_t ic = nChips; ic > 0; ic--) {
+    mChipFirstPoint[ic] = mChipFirstPoint[ic - 1];
+  }
+  mChipFirstPoint[0] = 0;
+
+  // the chips are handed out one by one, their number of Points being very uneven
+  Int_t nHitChips = mHitChips.size();
+  Int_t nThreads = TMath::Max(1, TMath::Min(mNumberOfThreads, nHitChips));
+  if (Int_t(mWorkspaces.size()) < nThreads) {
+    mWorkspaces.resize(nThreads);
+  }
+  mChipOutputs.resize(nHitChips);
+  std::atomic<Int_t> nextChip(0);
+  auto work = [&](Int_t iws) {
+    Workspace& ws = mWorkspaces[iws];
+    if (Int_t(ws.mCharge.size()) < mMaximumNumberOfPixels) {
+      ws.mCharge.assign(mMaximumNumberOfPixels, 0.);
+      ws.mLabel.assign(mMaximumNumberOfPixels, -1);
+    }
+    ws.mFiredPixels.clear();
+    for (Int_t k; (k = nextChip++) < nHitChips;) {
+      ChipOutput& out = mChipOutputs[k];
+      out.mWorkspace = iws;
+      out.mFirst = ws.mFiredPixels.size();
+      processChip(mHitChips[k], points, ws);
+      out.mLast = ws.mFiredPixels.size();
+    }
+  };
+  if (nThreads < 2) {
+    work(0);
+  } else {
+    std::vector<std::thread> workers;
+    for (Int_t ith = 0; ith < nThreads; ith++) {
+      workers.push_back(std::thread(work, ith));
+    }
+    for (size_t ith = 0; ith < workers.size(); ith++) {
+      workers[ith].join();
+    }
+  }
+
+  // collect the fired pixels in chip order
+  TClonesArray& digitArray = *digits;
+  Int_t nDigits = 0;
+  for (Int_t k = 0; k < nHitChips; k++) {
+    const ChipOutput& out = mChipOutputs[k];
+    const std::vector<FiredPixel>& fired = mWorkspaces[out.mWorkspace].mFiredPixels;
+    for (Int_t i = out.mFirst; i < out.mLast; i++) {
+      const FiredPixel& pix = fired[i];
+      new (digitArray[nDigits++]) Digit(pix.mChipIndex, pix.mRow, pix.mColumn, pix.mCharge, pix.mLabel);
+    }
+  }
+}
+
+void Digitizer::processChip(Int_t chipIndex, const TClonesArray* points, Workspace& ws) const
+{
+  const UpgradeSegmentationPixel* seg = mChipSegmentation[chipIndex];
+  Double_t step = mStepFraction * mMinimumPitch;
+  ws.mTouchedPixels.clear();
+
+  for (Int_t i = mChipFirstPoint[chipIndex]; i < mChipFirstPoint[chipIndex + 1]; i++) {
+    const Point* point = (const Point*)points->UncheckedAt(mPointOrder[i]);
+    Double_t glo[3] = { point->getStartX(), point->getStartY(), point->getStartZ() };
+    Double_t entry[3], exit[3];
+    mGeometry->globalToLocal(chipIndex, glo, entry);
+    glo[0] = point->GetX();
+    glo[1] = point->GetY();
+    glo[2] = point->GetZ();
+    mGeometry->globalToLocal(chipIndex, glo, exit);
+
+    Double_t dx = exit[0] - entry[0], dz = exit[2] - entry[2];
+    Int_t nSteps = 1 + Int_t(TMath::Sqrt(dx * dx + dz * dz) / step);
+    if (nSteps > kMaximumNumberOfSteps) {
+      nSteps = kMaximumNumberOfSteps;
+    }
+    Float_t stepCharge = point->GetEnergyLoss() / kIonisationEnergy / nSteps;
+    Int_t label = point->GetTrackID();
+
+    for (Int_t is = 0; is < nSteps; is++) {
+      Double_t t = (is + 0.5) / nSteps;
+      Float_t x = entry[0] + t * dx, z = entry[2] + t * dz;
+      Int_t ix, iz;
+      if (!seg->localToDetector(x, z, ix, iz) || ix >= seg->getNumberOfRows() || iz >= seg->getNumberOfColumns()) {
+        continue;
+      }
+      // position with respect to the collection diode, in pitch units
+      Double_t xl, xu, zl, zu;
+      seg->cellBoundries(ix, iz, xl, xu, zl, zu);
+      Float_t shiftX, shiftZ;
+      seg->getDiodShift(ix, iz, shiftX, shiftZ);
+      Double_t ux = (x - 0.5 * (xl + xu)) / (xu - xl) - shiftX;
+      Double_t uz = (z - 0.5 * (zl + zu)) / (zu - zl) - shiftZ;
+      Float_t fx = getSharedFraction(ux), fz = getSharedFraction(uz);
+      Int_t nx = ux > 0 ? ix + 1 : ix - 1, nz = uz > 0 ? iz + 1 : iz - 1;
+
+      addCharge(seg, ix, iz, stepCharge * (1 - fx) * (1 - fz), label, ws);
+      if (fx > 0) {
+        addCharge(seg, nx, iz, stepCharge * fx * (1 - fz), label, ws);
+      }
+      if (fz > 0) {
+        addCharge(seg, ix, nz, stepCharge * (1 - fx) * fz, label, ws);
+        if (fx > 0) {
+          addCharge(seg, nx, nz, stepCharge * fx * fz, label, ws);
+        }
+      }
+    }
+  }
+
+  // pixel index is column * rows + row, the sort orders the output by column and row
+  std::sort(ws.mTouchedPixels.begin(), ws.mTouchedPixels.end());
+  Int_t nRows = seg->getNumberOfRows();
+  for (size_t i = 0; i < ws.mTouchedPixels.size(); i++) {
+    Int_t pix = ws.mTouchedPixels[i];
+    if (ws.mCharge[pix] >= mThreshold) {
+      FiredPixel fired = { chipIndex, pix % nRows, pix / nRows, ws.mCharge[pix], ws.mLabel[pix] };
+      ws.mFiredPixels.push_back(fired);
+    }
+    ws.mCharge[pix] = 0.;
+    ws.mLabel[pix] = -1;
+  }
+}
+
+void Digitizer::addCharge(const UpgradeSegmentationPixel* seg, Int_t ix, Int_t iz, Float_t charge, Int_t label,
+                          Workspace& ws)
+{
+  if (charge <= 0 || ix < 0 || ix >= seg->getNumberOfRows() || iz < 0 || iz >= seg->getNumberOfColumns()) {
+    return;
+  }
+  Int_t pix = iz * seg->getNumberOfRows() + ix;
+  if (ws.mCharge[pix] == 0) {
+    ws.mTouchedPixels.push_back(pix);
+    ws.mLabel[pix] = label;
+  }
+  ws.mCharge[pix] += charge;
+}
+
+Float_t Digitizer::getSharedFraction(Double_t u) const
+{
+  // linear rise from 0 at the inner edge of the sharing band to 1/2 half way between two diodes
+  Double_t f = (TMath::Abs(u) - 0.5 + mChargeSharingWidth) / mChargeSharingWidth;
+  return f <= 0 ? 0. : (f >= 1 ? 0.5 : 0.5 * f);
+}
@@ -0,0 +1,138 @@
+/// \file Digitizer.h
+/// \brief Definition of the ITS pixel Digitizer class
+
+#ifndef ALICEO2_ITS_DIGITIZER_H_
+#define ALICEO2_ITS_DIGITIZER_H_
+
+#include "Rtypes.h"
+
+#include <vector>
+
+class TClonesArray;
+
+namespace AliceO2 {
+namespace ITS {
+
+class UpgradeGeometryTGeo;
+class UpgradeSegmentationPixel;
+
+/// Converts the Points of an event into fired pixels (Digits) of each chip.
+/// The Points, whose detector ID is the chip index, are grouped by chip and the chips are digitized
+/// concurrently, each thread pulling the next chip to process. For each Point the segment between the
+/// entrance and exit positions, transformed to the sensor local frame with UpgradeGeometryTGeo::globalToLocal,
+/// is sampled in steps shorter than the pixel pitch and the charge of each step is shared between the
+/// pixel containing it (UpgradeSegmentationPixel::localToDetector) and its neighbours, depending on the
+/// distance of the step to the collection diode, given by the cell boundaries and the diode shift matrix.
+/// Pixels collecting at least the threshold charge are output.
+/// All buffers are kept between events, so that no allocation happens once they reached the event size
+class Digitizer {
+
+public:
+  /// Default constructor
+  Digitizer();
+
+  /// Default destructor
+  ~Digitizer();
+
+  /// Fetches the segmentation of each chip and fills the chip records and sensor transforms of the geometry, so
+  /// that process only reads them. The geometry must be built with its segmentations and is not owned
+  void init(UpgradeGeometryTGeo* geometry);
+
+  /// Digitizes the Points of an event
+  /// \param points Array of AliceO2::ITS::Point
+  /// \param digits Array of AliceO2::ITS::Digit, cleared and filled ordered by chip index, then by column and row
+  void process(const TClonesArray* points, TClonesArray* digits);
+
+  /// Set the number of threads processing the chips
+  void setNumberOfThreads(Int_t n)
+  {
+    mNumberOfThreads = n < 1 ? 1 : n;
+  }
+
+  /// Set the minimal charge of a fired pixel [electrons]
+  void setThreshold(Float_t threshold)
+  {
+    mThreshold = threshold;
+  }
+
+  /// Set the width, as a fraction of the pitch, of the band at the edge of the diode collection area in which
+  /// the charge is shared with the neighbour pixel
+  void setChargeSharingWidth(Float_t width)
+  {
+    mChargeSharingWidth = width;
+  }
+
+  /// Set the sampling step of the track segment, as a fraction of the smallest pitch
+  void setStepFraction(Float_t fraction)
+  {
+    mStepFraction = fraction;
+  }
+
+  Int_t getNumberOfThreads() const
+  {
+    return mNumberOfThreads;
+  }
+
+  /// Number of chips having Points in the last processed event
+  Int_t getNumberOfHitChips() const
+  {
+    return mHitChips.size();
+  }
+
+private:
+  Digitizer(const Digitizer&);
+  Digitizer& operator=(const Digitizer&);
+
+  /// Fired pixel before its conversion to a Digit
+  struct FiredPixel {
+    Int_t mChipIndex;
+    Int_t mRow;
+    Int_t mColumn;
+    Float_t mCharge;
+    Int_t mLabel;
+  };
+
+  /// Buffers of a thread, sized for the largest pixel matrix
+  struct Workspace {
+    std::vector<Float_t> mCharge;         ///< charge of each pixel of the chip being processed
+    std::vector<Int_t> mLabel;            ///< label of each pixel of the chip being processed
+    std::vector<Int_t> mTouchedPixels;    ///< pixels with charge of the chip being processed
+    std::vector<FiredPixel> mFiredPixels; ///< output of all chips processed by the thread
+  };
+
+  /// Output of a chip: workspace and range in its mFiredPixels
+  struct ChipOutput {
+    Int_t mWorkspace;
+    Int_t mFirst;
+    Int_t mLast;
+  };
+
+  /// Digitizes the Points of one chip into a workspace
+  void processChip(Int_t chipIndex, const TClonesArray* points, Workspace& ws) const;
+
+  /// Adds charge to a pixel, ignoring pixels outside of the matrix
+  static void addCharge(const UpgradeSegmentationPixel* seg, Int_t ix, Int_t iz, Float_t charge, Int_t label,
+                        Workspace& ws);
+
+  /// Fraction of the charge going to the neighbour pixel for a position u with respect to the diode, in pitch units
+  Float_t getSharedFraction(Double_t u) const;
+
+  UpgradeGeometryTGeo* mGeometry;                                 ///< geometry, not owned
+  std::vector<const UpgradeSegmentationPixel*> mChipSegmentation; ///< segmentation of each chip
+  Float_t mMinimumPitch;                                          ///< smallest pitch of all segmentations [cm]
+  Float_t mThreshold;                                             ///< minimal charge of a fired pixel [electrons]
+  Float_t mChargeSharingWidth;                                    ///< charge sharing band width [pitch fraction]
+  Float_t mStepFraction;                                          ///< segment sampling step [minimum pitch fraction]
+  Int_t mNumberOfThreads;                                         ///< number of threads processing the chips
+  Int_t mMaximumNumberOfPixels;                                   ///< size of the largest pixel matrix
+
+  std::vector<Int_t> mChipFirstPoint;   ///< index in mPointOrder of the first Point of each chip, size nChips+1
+  std::vector<Int_t> mPointOrder;       ///< Point indices grouped by chip
+  std::vector<Int_t> mHitChips;         ///< chips having Points, increasing
+  std::vector<ChipOutput> mChipOutputs; ///< output of each chip of mHitChips
+  std::vector<Workspace> mWorkspaces;   ///< buffers of each thread
+};
+}
+}
+
+#endif
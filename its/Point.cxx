@@ -9,13 +9,17 @@ using std::cout;
 using std::endl;
 using namespace AliceO2::ITS;
 
-Point::Point() : FairMCPoint()
+Point::Point() : FairMCPoint(), mStartX(0.), mStartY(0.), mStartZ(0.), mStartTime(0.)
 {
 }
 
 Point::Point(Int_t trackID, Int_t detID, TVector3 startPos, TVector3 pos, TVector3 mom,
              Double_t startTime, Double_t time, Double_t length, Double_t eLoss, Int_t shunt)
-  : FairMCPoint(trackID, detID, pos, mom, time, length, eLoss)
+  : FairMCPoint(trackID, detID, pos, mom, time, length, eLoss),
+    mStartX(startPos.X()),
+    mStartY(startPos.Y()),
+    mStartZ(startPos.Z()),
+    mStartTime(startTime)
 {
 }
 
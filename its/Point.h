@@ -20,7 +20,7 @@ public:
 
   /// Class Constructor
   /// \param trackID Index of MCTrack
-  /// \param detID Detector ID
+  /// \param detID Detector ID, the chip index
   /// \param startPos Coordinates at entrance to active volume [cm]
   /// \param pos Coordinates to active volume [cm]
   /// \param mom Momentum of track at entrance [GeV]
@@ -35,15 +35,38 @@ public:
   // Default Destructor
   virtual ~Point();
 
+  /// Coordinates and time at the entrance to the active volume, the exit being the point position
+  Double_t getStartX() const
+  {
+    return mStartX;
+  }
+  Double_t getStartY() const
+  {
+    return mStartY;
+  }
+  Double_t getStartZ() const
+  {
+    return mStartZ;
+  }
+  Double_t getStartTime() const
+  {
+    return mStartTime;
+  }
+
   /// Output to screen
   virtual void Print(const Option_t* opt) const;
 
 private:
+  Double32_t mStartX;    ///< x at entrance to active volume [cm]
+  Double32_t mStartY;    ///< y at entrance to active volume [cm]
+  Double32_t mStartZ;    ///< z at entrance to active volume [cm]
+  Double32_t mStartTime; ///< time at entrance to active volume [ns]
+
   /// Copy constructor
   Point(const Point& point);
   Point operator=(const Point& point);
 
-  ClassDef(Point, 1)
+  ClassDef(Point, 2)
 };
 }
 }
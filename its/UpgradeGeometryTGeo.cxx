@@ -22,6 +22,13 @@
 
 #include "FairLogger.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <thread>
+
 using namespace TMath;
 using namespace AliceO2::ITS;
 
@@ -39,6 +46,12 @@ TString UpgradeGeometryTGeo::mWrapperVolumeName = "ITSUWrapVol";
 TString UpgradeGeometryTGeo::mChipTypeName[UpgradeGeometryTGeo::kNChipTypes] = { "Pix" };
 
 TString UpgradeGeometryTGeo::mSegmentationFileName = "itsSegmentations.root";
+TString UpgradeGeometryTGeo::mMatrixCacheFileName = "";
+Int_t UpgradeGeometryTGeo::mAlignmentVersion = 0;
+
+static const char kMatrixCacheMagic[8] = { 'O', '2', 'I', 'T', 'S', 'M', 'A', 'T' };
+static const Int_t kMatrixCacheVersion = 1;
+static const Int_t kMatrixCacheByteOrder = 0x01020304;
 
 UpgradeGeometryTGeo::UpgradeGeometryTGeo(Bool_t build, Bool_t loadSegmentations)
   : mVersion(kITSVNA),
@@ -56,7 +69,11 @@ UpgradeGeometryTGeo::UpgradeGeometryTGeo(Bool_t build, Bool_t loadSegmentations)
     mLastChipIndex(0),
     mSensorMatrices(0),
     mTrackingToLocalMatrices(0),
-    mSegmentations(0)
+    mSegmentations(0),
+    mSensorTransforms(),
+    mSensorTransformsF(),
+    mChipRecords(),
+    mLayerStrides()
 {
   // default c-tor
   for (int i = gMaxLayers; i--;) {
@@ -84,11 +101,17 @@ UpgradeGeometryTGeo::UpgradeGeometryTGeo(const UpgradeGeometryTGeo& src)
     mLastChipIndex(0),
     mSensorMatrices(0),
     mTrackingToLocalMatrices(0),
-    mSegmentations(0)
+    mSegmentations(0),
+    mSensorTransforms(src.mSensorTransforms),
+    mSensorTransformsF(src.mSensorTransformsF),
+    mChipRecords(src.mChipRecords),
+    mLayerStrides(src.mLayerStrides)
 {
   // copy c-tor
   if (mNumberOfLayers) {
     mNumberOfStaves = new Int_t[mNumberOfLayers];
+    mNumberOfHalfStaves = new Int_t[mNumberOfLayers];
+    mNumberOfModules = new Int_t[mNumberOfLayers];
     mNumberOfChipsPerModule = new Int_t[mNumberOfLayers];
     mNumberOfChipRowsPerModule = new Int_t[mNumberOfLayers];
     mLayerChipType = new Int_t[mNumberOfLayers];
@@ -180,6 +203,10 @@ UpgradeGeometryTGeo& UpgradeGeometryTGeo::operator=(const UpgradeGeometryTGeo& s
     mVersion = src.mVersion;
     mNumberOfLayers = src.mNumberOfLayers;
     mNumberOfChips = src.mNumberOfChips;
+    mSensorTransforms = src.mSensorTransforms;
+    mSensorTransformsF = src.mSensorTransformsF;
+    mChipRecords = src.mChipRecords;
+    mLayerStrides = src.mLayerStrides;
     if (src.mSensorMatrices) {
       delete mSensorMatrices;
       mSensorMatrices = new TObjArray(mNumberOfChips);
@@ -239,34 +266,6 @@ UpgradeGeometryTGeo& UpgradeGeometryTGeo::operator=(const UpgradeGeometryTGeo& s
   return *this;
 }
 
-Int_t UpgradeGeometryTGeo::getChipIndex(Int_t lay, Int_t sta, Int_t chipInStave) const
-{
-  return getFirstChipIndex(lay) + mNumberOfChipsPerStave[lay] * sta + chipInStave;
-}
-
-Int_t UpgradeGeometryTGeo::getChipIndex(Int_t lay, Int_t sta, Int_t substa, Int_t chipInSStave)
-  const
-{
-  int n = getFirstChipIndex(lay) + mNumberOfChipsPerStave[lay] * sta + chipInSStave;
-  if (mNumberOfHalfStaves[lay] && substa > 0) {
-    n += mNumberOfChipsPerHalfStave[lay] * substa;
-  }
-  return n;
-}
-
-Int_t UpgradeGeometryTGeo::getChipIndex(Int_t lay, Int_t sta, Int_t substa, Int_t md,
-                                        Int_t chipInMod) const
-{
-  int n = getFirstChipIndex(lay) + mNumberOfChipsPerStave[lay] * sta + chipInMod;
-  if (mNumberOfHalfStaves[lay] && substa > 0) {
-    n += mNumberOfChipsPerHalfStave[lay] * substa;
-  }
-  if (mNumberOfModules[lay] && md > 0) {
-    n += mNumberOfChipsPerModule[lay] * md;
-  }
-  return n;
-}
-
 Bool_t UpgradeGeometryTGeo::getLayer(Int_t index, Int_t& lay, Int_t& indexInLr) const
 {
   lay = getLayer(index);
@@ -274,111 +273,6 @@ Bool_t UpgradeGeometryTGeo::getLayer(Int_t index, Int_t& lay, Int_t& indexInLr)
   return kTRUE;
 }
 
-Int_t UpgradeGeometryTGeo::getLayer(Int_t index) const
-{
-  int lay = 0;
-  while (index > mLastChipIndex[lay]) {
-    lay++;
-  }
-  return lay;
-}
-
-Int_t UpgradeGeometryTGeo::getStave(Int_t index) const
-{
-  int lay = 0;
-  while (index > mLastChipIndex[lay]) {
-    lay++;
-  }
-  index -= getFirstChipIndex(lay);
-  return index / mNumberOfChipsPerStave[lay];
-}
-
-Int_t UpgradeGeometryTGeo::getHalfStave(Int_t index) const
-{
-  int lay = 0;
-  while (index > mLastChipIndex[lay]) {
-    lay++;
-  }
-  if (mNumberOfHalfStaves[lay] < 0) {
-    return -1;
-  }
-  index -= getFirstChipIndex(lay);
-  index %= mNumberOfChipsPerStave[lay];
-  return index / mNumberOfChipsPerHalfStave[lay];
-}
-
-Int_t UpgradeGeometryTGeo::getModule(Int_t index) const
-{
-  int lay = 0;
-  while (index > mLastChipIndex[lay]) {
-    lay++;
-  }
-  if (mNumberOfModules[lay] < 0) {
-    return 0;
-  }
-  index -= getFirstChipIndex(lay);
-  index %= mNumberOfChipsPerStave[lay];
-  if (mNumberOfHalfStaves[lay]) {
-    index %= mNumberOfChipsPerHalfStave[lay];
-  }
-  return index / mNumberOfChipsPerModule[lay];
-}
-
-Int_t UpgradeGeometryTGeo::getChipIdInLayer(Int_t index) const
-{
-  int lay = 0;
-  while (index > mLastChipIndex[lay]) {
-    lay++;
-  }
-  index -= getFirstChipIndex(lay);
-  return index;
-}
-
-Int_t UpgradeGeometryTGeo::getChipIdInStave(Int_t index) const
-{
-  int lay = 0;
-  while (index > mLastChipIndex[lay]) {
-    lay++;
-  }
-  index -= getFirstChipIndex(lay);
-  return index % mNumberOfChipsPerStave[lay];
-}
-
-Int_t UpgradeGeometryTGeo::getChipIdInHalfStave(Int_t index) const
-{
-  int lay = 0;
-  while (index > mLastChipIndex[lay]) {
-    lay++;
-  }
-  index -= getFirstChipIndex(lay);
-  return index % mNumberOfChipsPerHalfStave[lay];
-}
-
-Int_t UpgradeGeometryTGeo::getChipIdInModule(Int_t index) const
-{
-  int lay = 0;
-  while (index > mLastChipIndex[lay]) {
-    lay++;
-  }
-  index -= getFirstChipIndex(lay);
-  return index % mNumberOfChipsPerModule[lay];
-}
-
-Bool_t UpgradeGeometryTGeo::getChipId(Int_t index, Int_t& lay, Int_t& sta, Int_t& hsta, Int_t& mod,
-                                      Int_t& chip) const
-{
-  lay = getLayer(index);
-  index -= getFirstChipIndex(lay);
-  sta = index / mNumberOfChipsPerStave[lay];
-  index %= mNumberOfChipsPerStave[lay];
-  hsta = mNumberOfHalfStaves[lay] > 0 ? index / mNumberOfChipsPerHalfStave[lay] : -1;
-  index %= mNumberOfChipsPerHalfStave[lay];
-  mod = mNumberOfModules[lay] > 0 ? index / mNumberOfChipsPerModule[lay] : -1;
-  chip = index % mNumberOfChipsPerModule[lay];
-
-  return kTRUE;
-}
-
 const char* UpgradeGeometryTGeo::getSymbolicName(Int_t index) const
 {
   Int_t lay, index2;
@@ -674,6 +568,7 @@ void UpgradeGeometryTGeo::Build(Bool_t loadSegmentations)
     mLastChipIndex[i] = mNumberOfChips - 1;
   }
 
+  fillChipRecords();
   fetchMatrices();
   mVersion = kITSVUpg;
 
@@ -683,6 +578,32 @@ void UpgradeGeometryTGeo::Build(Bool_t loadSegmentations)
   }
 }
 
+void UpgradeGeometryTGeo::fillChipRecords() const
+{
+  mLayerStrides.resize(mNumberOfLayers);
+  mChipRecords.resize(mNumberOfChips);
+  for (int lay = 0; lay < mNumberOfLayers; lay++) {
+    LayerStrides& strides = mLayerStrides[lay];
+    strides.mFirstChip = getFirstChipIndex(lay);
+    strides.mChipsPerStave = mNumberOfChipsPerStave[lay];
+    strides.mChipsPerHalfStave = mNumberOfHalfStaves[lay] > 0 ? mNumberOfChipsPerHalfStave[lay] : 0;
+    strides.mChipsPerModule = mNumberOfModules[lay] > 0 ? mNumberOfChipsPerModule[lay] : 0;
+    for (int i = 0; i < mNumberOfChipsPerLayer[lay]; i++) {
+      ChipRecord& rec = mChipRecords[strides.mFirstChip + i];
+      Int_t inStave = i % mNumberOfChipsPerStave[lay];
+      Int_t inHalfStave = inStave % mNumberOfChipsPerHalfStave[lay];
+      rec.mLayer = lay;
+      rec.mStave = i / mNumberOfChipsPerStave[lay];
+      rec.mHalfStave = mNumberOfHalfStaves[lay] > 0 ? inStave / mNumberOfChipsPerHalfStave[lay] : -1;
+      rec.mModule = mNumberOfModules[lay] > 0 ? inHalfStave / mNumberOfChipsPerModule[lay] : -1;
+      rec.mChipInModule = inHalfStave % mNumberOfChipsPerModule[lay];
+      rec.mChipInStave = inStave;
+      rec.mChipInHalfStave = inHalfStave;
+      rec.mChipType = mLayerChipType[lay];
+    }
+  }
+}
+
 Int_t UpgradeGeometryTGeo::extractNumberOfLayers()
 {
   Int_t numberOfLayers = 0;
@@ -939,17 +860,373 @@ void UpgradeGeometryTGeo::Print(Option_t*) const
   }
 }
 
+/// Appends to the packed transformation m the placement of a daughter node: m = m * local
+static void multiplyTransform(Double_t* m, const TGeoMatrix* local)
+{
+  const Double_t* r = local->GetRotationMatrix();
+  const Double_t* t = local->GetTranslation();
+  Double_t res[UpgradeGeometryTGeo::kTransformSize];
+  for (int i = 0; i < 3; i++) {
+    const Double_t* row = m + 3 * i;
+    for (int j = 0; j < 3; j++) {
+      res[3 * i + j] = row[0] * r[j] + row[1] * r[3 + j] + row[2] * r[6 + j];
+    }
+    res[9 + i] = m[9 + i] + row[0] * t[0] + row[1] * t[1] + row[2] * t[2];
+  }
+  memcpy(m, res, sizeof(res));
+}
+
+/// Appends to the packed transformation m the placement of the daughter node of vol with the given name.
+/// Returns the volume of the daughter, 0 if there is no such node
+static const TGeoVolume* descendNode(const TGeoVolume* vol, const char* name, Double_t* m)
+{
+  TGeoNode* node = vol->GetNode(name);
+  if (!node) {
+    return 0;
+  }
+  multiplyTransform(m, node->GetMatrix());
+  return node->GetVolume();
+}
+
+/// Creates a matrix from a packed transformation
+static TGeoHMatrix* unpackMatrix(const Double_t* m)
+{
+  TGeoHMatrix* mat = new TGeoHMatrix();
+  mat->SetRotation(m);
+  mat->SetTranslation(m + 9);
+  // the setters do not flag the matrix as a general transformation
+  mat->SetBit(TGeoMatrix::kGeoRotation);
+  mat->SetBit(TGeoMatrix::kGeoTranslation);
+  Double_t det = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) +
+                 m[2] * (m[3] * m[7] - m[4] * m[6]);
+  if (det < 0) {
+    mat->SetBit(TGeoMatrix::kGeoReflection);
+  }
+  return mat;
+}
+
+/// Packs a matrix as rotation by rows followed by the translation
+static void packMatrix(const TGeoHMatrix* mat, Double_t* m)
+{
+  memcpy(m, mat->GetRotationMatrix(), 9 * sizeof(Double_t));
+  memcpy(m + 9, mat->GetTranslation(), 3 * sizeof(Double_t));
+}
+
+/// FNV-1a hash of a block of data
+static ULong64_t hashBytes(ULong64_t hash, const void* data, size_t size)
+{
+  const unsigned char* bytes = (const unsigned char*)data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/// Hashes the daughters of vol and, recursively, their volumes, each volume once
+static ULong64_t hashVolumeTree(ULong64_t hash, const TGeoVolume* vol, std::set<const TGeoVolume*>& done)
+{
+  if (!done.insert(vol).second) {
+    return hashBytes(hash, vol->GetName(), strlen(vol->GetName()) + 1);
+  }
+  const TGeoBBox* box = (const TGeoBBox*)vol->GetShape();
+  Double_t size[3] = { box->GetDX(), box->GetDY(), box->GetDZ() };
+  hash = hashBytes(hash, size, sizeof(size));
+  for (Int_t i = 0; i < vol->GetNdaughters(); i++) {
+    const TGeoNode* node = vol->GetNode(i);
+    const TGeoMatrix* mat = node->GetMatrix();
+    hash = hashBytes(hash, node->GetName(), strlen(node->GetName()) + 1);
+    hash = hashBytes(hash, mat->GetRotationMatrix(), 9 * sizeof(Double_t));
+    hash = hashBytes(hash, mat->GetTranslation(), 3 * sizeof(Double_t));
+    hash = hashVolumeTree(hash, node->GetVolume(), done);
+  }
+  return hash;
+}
+
 void UpgradeGeometryTGeo::fetchMatrices()
 {
+  const char* cacheFile = getMatrixCacheFileName();
+  if (cacheFile[0] && readMatrixCache(cacheFile)) {
+    return;
+  }
   if (!gGeoManager) {
     LOG(FATAL) << "Geometry is not loaded" << FairLogger::endl;
   }
+  std::vector<Double_t> transforms(mNumberOfChips * kTransformSize);
+  extractSensorTransforms(transforms.data());
+  delete mSensorMatrices;
+  delete mTrackingToLocalMatrices;
   mSensorMatrices = new TObjArray(mNumberOfChips);
   mSensorMatrices->SetOwner(kTRUE);
   for (int i = 0; i < mNumberOfChips; i++) {
-    mSensorMatrices->AddAt(new TGeoHMatrix(*extractMatrixSensor(i)), i);
+    mSensorMatrices->AddAt(unpackMatrix(&transforms[i * kTransformSize]), i);
   }
   createT2LMatrices();
+  fillSensorTransforms();
+  if (cacheFile[0]) {
+    writeMatrixCache(cacheFile);
+  }
+}
+
+void UpgradeGeometryTGeo::extractSensorTransforms(Double_t* transforms) const
+{
+  // the layers are handed out one by one, the largest first
+  std::vector<Int_t> layers(mNumberOfLayers);
+  for (int i = 0; i < mNumberOfLayers; i++) {
+    layers[i] = i;
+  }
+  std::sort(layers.begin(), layers.end(),
+            [this](Int_t a, Int_t b) { return mNumberOfChipsPerLayer[a] > mNumberOfChipsPerLayer[b]; });
+  std::vector<char> extracted(mNumberOfLayers, 0);
+  std::atomic<Int_t> nextLayer(0);
+  auto work = [&]() {
+    for (Int_t k; (k = nextLayer++) < mNumberOfLayers;) {
+      extracted[layers[k]] = extractLayerSensorTransforms(layers[k], transforms);
+    }
+  };
+  Int_t nThreads = Min(mNumberOfLayers, Int_t(std::thread::hardware_concurrency()));
+  if (nThreads < 2) {
+    work();
+  } else {
+    std::vector<std::thread> workers;
+    for (Int_t ith = 0; ith < nThreads; ith++) {
+      workers.push_back(std::thread(work));
+    }
+    for (size_t ith = 0; ith < workers.size(); ith++) {
+      workers[ith].join();
+    }
+  }
+  for (int i = 0; i < mNumberOfLayers; i++) {
+    if (!extracted[i]) {
+      LOG(FATAL) << "Failed to extract the sensor matrices of layer " << i << FairLogger::endl;
+    }
+  }
+}
+
+Bool_t UpgradeGeometryTGeo::extractLayerSensorTransforms(Int_t lay, Double_t* transforms) const
+{
+  // same volumes as the path of extractMatrixSensor, the top node having no transformation
+  char name[64];
+  Double_t matLay[kTransformSize] = { 1., 0., 0., 0., 1., 0., 0., 0., 1., 0., 0., 0. };
+  snprintf(name, sizeof(name), "%s_2", getITSVolPattern());
+  const TGeoVolume* volLr = descendNode(gGeoManager->GetTopVolume(), name, matLay);
+  if (volLr && mLayerToWrapper[lay] >= 0) {
+    snprintf(name, sizeof(name), "%s%d_1", getITSWrapVolPattern(), mLayerToWrapper[lay]);
+    volLr = descendNode(volLr, name, matLay);
+  }
+  if (volLr) {
+    snprintf(name, sizeof(name), "%s%d_1", getITSLayerPattern(), lay);
+    volLr = descendNode(volLr, name, matLay);
+  }
+  if (!volLr) {
+    return kFALSE;
+  }
+
+  Int_t nHalfStaves = Max(1, mNumberOfHalfStaves[lay]), nModules = Max(1, mNumberOfModules[lay]);
+  Double_t matSta[kTransformSize], matHSta[kTransformSize], matMod[kTransformSize];
+  Double_t* out = transforms + getFirstChipIndex(lay) * kTransformSize;
+  for (int sta = 0; sta < mNumberOfStaves[lay]; sta++) {
+    memcpy(matSta, matLay, sizeof(matSta));
+    snprintf(name, sizeof(name), "%s%d_%d", getITSStavePattern(), lay, sta);
+    const TGeoVolume* volSta = descendNode(volLr, name, matSta);
+    if (!volSta) {
+      return kFALSE;
+    }
+    for (int hsta = 0; hsta < nHalfStaves; hsta++) {
+      memcpy(matHSta, matSta, sizeof(matHSta));
+      const TGeoVolume* volHSta = volSta;
+      if (mNumberOfHalfStaves[lay] > 0) {
+        snprintf(name, sizeof(name), "%s%d_%d", getITSHalfStavePattern(), lay, hsta);
+        if (!(volHSta = descendNode(volSta, name, matHSta))) {
+          return kFALSE;
+        }
+      }
+      for (int mod = 0; mod < nModules; mod++) {
+        memcpy(matMod, matHSta, sizeof(matMod));
+        const TGeoVolume* volMod = volHSta;
+        if (mNumberOfModules[lay] > 0) {
+          snprintf(name, sizeof(name), "%s%d_%d", getITSModulePattern(), lay, mod);
+          if (!(volMod = descendNode(volHSta, name, matMod))) {
+            return kFALSE;
+          }
+        }
+        for (int chip = 0; chip < mNumberOfChipsPerModule[lay]; chip++) {
+          memcpy(out, matMod, sizeof(matMod));
+          snprintf(name, sizeof(name), "%s%d_%d", getITSChipPattern(), lay, chip);
+          const TGeoVolume* volChip = descendNode(volMod, name, out);
+          snprintf(name, sizeof(name), "%s%d_1", getITSSensorPattern(), lay);
+          if (!volChip || !descendNode(volChip, name, out)) {
+            return kFALSE;
+          }
+          out += kTransformSize;
+        }
+      }
+    }
+  }
+  return kTRUE;
+}
+
+ULong64_t UpgradeGeometryTGeo::computeGeometryHash() const
+{
+  ULong64_t hash = 14695981039346656037ULL;
+  hash = hashBytes(hash, &mNumberOfLayers, sizeof(Int_t));
+  for (int i = 0; i < mNumberOfLayers; i++) {
+    Int_t layout[7] = { mNumberOfStaves[i],           mNumberOfHalfStaves[i], mNumberOfModules[i],
+                        mNumberOfChipsPerModule[i],   mLayerChipType[i],      mLayerToWrapper[i],
+                        mNumberOfChipRowsPerModule[i] };
+    hash = hashBytes(hash, layout, sizeof(layout));
+  }
+  const char* patterns[8] = { getITSVolPattern(),   getITSWrapVolPattern(),   getITSLayerPattern(),
+                              getITSStavePattern(), getITSHalfStavePattern(), getITSModulePattern(),
+                              getITSChipPattern(),  getITSSensorPattern() };
+  for (int i = 0; i < 8; i++) {
+    hash = hashBytes(hash, patterns[i], strlen(patterns[i]) + 1);
+  }
+  const TGeoVolume* itsV = gGeoManager ? gGeoManager->GetVolume(getITSVolPattern()) : 0;
+  if (itsV) {
+    std::set<const TGeoVolume*> done;
+    hash = hashVolumeTree(hash, itsV, done);
+  }
+  return hash;
+}
+
+Bool_t UpgradeGeometryTGeo::writeMatrixCache(const char* fileName) const
+{
+  if (!mSensorMatrices || !mTrackingToLocalMatrices) {
+    LOG(ERROR) << "The matrices are not fetched, nothing to write to " << fileName << FairLogger::endl;
+    return kFALSE;
+  }
+  TString strf = fileName;
+  gSystem->ExpandPathName(strf);
+  TString tmpName = Form("%s.tmp%d", strf.Data(), gSystem->GetPid());
+  FILE* stream = fopen(tmpName.Data(), "wb");
+  if (!stream) {
+    LOG(ERROR) << "Failed to open matrix cache file " << tmpName.Data() << FairLogger::endl;
+    return kFALSE;
+  }
+  Int_t info[4] = { kMatrixCacheVersion, kMatrixCacheByteOrder, mAlignmentVersion, mNumberOfChips };
+  ULong64_t hash = computeGeometryHash();
+  std::vector<Double_t> data(2 * mNumberOfChips * kTransformSize);
+  for (int i = 0; i < mNumberOfChips; i++) {
+    packMatrix((const TGeoHMatrix*)mSensorMatrices->At(i), &data[i * kTransformSize]);
+    packMatrix((const TGeoHMatrix*)mTrackingToLocalMatrices->At(i),
+               &data[(mNumberOfChips + i) * kTransformSize]);
+  }
+  Bool_t ok = fwrite(kMatrixCacheMagic, sizeof(kMatrixCacheMagic), 1, stream) == 1 &&
+              fwrite(info, sizeof(info), 1, stream) == 1 && fwrite(&hash, sizeof(hash), 1, stream) == 1 &&
+              fwrite(data.data(), sizeof(Double_t), data.size(), stream) == data.size();
+  ok = !fclose(stream) && ok;
+  if (!ok || rename(tmpName.Data(), strf.Data())) {
+    LOG(ERROR) << "Failed to write matrix cache file " << strf.Data() << FairLogger::endl;
+    remove(tmpName.Data());
+    return kFALSE;
+  }
+  LOG(INFO) << "Wrote the matrices of " << mNumberOfChips << " chips to " << strf.Data() << FairLogger::endl;
+  return kTRUE;
+}
+
+Bool_t UpgradeGeometryTGeo::readMatrixCache(const char* fileName)
+{
+  TString strf = fileName;
+  gSystem->ExpandPathName(strf);
+  FILE* stream = fopen(strf.Data(), "rb");
+  if (!stream) {
+    return kFALSE;
+  }
+  char magic[sizeof(kMatrixCacheMagic)];
+  Int_t info[4];
+  ULong64_t hash;
+  Bool_t ok = fread(magic, sizeof(magic), 1, stream) == 1 && fread(info, sizeof(info), 1, stream) == 1 &&
+              fread(&hash, sizeof(hash), 1, stream) == 1 && !memcmp(magic, kMatrixCacheMagic, sizeof(magic)) &&
+              info[0] == kMatrixCacheVersion && info[1] == kMatrixCacheByteOrder &&
+              info[2] == mAlignmentVersion && info[3] == mNumberOfChips && hash == computeGeometryHash();
+  std::vector<Double_t> data;
+  if (ok) {
+    data.resize(2 * mNumberOfChips * kTransformSize);
+    ok = fread(data.data(), sizeof(Double_t), data.size(), stream) == data.size();
+  }
+  fclose(stream);
+  if (!ok) {
+    LOG(INFO) << "Matrix cache file " << strf.Data() << " does not match the geometry" << FairLogger::endl;
+    return kFALSE;
+  }
+
+  delete mSensorMatrices;
+  delete mTrackingToLocalMatrices;
+  mSensorMatrices = new TObjArray(mNumberOfChips);
+  mSensorMatrices->SetOwner(kTRUE);
+  mTrackingToLocalMatrices = new TObjArray(mNumberOfChips);
+  mTrackingToLocalMatrices->SetOwner(kTRUE);
+  for (int i = 0; i < mNumberOfChips; i++) {
+    mSensorMatrices->AddAt(unpackMatrix(&data[i * kTransformSize]), i);
+    mTrackingToLocalMatrices->AddAt(unpackMatrix(&data[(mNumberOfChips + i) * kTransformSize]), i);
+  }
+  fillSensorTransforms();
+  return kTRUE;
+}
+
+void UpgradeGeometryTGeo::fillSensorTransforms()
+{
+  if (!mSensorMatrices) {
+    fetchMatrices(); // fills the transformations
+    return;
+  }
+  mSensorTransforms.resize(mNumberOfChips * kTransformSize);
+  mSensorTransformsF.resize(mNumberOfChips * kTransformSize);
+  for (int i = 0; i < mNumberOfChips; i++) {
+    Double_t* m = &mSensorTransforms[i * kTransformSize];
+    packMatrix(getMatrixSensor(i), m);
+    for (int j = kTransformSize; j--;) {
+      mSensorTransformsF[i * kTransformSize + j] = m[j];
+    }
+  }
+}
+
+/// Applies the packed transformation m, or its inverse, to n points given as separate coordinate arrays
+template <typename T>
+static void transformPoints(const T* m, Bool_t inverse, Int_t n, const T* x, const T* y, const T* z, T* ox, T* oy,
+                            T* oz)
+{
+  const T r0 = m[0], r1 = m[1], r2 = m[2], r3 = m[3], r4 = m[4], r5 = m[5], r6 = m[6], r7 = m[7], r8 = m[8];
+  const T tx = m[9], ty = m[10], tz = m[11];
+  if (!inverse) {
+    for (Int_t i = 0; i < n; i++) {
+      T px = x[i], py = y[i], pz = z[i];
+      ox[i] = tx + px * r0 + py * r1 + pz * r2;
+      oy[i] = ty + px * r3 + py * r4 + pz * r5;
+      oz[i] = tz + px * r6 + py * r7 + pz * r8;
+    }
+  } else {
+    for (Int_t i = 0; i < n; i++) {
+      T px = x[i] - tx, py = y[i] - ty, pz = z[i] - tz;
+      ox[i] = px * r0 + py * r3 + pz * r6;
+      oy[i] = px * r1 + py * r4 + pz * r7;
+      oz[i] = px * r2 + py * r5 + pz * r8;
+    }
+  }
+}
+
+void UpgradeGeometryTGeo::localToGlobal(Int_t index, Int_t n, const Double_t* lx, const Double_t* ly,
+                                        const Double_t* lz, Double_t* gx, Double_t* gy, Double_t* gz)
+{
+  transformPoints(getSensorTransform(index), kFALSE, n, lx, ly, lz, gx, gy, gz);
+}
+
+void UpgradeGeometryTGeo::localToGlobal(Int_t index, Int_t n, const Float_t* lx, const Float_t* ly, const Float_t* lz,
+                                        Float_t* gx, Float_t* gy, Float_t* gz)
+{
+  transformPoints(getSensorTransformF(index), kFALSE, n, lx, ly, lz, gx, gy, gz);
+}
+
+void UpgradeGeometryTGeo::globalToLocal(Int_t index, Int_t n, const Double_t* gx, const Double_t* gy,
+                                        const Double_t* gz, Double_t* lx, Double_t* ly, Double_t* lz)
+{
+  transformPoints(getSensorTransform(index), kTRUE, n, gx, gy, gz, lx, ly, lz);
+}
+
+void UpgradeGeometryTGeo::globalToLocal(Int_t index, Int_t n, const Float_t* gx, const Float_t* gy, const Float_t* gz,
+                                        Float_t* lx, Float_t* ly, Float_t* lz)
+{
+  transformPoints(getSensorTransformF(index), kTRUE, n, gx, gy, gz, lx, ly, lz);
 }
 
 void UpgradeGeometryTGeo::createT2LMatrices()
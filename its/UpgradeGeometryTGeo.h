@@ -11,6 +11,8 @@
 #include <TString.h>
 #include <TObjArray.h>
 
+#include <vector>
+
 // FIXME: This is temporary and you have to remove it to avoid cyclic deps
 #include <TGeoManager.h>
 
@@ -44,12 +46,26 @@ class UpgradeGeometryTGeo : public TObject {
 public:
   enum { kITSVNA, kITSVUpg }; // ITS version
 
+  enum { kTransformSize = 12 }; // size of a packed sensor transformation
+
   enum {
     kChipTypePix = 0,
     kNChipTypes,
     kMaxSegmPerChipType = 10
   }; // defined detector chip types (each one can have different segmentations)
 
+  /// Position of a chip in the ITS hierarchy, filled at Build time, or on first use, for every chip
+  struct ChipRecord {
+    UChar_t mLayer;            ///< layer
+    Char_t mHalfStave;         ///< half stave in the stave, -1 if the layer has no half staves
+    Char_t mModule;            ///< module in the half stave, -1 if the layer has no modules
+    UChar_t mChipInModule;     ///< chip in the module
+    UShort_t mStave;           ///< stave in the layer
+    UShort_t mChipInStave;     ///< chip in the stave
+    UShort_t mChipInHalfStave; ///< chip in the half stave
+    UShort_t mChipType;        ///< chip type of the layer
+  };
+
   UpgradeGeometryTGeo(Bool_t build = kFALSE, Bool_t loadSegmentationsentations = kTRUE);
 
   /// Default destructor
@@ -142,6 +158,9 @@ public:
   /// \param Int_t chip The detector number. Starting from 0
   Bool_t getChipId(Int_t index, Int_t& lay, Int_t& sta, Int_t& ssta, Int_t& mod, Int_t& chip) const;
 
+  /// Position of a chip in the hierarchy, all the fields being decoded at once
+  const ChipRecord& getChipRecord(Int_t index) const;
+
   /// Get chip layer, from 0
   Int_t getLayer(Int_t index) const;
 
@@ -226,6 +245,25 @@ public:
   Bool_t getTrackingMatrix(Int_t index, TGeoHMatrix& m);
   Bool_t getTrackingMatrix(Int_t lay, Int_t sta, Int_t det, TGeoHMatrix& m);
 
+  /// Get the sensor matrix of a chip packed as a 3x4 rigid transformation: the rotation by rows followed by
+  /// the translation. The transformations of all chips are contiguous, kTransformSize values per chip
+  const Double_t* getSensorTransform(Int_t index);
+  const Float_t* getSensorTransformF(Int_t index);
+
+  /// Hash of the ITS geometry: numbers of staves, modules, chips... of each layer, volume name patterns and, for
+  /// every distinct volume of the ITS tree, the names and matrices of its daughters and the size of its shape.
+  /// Together with the alignment version it identifies the sensor matrices of a cache file
+  ULong64_t computeGeometryHash() const;
+
+  /// Writes the sensor and tracking to local matrices of all chips to a binary cache file in the native byte order,
+  /// keyed by the geometry hash and the alignment version. The file is written under a temporary name and then
+  /// renamed, so that concurrent readers never see a partial file
+  Bool_t writeMatrixCache(const char* fileName) const;
+
+  /// Reads the matrices written by writeMatrixCache, without navigating the geometry.
+  /// Returns kFALSE if the file is missing or does not match the geometry hash and the alignment version
+  Bool_t readMatrixCache(const char* fileName);
+
   // Attention: these are transformations wrt sensitive volume!
   void localToGlobal(Int_t index, const Double_t* loc, Double_t* glob);
   void localToGlobal(Int_t lay, Int_t sta, Int_t det, const Double_t* loc, Double_t* glob);
@@ -236,6 +274,19 @@ public:
   void localToGlobalVector(Int_t index, const Double_t* loc, Double_t* glob);
   void globalToLocalVector(Int_t index, const Double_t* glob, Double_t* loc);
 
+  /// Sensor local to global for n points of a chip given as separate coordinate arrays, which may be the same
+  /// for input and output. Uses the packed transformations and vectorizes over the points
+  void localToGlobal(Int_t index, Int_t n, const Double_t* lx, const Double_t* ly, const Double_t* lz,
+                     Double_t* gx, Double_t* gy, Double_t* gz);
+  void localToGlobal(Int_t index, Int_t n, const Float_t* lx, const Float_t* ly, const Float_t* lz, Float_t* gx,
+                     Float_t* gy, Float_t* gz);
+
+  /// Global to sensor local for n points of a chip, see the batched localToGlobal
+  void globalToLocal(Int_t index, Int_t n, const Double_t* gx, const Double_t* gy, const Double_t* gz,
+                     Double_t* lx, Double_t* ly, Double_t* lz);
+  void globalToLocal(Int_t index, Int_t n, const Float_t* gx, const Float_t* gy, const Float_t* gz, Float_t* lx,
+                     Float_t* ly, Float_t* lz);
+
   Int_t getLayerChipTypeId(Int_t lr) const;
   Int_t getChipChipTypeId(Int_t id) const;
 
@@ -332,6 +383,24 @@ public:
   {
     mSegmentationFileName = nm;
   }
+  static const char* getMatrixCacheFileName()
+  {
+    return mMatrixCacheFileName.Data();
+  }
+  /// Set the matrix cache file read by fetchMatrices, and written by it when missing or outdated. Empty to disable
+  static void setMatrixCacheFileName(const char* nm)
+  {
+    mMatrixCacheFileName = nm;
+  }
+  static Int_t getAlignmentVersion()
+  {
+    return mAlignmentVersion;
+  }
+  /// Set the version of the alignment applied to the geometry, part of the key of the matrix cache
+  static void setAlignmentVersion(Int_t v)
+  {
+    mAlignmentVersion = v;
+  }
   static UInt_t composeChipTypeId(UInt_t segmId);
 
   /// sym name of the layer
@@ -363,10 +432,27 @@ public:
   }
 
 protected:
-  /// Store pointer on often used matrices for faster access
+  /// Store pointer on often used matrices for faster access.
+  /// The matrices are read from the matrix cache file if set and valid, otherwise extracted from the geometry
   void fetchMatrices();
+
+  /// Computes the packed sensor transformations of all chips, the layers being processed concurrently
+  void extractSensorTransforms(Double_t* transforms) const;
+
+  /// Computes the packed sensor transformations of the chips of a layer by composing the matrices of the nodes
+  /// from the top volume down to the sensors. Only reads the geometry, without navigation, so that different
+  /// layers can be processed concurrently. Returns kFALSE if a volume is missing
+  Bool_t extractLayerSensorTransforms(Int_t lay, Double_t* transforms) const;
   void createT2LMatrices();
 
+  /// Packs the sensor matrices in mSensorTransforms and mSensorTransformsF
+  void fillSensorTransforms();
+
+  /// Fills the chip records and the layer strides from the numbers of staves, modules, chips... of the layers.
+  /// Called by Build, and on first use for a geometry read from a file, whose first decoding must then not
+  /// happen concurrently
+  void fillChipRecords() const;
+
   /// Get the matrix which transforms from the tracking to local r.s.
   /// The method queries directly the TGeoPNEntry
   TGeoHMatrix* extractMatrixTrackingToLocal(Int_t index) const;
@@ -438,6 +524,22 @@ protected:
   TObjArray* mTrackingToLocalMatrices; ///< Tracking to Local matrices pointers in the geometry
   TObjArray* mSegmentations;           ///< segmentations
 
+  std::vector<Double_t> mSensorTransforms; //! packed sensor matrices, kTransformSize values per chip
+  std::vector<Float_t> mSensorTransformsF; //! mSensorTransforms in single precision
+
+  /// Chip index increments of a layer, 0 for the levels missing in the layer
+  struct LayerStrides {
+    Int_t mFirstChip;
+    Int_t mChipsPerStave;
+    Int_t mChipsPerHalfStave;
+    Int_t mChipsPerModule;
+  };
+  /// Chip index increments of a layer
+  const LayerStrides& getLayerStrides(Int_t lay) const;
+
+  mutable std::vector<ChipRecord> mChipRecords;    //! position of each chip in the hierarchy
+  mutable std::vector<LayerStrides> mLayerStrides; //! chip index increments of each layer
+
   static UInt_t mUIDShift;                   ///< bit shift to go from mod.id to modUUID for TGeo
   static TString mVolumeName;                ///< Mother volume name
   static TString mLayerName;                 ///< Layer name
@@ -450,6 +552,8 @@ protected:
   static TString mChipTypeName[kNChipTypes]; ///< upg detType Names
 
   static TString mSegmentationFileName; ///< file name for segmentations
+  static TString mMatrixCacheFileName;  ///< file name for the matrix cache, none if empty
+  static Int_t mAlignmentVersion;       ///< version of the alignment applied to the geometry
 
   ClassDef(UpgradeGeometryTGeo, 1) // ITS geometry based on TGeo
 };
@@ -508,10 +612,114 @@ inline Int_t UpgradeGeometryTGeo::getLayerChipTypeId(Int_t lr) const
   return mLayerChipType[lr];
 }
 
+/// Position of a chip, the records being filled if needed
+inline const UpgradeGeometryTGeo::ChipRecord& UpgradeGeometryTGeo::getChipRecord(Int_t index) const
+{
+  if (mChipRecords.empty()) {
+    fillChipRecords();
+  }
+  return mChipRecords[index];
+}
+
+/// Chip index increments of a layer, the strides being filled if needed
+inline const UpgradeGeometryTGeo::LayerStrides& UpgradeGeometryTGeo::getLayerStrides(Int_t lay) const
+{
+  if (mLayerStrides.empty()) {
+    fillChipRecords();
+  }
+  return mLayerStrides[lay];
+}
+
 // Detector type ID of chip
 inline Int_t UpgradeGeometryTGeo::getChipChipTypeId(Int_t id) const
 {
-  return getLayerChipTypeId(getLayer(id));
+  return getChipRecord(id).mChipType;
+}
+
+/// Chip index from the layer, stave and chip in stave
+inline Int_t UpgradeGeometryTGeo::getChipIndex(Int_t lay, Int_t sta, Int_t chipInStave) const
+{
+  const LayerStrides& strides = getLayerStrides(lay);
+  return strides.mFirstChip + strides.mChipsPerStave * sta + chipInStave;
+}
+
+/// Chip index from the layer, stave, half stave and chip in half stave
+inline Int_t UpgradeGeometryTGeo::getChipIndex(Int_t lay, Int_t sta, Int_t substa, Int_t chipInSStave) const
+{
+  const LayerStrides& strides = getLayerStrides(lay);
+  return strides.mFirstChip + strides.mChipsPerStave * sta + strides.mChipsPerHalfStave * (substa > 0 ? substa : 0) +
+         chipInSStave;
+}
+
+/// Chip index from the layer, stave, half stave, module and chip in module
+inline Int_t UpgradeGeometryTGeo::getChipIndex(Int_t lay, Int_t sta, Int_t substa, Int_t md, Int_t chipInMod) const
+{
+  const LayerStrides& strides = getLayerStrides(lay);
+  return strides.mFirstChip + strides.mChipsPerStave * sta + strides.mChipsPerHalfStave * (substa > 0 ? substa : 0) +
+         strides.mChipsPerModule * (md > 0 ? md : 0) + chipInMod;
+}
+
+/// Position of a chip
+inline Bool_t UpgradeGeometryTGeo::getChipId(Int_t index, Int_t& lay, Int_t& sta, Int_t& hsta, Int_t& mod,
+                                             Int_t& chip) const
+{
+  const ChipRecord& rec = getChipRecord(index);
+  lay = rec.mLayer;
+  sta = rec.mStave;
+  hsta = rec.mHalfStave;
+  mod = rec.mModule;
+  chip = rec.mChipInModule;
+  return kTRUE;
+}
+
+/// Layer of a chip
+inline Int_t UpgradeGeometryTGeo::getLayer(Int_t index) const
+{
+  return getChipRecord(index).mLayer;
+}
+
+/// Stave of a chip
+inline Int_t UpgradeGeometryTGeo::getStave(Int_t index) const
+{
+  return getChipRecord(index).mStave;
+}
+
+/// Half stave of a chip, 0 if the layer has no half staves
+inline Int_t UpgradeGeometryTGeo::getHalfStave(Int_t index) const
+{
+  Int_t hsta = getChipRecord(index).mHalfStave;
+  return hsta < 0 ? 0 : hsta;
+}
+
+/// Module of a chip, 0 if the layer has no modules
+inline Int_t UpgradeGeometryTGeo::getModule(Int_t index) const
+{
+  Int_t mod = getChipRecord(index).mModule;
+  return mod < 0 ? 0 : mod;
+}
+
+/// Chip number within the layer
+inline Int_t UpgradeGeometryTGeo::getChipIdInLayer(Int_t index) const
+{
+  return index - getLayerStrides(getChipRecord(index).mLayer).mFirstChip;
+}
+
+/// Chip number within the stave
+inline Int_t UpgradeGeometryTGeo::getChipIdInStave(Int_t index) const
+{
+  return getChipRecord(index).mChipInStave;
+}
+
+/// Chip number within the half stave
+inline Int_t UpgradeGeometryTGeo::getChipIdInHalfStave(Int_t index) const
+{
+  return getChipRecord(index).mChipInHalfStave;
+}
+
+/// Chip number within the module
+inline Int_t UpgradeGeometryTGeo::getChipIdInModule(Int_t index) const
+{
+  return getChipRecord(index).mChipInModule;
 }
 
 /// Access global to sensor matrix
@@ -532,28 +740,60 @@ inline const TGeoHMatrix* UpgradeGeometryTGeo::getMatrixT2L(Int_t index)
   return (TGeoHMatrix*)mTrackingToLocalMatrices->At(index);
 }
 
-/// Sensor local to global
+/// Access the packed sensor matrix
+inline const Double_t* UpgradeGeometryTGeo::getSensorTransform(Int_t index)
+{
+  if (mSensorTransforms.empty()) {
+    fillSensorTransforms();
+  }
+  return &mSensorTransforms[index * kTransformSize];
+}
+
+/// Access the packed sensor matrix in single precision
+inline const Float_t* UpgradeGeometryTGeo::getSensorTransformF(Int_t index)
+{
+  if (mSensorTransformsF.empty()) {
+    fillSensorTransforms();
+  }
+  return &mSensorTransformsF[index * kTransformSize];
+}
+
+/// Sensor local to global, as TGeoHMatrix::LocalToMaster
 inline void UpgradeGeometryTGeo::localToGlobal(Int_t index, const Double_t* loc, Double_t* glob)
 {
-  getMatrixSensor(index)->LocalToMaster(loc, glob);
+  const Double_t* m = getSensorTransform(index);
+  for (int i = 0; i < 3; i++) {
+    glob[i] = m[9 + i] + loc[0] * m[3 * i] + loc[1] * m[3 * i + 1] + loc[2] * m[3 * i + 2];
+  }
 }
 
-/// Global to sensor local
+/// Global to sensor local, as TGeoHMatrix::MasterToLocal
 inline void UpgradeGeometryTGeo::globalToLocal(Int_t index, const Double_t* glob, Double_t* loc)
 {
-  getMatrixSensor(index)->MasterToLocal(glob, loc);
+  const Double_t* m = getSensorTransform(index);
+  Double_t dx = glob[0] - m[9], dy = glob[1] - m[10], dz = glob[2] - m[11];
+  for (int i = 0; i < 3; i++) {
+    loc[i] = dx * m[i] + dy * m[i + 3] + dz * m[i + 6];
+  }
 }
 
 /// Sensor local to global
 inline void UpgradeGeometryTGeo::localToGlobalVector(Int_t index, const Double_t* loc, Double_t* glob)
 {
-  getMatrixSensor(index)->LocalToMasterVect(loc, glob);
+  const Double_t* m = getSensorTransform(index);
+  for (int i = 0; i < 3; i++) {
+    glob[i] = loc[0] * m[3 * i] + loc[1] * m[3 * i + 1] + loc[2] * m[3 * i + 2];
+  }
 }
 
 /// Global to sensor local
 inline void UpgradeGeometryTGeo::globalToLocalVector(Int_t index, const Double_t* glob, Double_t* loc)
 {
-  getMatrixSensor(index)->MasterToLocalVect(glob, loc);
+  const Double_t* m = getSensorTransform(index);
+  Double_t gx = glob[0], gy = glob[1], gz = glob[2];
+  for (int i = 0; i < 3; i++) {
+    loc[i] = gx * m[i] + gy * m[i + 3] + gz * m[i + 6];
+  }
 }
 
 /// Local2Master (sensor)
@@ -300,10 +300,10 @@ void UpgradeSegmentationPixel::cellBoundries(Int_t ix, Int_t iz, Double_t& xl, D
   }
   float zpitchH = cellSizeZ(iz) * 0.5;
   float xpitchH = mPitchX * 0.5;
-  xl -= xpitchH;
-  xu += xpitchH;
-  zl -= zpitchH;
-  zu += zpitchH;
+  xl = x - xpitchH;
+  xu = x + xpitchH;
+  zl = z - zpitchH;
+  zu = z + zpitchH;
   return; // Found x and z, return.
 }
 
@@ -15,5 +15,7 @@
 #pragma link C++ class AliceO2::ITS::GeometryHandler+;
 #pragma link C++ class AliceO2::ITS::MisalignmentParameter+;
 #pragma link C++ class AliceO2::ITS::Point+;
+#pragma link C++ class AliceO2::ITS::Digit+;
+#pragma link C++ class AliceO2::ITS::Cluster+;
 
 #endif
@@ -0,0 +1,129 @@
+/// \file benchmarkChipIndex.cxx
+/// \brief Benchmark of the ITS chip index decoding and encoding of UpgradeGeometryTGeo
+///
+/// Usage: benchmarkChipIndex [-g geometryFile] [-r nRepetitions]
+///
+/// The ITS geometry is imported from geometryFile (as written by the simulation, default geofile_full.root).
+/// All chip indices are decoded nRepetitions times (default 1000) into layer, stave, half stave, module and chip
+/// in module, with the divisions over the numbers of chips of each level as done before the chip records, with
+/// UpgradeGeometryTGeo::getChipId and with UpgradeGeometryTGeo::getChipRecord, and encoded back with
+/// UpgradeGeometryTGeo::getChipIndex. The time per chip is reported, the decoded positions and the encoded
+/// indices must match the reference.
+
+#include "UpgradeGeometryTGeo.h"
+#include "BenchmarkTools.h"
+
+#include "TGeoManager.h"
+
+#include <cstdio>
+
+using namespace AliceO2::ITS;
+using namespace AliceO2::Benchmark;
+
+namespace {
+/// Decodes a chip index by searching the layer and dividing by the numbers of chips of each level
+void decodeReference(const UpgradeGeometryTGeo& geom, Int_t index, Int_t& lay, Int_t& sta, Int_t& hsta, Int_t& mod,
+                     Int_t& chip)
+{
+  lay = 0;
+  while (index > geom.getLastChipIndex(lay)) {
+    lay++;
+  }
+  index -= geom.getFirstChipIndex(lay);
+  sta = index / geom.getNumberOfChipsPerStave(lay);
+  index %= geom.getNumberOfChipsPerStave(lay);
+  hsta = geom.getNumberOfHalfStaves(lay) > 0 ? index / geom.getNumberOfChipsPerHalfStave(lay) : -1;
+  index %= geom.getNumberOfChipsPerHalfStave(lay);
+  mod = geom.getNumberOfModules(lay) > 0 ? index / geom.getNumberOfChipsPerModule(lay) : -1;
+  chip = index % geom.getNumberOfChipsPerModule(lay);
+}
+
+/// Combines a decoded position in a checksum
+Long64_t checksum(Int_t lay, Int_t sta, Int_t hsta, Int_t mod, Int_t chip)
+{
+  return (((Long64_t(lay) * 1000 + sta) * 100 + hsta) * 100 + mod) * 100 + chip;
+}
+}
+
+int main(int argc, char** argv)
+{
+  const char* geometryFile = "geofile_full.root";
+  Int_t nRepetitions = 1000;
+  Options options;
+  options.add("-g", &geometryFile);
+  options.add("-r", &nRepetitions);
+  if (!options.parse(argc, argv)) {
+    printf("Usage: %s [-g geometryFile] [-r nRepetitions]\n", argv[0]);
+    return 2;
+  }
+  if (nRepetitions < 1) {
+    nRepetitions = 1;
+  }
+
+  if (!TGeoManager::Import(geometryFile)) {
+    printf("Cannot import the geometry from %s\n", geometryFile);
+    return 1;
+  }
+  UpgradeGeometryTGeo geom(kTRUE, kFALSE);
+  Int_t nChips = geom.getNumberOfChips();
+
+  // check every chip against the reference decoding
+  Int_t nErrors = 0;
+  for (Int_t ic = 0; ic < nChips; ic++) {
+    Int_t lay, sta, hsta, mod, chip, lay1, sta1, hsta1, mod1, chip1;
+    decodeReference(geom, ic, lay, sta, hsta, mod, chip);
+    geom.getChipId(ic, lay1, sta1, hsta1, mod1, chip1);
+    const UpgradeGeometryTGeo::ChipRecord& rec = geom.getChipRecord(ic);
+    if (checksum(lay, sta, hsta, mod, chip) != checksum(lay1, sta1, hsta1, mod1, chip1) ||
+        checksum(lay, sta, hsta, mod, chip) != checksum(rec.mLayer, rec.mStave, rec.mHalfStave, rec.mModule,
+                                                        rec.mChipInModule) ||
+        rec.mChipType != geom.getLayerChipTypeId(lay) || geom.getChipIndex(lay, sta, hsta, mod, chip) != ic) {
+      if (nErrors++ < 10) {
+        printf("Chip %d: reference %d/%d/%d/%d/%d, getChipId %d/%d/%d/%d/%d, getChipIndex %d\n", ic, lay, sta, hsta,
+               mod, chip, lay1, sta1, hsta1, mod1, chip1, geom.getChipIndex(lay, sta, hsta, mod, chip));
+      }
+    }
+  }
+
+  const int kNMethods = 4;
+  const char* methodNames[kNMethods] = { "reference", "getChipId", "getChipRecord", "getChipIndex" };
+  Long64_t sums[kNMethods] = { 0 };
+  printf("%d chips, %d repetitions\n", nChips, nRepetitions);
+  printf("%-16s %12s\n", "method", "ns/chip");
+  for (int im = 0; im < kNMethods; im++) {
+    Long64_t sum = 0;
+    Clock_t::time_point start = Clock_t::now();
+    for (Int_t irep = 0; irep < nRepetitions; irep++) {
+      for (Int_t ic = 0; ic < nChips; ic++) {
+        Int_t lay, sta, hsta, mod, chip;
+        if (im == 0) {
+          decodeReference(geom, ic, lay, sta, hsta, mod, chip);
+        } else if (im == 1) {
+          geom.getChipId(ic, lay, sta, hsta, mod, chip);
+        } else if (im == 2) {
+          const UpgradeGeometryTGeo::ChipRecord& rec = geom.getChipRecord(ic);
+          lay = rec.mLayer;
+          sta = rec.mStave;
+          hsta = rec.mHalfStave;
+          mod = rec.mModule;
+          chip = rec.mChipInModule;
+        } else {
+          // encode the position of the chip, decoded from its record
+          const UpgradeGeometryTGeo::ChipRecord& rec = geom.getChipRecord(ic);
+          sum += geom.getChipIndex(rec.mLayer, rec.mStave, rec.mHalfStave, rec.mModule, rec.mChipInModule);
+          continue;
+        }
+        sum += checksum(lay, sta, hsta, mod, chip);
+      }
+    }
+    Double_t ms = elapsedMs(start);
+    sums[im] = sum;
+    printf("%-16s %12.3f\n", methodNames[im], ms * 1e6 / (Double_t(nChips) * nRepetitions));
+  }
+  if (nErrors || sums[1] != sums[0] || sums[2] != sums[0] ||
+      sums[3] != Long64_t(nRepetitions) * nChips * (nChips - 1) / 2) {
+    printf("%d chips decoded or encoded differently from the reference\n", nErrors);
+    return 1;
+  }
+  return 0;
+}
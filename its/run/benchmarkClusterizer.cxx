@@ -0,0 +1,147 @@
+/// \file benchmarkClusterizer.cxx
+/// \brief Benchmark of the ITS Clusterizer at realistic and worst-case occupancy
+///
+/// Usage: benchmarkClusterizer [-c nChips] [-k clustersPerChip] [-w nWorstChips] [-o worstOccupancy] [-e nEvents]
+///                             [-t nThreads]
+///
+/// The chips have the segmentation of macro/run_sim.C (650 rows and 1500 columns of 20x20 um^2 pixels).
+/// realistic: nChips chips (default 25000) with on average clustersPerChip (default 10) clusters of 1 to 9
+/// pixels around a random seed pixel.
+/// worst-case: nWorstChips chips (default 100) with a fraction worstOccupancy (default 0.05) of the pixels
+/// fired at random, which makes large clusters and many short runs.
+/// Each case is clusterized with 1 and nThreads threads, the throughput is reported in Digits/s and the number
+/// of clusters must not depend on the number of threads.
+
+#include "Clusterizer.h"
+#include "Digit.h"
+#include "UpgradeSegmentationPixel.h"
+#include "BenchmarkTools.h"
+
+#include "TClonesArray.h"
+#include "TMath.h"
+#include "TRandom3.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace AliceO2::ITS;
+using namespace AliceO2::Benchmark;
+
+namespace {
+/// Appends the Digits of a chip from its pixels given as column * nRows + row, sorting them as the Digitizer does
+void addChipDigits(Int_t chip, Int_t nRows, std::vector<Int_t>& pixels, TClonesArray& digits)
+{
+  std::sort(pixels.begin(), pixels.end());
+  pixels.erase(std::unique(pixels.begin(), pixels.end()), pixels.end());
+  for (size_t i = 0; i < pixels.size(); i++) {
+    new (digits[digits.GetEntriesFast()]) Digit(chip, pixels[i] % nRows, pixels[i] / nRows, 300., chip);
+  }
+}
+
+/// Fills the Digits of the realistic case
+void generateRealistic(const UpgradeSegmentationPixel& seg, Int_t nChips, Double_t clustersPerChip, TRandom3& rnd,
+                       TClonesArray& digits)
+{
+  Int_t nRows = seg.getNumberOfRows(), nColumns = seg.getNumberOfColumns();
+  std::vector<Int_t> pixels;
+  for (Int_t chip = 0; chip < nChips; chip++) {
+    pixels.clear();
+    for (Int_t ncl = rnd.Integer(Int_t(2 * clustersPerChip) + 1); ncl--;) {
+      Int_t row = rnd.Integer(nRows), col = rnd.Integer(nColumns);
+      for (Int_t npix = 1 + rnd.Integer(9); npix--;) {
+        Int_t r = row + Int_t(rnd.Integer(3)) - 1, c = col + Int_t(rnd.Integer(3)) - 1;
+        if (r >= 0 && r < nRows && c >= 0 && c < nColumns) {
+          pixels.push_back(c * nRows + r);
+        }
+      }
+    }
+    addChipDigits(chip, nRows, pixels, digits);
+  }
+}
+
+/// Fills the Digits of the worst case
+void generateWorstCase(const UpgradeSegmentationPixel& seg, Int_t nChips, Double_t occupancy, TRandom3& rnd,
+                       TClonesArray& digits)
+{
+  Int_t nRows = seg.getNumberOfRows(), nPixels = seg.getNumberOfPads();
+  std::vector<Int_t> pixels;
+  for (Int_t chip = 0; chip < nChips; chip++) {
+    pixels.clear();
+    for (Int_t pix = 0; pix < nPixels; pix++) {
+      if (rnd.Rndm() < occupancy) {
+        pixels.push_back(pix);
+      }
+    }
+    addChipDigits(chip, nRows, pixels, digits);
+  }
+}
+}
+
+int main(int argc, char** argv)
+{
+  Int_t nChips = 25000, nWorstChips = 100, nEvents = 3;
+  Double_t clustersPerChip = 10., worstOccupancy = 0.05;
+  Int_t nThreads = std::thread::hardware_concurrency();
+  Options options;
+  options.add("-c", &nChips);
+  options.add("-k", &clustersPerChip);
+  options.add("-w", &nWorstChips);
+  options.add("-o", &worstOccupancy);
+  options.add("-e", &nEvents);
+  options.add("-t", &nThreads);
+  if (!options.parse(argc, argv)) {
+    printf("Usage: %s [-c nChips] [-k clustersPerChip] [-w nWorstChips] [-o worstOccupancy] [-e nEvents] "
+           "[-t nThreads]\n",
+           argv[0]);
+    return 2;
+  }
+  if (nThreads < 1) {
+    nThreads = 1;
+  }
+  if (nEvents < 1) {
+    nEvents = 1;
+  }
+
+  // segmentation of macro/run_sim.C
+  UpgradeSegmentationPixel seg(0, 1, 1500, 650, 20e-4, 20e-4, 18e-4, -1, -1, 50e-4, 50e-4, 50e-4, 0.2);
+  TRandom3 rnd(12345);
+
+  const int kNCases = 2;
+  const char* caseNames[kNCases] = { "realistic", "worst-case" };
+  Int_t caseChips[kNCases] = { nChips, nWorstChips };
+  Int_t configThreads[2] = { 1, nThreads };
+  printf("%-12s %8s %10s %12s %12s %14s\n", "case", "threads", "digits", "clusters", "ms/event", "Digits/s");
+  for (int icase = 0; icase < kNCases; icase++) {
+    TClonesArray digits("AliceO2::ITS::Digit", 1000000);
+    TClonesArray clusters("AliceO2::ITS::Cluster", 100000);
+    if (icase == 0) {
+      generateRealistic(seg, nChips, clustersPerChip, rnd, digits);
+    } else {
+      generateWorstCase(seg, nWorstChips, worstOccupancy, rnd, digits);
+    }
+    Clusterizer clusterizer;
+    clusterizer.init(&seg, caseChips[icase]);
+    Int_t nClusters[2] = { 0, 0 };
+    for (int ic = 0; ic < 2; ic++) {
+      clusterizer.setNumberOfThreads(configThreads[ic]);
+      clusterizer.process(&digits, &clusters); // sizes the buffers
+      Clock_t::time_point start = Clock_t::now();
+      for (int iev = 0; iev < nEvents; iev++) {
+        clusterizer.process(&digits, &clusters);
+      }
+      Double_t ms = elapsedMs(start) / nEvents;
+      nClusters[ic] = clusters.GetEntriesFast();
+      printf("%-12s %8d %10d %12d %12.2f %14.4g\n", caseNames[icase], configThreads[ic], digits.GetEntriesFast(),
+             nClusters[ic], ms, ms > 0 ? digits.GetEntriesFast() / (ms * 1e-3) : 0.);
+    }
+    if (nClusters[0] != nClusters[1]) {
+      printf("Number of clusters depends on the number of threads\n");
+      return 1;
+    }
+    digits.Delete();
+    clusters.Delete();
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+/// \file benchmarkDigitizer.cxx
+/// \brief Throughput benchmark of the ITS Digitizer on central Pb-Pb sized events
+///
+/// Usage: benchmarkDigitizer [-g geometryFile] [-n nPoints] [-e nEvents] [-t nThreads]
+///
+/// The ITS geometry is imported from geometryFile (as written by the simulation, default geofile_full.root), the
+/// segmentations being read from the file given by UpgradeGeometryTGeo::getITSsegmentationFileName.
+/// Each event has nPoints Points (default 300000, the order of a central Pb-Pb collision) spread over the chips
+/// with a density falling as 1/r^2, crossing the sensor with a small inclination and a Landau distributed energy
+/// loss. The events are digitized with 1 and nThreads threads and the throughput is reported in Points/s
+/// together with the number of digits, which must not depend on the number of threads.
+
+#include "Digitizer.h"
+#include "Point.h"
+#include "UpgradeGeometryTGeo.h"
+#include "UpgradeSegmentationPixel.h"
+#include "BenchmarkTools.h"
+
+#include "TClonesArray.h"
+#include "TGeoManager.h"
+#include "TMath.h"
+#include "TRandom3.h"
+#include "TVector3.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace AliceO2::ITS;
+using namespace AliceO2::Benchmark;
+
+namespace {
+/// Fills points with n Points, the chip being drawn from the cumulative weights
+void generateEvent(UpgradeGeometryTGeo& geom, const std::vector<Double_t>& cumulativeWeight, Int_t n,
+                   TRandom3& rnd, TClonesArray& points)
+{
+  points.Clear();
+  for (Int_t ip = 0; ip < n; ip++) {
+    Int_t chip = std::upper_bound(cumulativeWeight.begin(), cumulativeWeight.end(),
+                                  rnd.Rndm() * cumulativeWeight.back()) -
+                 cumulativeWeight.begin();
+    chip = TMath::Min(chip, Int_t(cumulativeWeight.size()) - 1);
+    const UpgradeSegmentationPixel* seg =
+      (const UpgradeSegmentationPixel*)geom.getSegmentation(geom.getLayer(chip));
+    Double_t loc[3], entry[3], exit[3];
+    loc[0] = (rnd.Rndm() - 0.5) * seg->dxActive();
+    loc[1] = -0.5 * seg->Dy();
+    loc[2] = (rnd.Rndm() - 0.5) * seg->dzActive();
+    geom.localToGlobal(chip, loc, entry);
+    loc[0] += rnd.Gaus(0., 2e-3);
+    loc[1] = 0.5 * seg->Dy();
+    loc[2] += rnd.Gaus(0., 2e-3);
+    geom.localToGlobal(chip, loc, exit);
+    // most probable deposit of about 60 electrons per micron [GeV]
+    Double_t eLoss = rnd.Landau(60. * seg->Dy() * 1e4, 8. * seg->Dy() * 1e4) * 3.6e-9;
+    new (points[ip]) Point(ip, chip, TVector3(entry[0], entry[1], entry[2]), TVector3(exit[0], exit[1], exit[2]),
+                           TVector3(0., 0., 1.), 0., 0., 0., TMath::Max(eLoss, 0.), 0);
+  }
+}
+}
+
+int main(int argc, char** argv)
+{
+  const char* geometryFile = "geofile_full.root";
+  Int_t nPoints = 300000, nEvents = 5;
+  Int_t nThreads = std::thread::hardware_concurrency();
+  Options options;
+  options.add("-g", &geometryFile);
+  options.add("-n", &nPoints);
+  options.add("-e", &nEvents);
+  options.add("-t", &nThreads);
+  if (!options.parse(argc, argv)) {
+    printf("Usage: %s [-g geometryFile] [-n nPoints] [-e nEvents] [-t nThreads]\n", argv[0]);
+    return 2;
+  }
+  if (nThreads < 1) {
+    nThreads = 1;
+  }
+
+  if (!TGeoManager::Import(geometryFile)) {
+    printf("Cannot import the geometry from %s\n", geometryFile);
+    return 1;
+  }
+  UpgradeGeometryTGeo geom(kTRUE, kTRUE);
+  Int_t nChips = geom.getNumberOfChips();
+
+  // density of Points falling as 1/r^2 of the chip centre
+  std::vector<Double_t> cumulativeWeight(nChips);
+  Double_t sum = 0;
+  for (Int_t ic = 0; ic < nChips; ic++) {
+    Double_t loc[3] = { 0., 0., 0. }, glo[3];
+    geom.localToGlobal(ic, loc, glo);
+    sum += 1. / (glo[0] * glo[0] + glo[1] * glo[1]);
+    cumulativeWeight[ic] = sum;
+  }
+
+  Digitizer digitizer;
+  digitizer.init(&geom);
+  TClonesArray points("AliceO2::ITS::Point", nPoints);
+  TClonesArray digits("AliceO2::ITS::Digit", 2 * nPoints);
+  TRandom3 rnd(12345);
+
+  const int kNConfigs = 2;
+  Int_t configThreads[kNConfigs] = { 1, nThreads };
+  Double_t configMs[kNConfigs] = { 0 };
+  Long64_t configDigits[kNConfigs] = { 0 };
+  for (int iev = 0; iev < nEvents; iev++) {
+    generateEvent(geom, cumulativeWeight, nPoints, rnd, points);
+    for (int ic = 0; ic < kNConfigs; ic++) {
+      digitizer.setNumberOfThreads(configThreads[ic]);
+      Clock_t::time_point start = Clock_t::now();
+      digitizer.process(&points, &digits);
+      // the first event sizes the buffers and is not timed
+      if (iev) {
+        configMs[ic] += elapsedMs(start);
+      }
+      configDigits[ic] += digits.GetEntriesFast();
+    }
+  }
+
+  Int_t nTimed = TMath::Max(nEvents - 1, 1);
+  printf("%d events of %d Points on %d chips (%d hit in the last event)\n", nEvents, nPoints, nChips,
+         digitizer.getNumberOfHitChips());
+  printf("%-10s %12s %14s %14s\n", "threads", "ms/event", "Points/s", "digits/event");
+  for (int ic = 0; ic < kNConfigs; ic++) {
+    printf("%-10d %12.2f %14.4g %14.1f\n", configThreads[ic], configMs[ic] / nTimed,
+           configMs[ic] > 0 ? nPoints * nTimed / (configMs[ic] * 1e-3) : 0., Double_t(configDigits[ic]) / nEvents);
+  }
+  if (configDigits[0] != configDigits[kNConfigs - 1]) {
+    printf("Number of digits depends on the number of threads\n");
+    return 1;
+  }
+  return 0;
+}